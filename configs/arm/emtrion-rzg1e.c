@@ -59,6 +59,7 @@ struct {
 		},
 		.root_cell = {
 			.name = "emCON-RZ/G1E",
+			.flags = JAILHOUSE_CELL_PMU,
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
 			.num_irqchips = ARRAY_SIZE(config.irqchips),
@@ -61,6 +61,7 @@ struct {
 		},
 		.root_cell = {
 			.name = "Jetson-TK1",
+			.flags = JAILHOUSE_CELL_PMU,
 
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
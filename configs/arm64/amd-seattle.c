@@ -53,6 +53,7 @@ struct {
 		},
 		.root_cell = {
 			.name = "amd-seattle",
+			.flags = JAILHOUSE_CELL_PMU,
 
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
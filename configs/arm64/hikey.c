@@ -54,6 +54,7 @@ struct {
 		},
 		.root_cell = {
 			.name = "HiKey",
+			.flags = JAILHOUSE_CELL_PMU,
 
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
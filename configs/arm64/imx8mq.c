@@ -44,10 +44,13 @@ struct {
 				.gicd_base = 0x38800000,
 				.gicr_base = 0x38880000,
 				.maintenance_irq = 25,
+				/* 1 MiB, 16-way L2 */
+				.llc_way_size = 0x10000,
 			},
 		},
 		.root_cell = {
 			.name = "imx8mq",
+			.flags = JAILHOUSE_CELL_PMU,
 
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
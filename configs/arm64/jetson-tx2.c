@@ -53,10 +53,13 @@ struct {
 				.gicv_base = 0x03886000,
 				.gic_version = 2,
 				.maintenance_irq = 25,
+				/* 2 MiB, 16-way L2 */
+				.llc_way_size = 0x20000,
 			}
 		},
 		.root_cell = {
 			.name = "Jetson-TX2",
+			.flags = JAILHOUSE_CELL_PMU,
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
 			.num_irqchips = ARRAY_SIZE(config.irqchips),
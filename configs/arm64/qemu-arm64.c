@@ -55,6 +55,7 @@ struct {
 		},
 		.root_cell = {
 			.name = "qemu-arm64",
+			.flags = JAILHOUSE_CELL_PMU,
 
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
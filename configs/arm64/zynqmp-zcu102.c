@@ -53,10 +53,13 @@ struct {
 				.gich_base = 0xf9040000,
 				.gicv_base = 0xf906f000,
 				.maintenance_irq = 25,
+				/* 1 MiB, 16-way L2 */
+				.llc_way_size = 0x10000,
 			},
 		},
 		.root_cell = {
 			.name = "ZynqMP-ZCU102",
+			.flags = JAILHOUSE_CELL_PMU,
 
 			.cpu_set_size = sizeof(config.cpus),
 			.num_memory_regions = ARRAY_SIZE(config.mem_regions),
@@ -11,6 +11,7 @@
 #include "axvm.h"
 #include "main.h"
 #include "cell.h"
+#include "image.h"
 
 #include <jailhouse/hypercall.h>
 
@@ -22,20 +23,26 @@ static cpumask_t offlined_cpus;
 ///		image->source_address: user address.
 ///		image->size: image size.
 ///		image->target_address: target physical address provided by arceos-hv.
+///		image->flags: JAILHOUSE_IMAGE_COMPRESSED for zstd/lz4 images,
+///			which are decompressed straight into the target.
 int arceos_axvm_load_image(struct jailhouse_preload_image *image) 
 {
 	void *image_mem;
 	int err = 0;
 
-	__u64 page_offs, phys_start;
+	__u64 page_offs, phys_start, size;
 
 	phys_start = image->target_address & PAGE_MASK;
 	page_offs = offset_in_page(image->target_address);
 	
 	pr_info("[%s]:\n", __func__);
 
+	err = jailhouse_image_size(image, &size);
+	if (err)
+		return err;
+
 	image_mem = jailhouse_ioremap(phys_start, 0,
-			PAGE_ALIGN(image->size + page_offs));
+			PAGE_ALIGN(size + page_offs));
 	
 	pr_info("phys_start 0x%llx remap to 0x%p\n", phys_start, image_mem);
 
@@ -46,30 +53,13 @@ int arceos_axvm_load_image(struct jailhouse_preload_image *image)
 		return -EBUSY;
 	}
 
-	pr_info("copy to 0x%p size 0x%llx, loading...\n", image_mem + page_offs, image->size);
+	pr_info("copy to 0x%p size 0x%llx, loading...\n", image_mem + page_offs, size);
 
-	if (copy_from_user(image_mem + page_offs,
-			   (void __user *)(unsigned long)image->source_address,
-			   image->size)) {
-		pr_err("jailhouse: Unable to copy image from user %08llx "
+	err = jailhouse_image_write(image_mem + page_offs, image, 0, size);
+	if (err)
+		pr_err("jailhouse: Unable to load image from user %08llx "
 		       "for image loading\n",
 		       (unsigned long long)(image->source_address));
-		err = -EFAULT;
-	}
-		
-	/*
-	 * ARMv7 and ARMv8 require to clean D-cache and invalidate I-cache for
-	 * memory containing new instructions. On x86 this is a NOP.
-	 */
-	flush_icache_range((unsigned long)(image_mem + page_offs),
-			   (unsigned long)(image_mem + page_offs) + image->size);
-#ifdef CONFIG_ARM
-	/*
-	 * ARMv7 requires to flush the written code and data out of D-cache to
-	 * allow the guest starting off with caches disabled.
-	 */
-	__cpuc_flush_dcache_area(image_mem + page_offs, image->size);
-#endif
 
 	vunmap(image_mem);
 
@@ -163,6 +153,7 @@ int arceos_cmd_axvm_create(struct jailhouse_axvm_create __user *arg)
 		bios_image.source_address = vm_cfg.img_addr[0];
 		bios_image.size = vm_cfg.img_size[0];
 		bios_image.target_address = arceos_hvc_axvm_create->bios_load_hpa;
+		bios_image.flags = vm_cfg.img_flags[0];
 		bios_image.padding = 0;
 
 		pr_info("[%s] bios_load_hpa: 0x%llx\n", __func__, arceos_hvc_axvm_create->bios_load_hpa);
@@ -179,6 +170,7 @@ int arceos_cmd_axvm_create(struct jailhouse_axvm_create __user *arg)
 		kernel_image.source_address = vm_cfg.img_addr[1];
 		kernel_image.size = vm_cfg.img_size[1];
 		kernel_image.target_address = arceos_hvc_axvm_create->kernel_load_hpa;
+		kernel_image.flags = vm_cfg.img_flags[1];
 		kernel_image.padding = 0;
 
 		pr_info("[%s] kernel_load_hpa: 0x%llx\n", __func__, arceos_hvc_axvm_create->kernel_load_hpa);
@@ -195,6 +187,7 @@ int arceos_cmd_axvm_create(struct jailhouse_axvm_create __user *arg)
 		ramdisk_image.source_address = vm_cfg.img_addr[2];
 		ramdisk_image.size = vm_cfg.img_size[2];
 		ramdisk_image.target_address = arceos_hvc_axvm_create->ramdisk_load_hpa;
+		ramdisk_image.flags = vm_cfg.img_flags[2];
 		ramdisk_image.padding = 0;
 
 		pr_info("[%s] ramdisk_load_hpa: 0x%llx\n", __func__, arceos_hvc_axvm_create->ramdisk_load_hpa);
@@ -14,9 +14,9 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
-#include <asm/cacheflush.h>
 
 #include "cell.h"
+#include "image.h"
 #include "main.h"
 #include "pci.h"
 #include "sysfs.h"
@@ -28,11 +28,32 @@ struct cell *root_cell;
 static LIST_HEAD(cells);
 static cpumask_t offlined_cpus;
 
+/* Image written into a loadable region, optionally with a snapshot copy. */
+struct cell_image {
+	struct list_head entry;
+	const struct jailhouse_memory *mem;
+	u64 mem_offset;
+	u64 size;
+	void *snapshot;
+};
+
+static void cell_free_images(struct cell *cell)
+{
+	struct cell_image *image, *tmp;
+
+	list_for_each_entry_safe(image, tmp, &cell->images, entry) {
+		list_del(&image->entry);
+		vfree(image->snapshot);
+		kfree(image);
+	}
+}
+
 void jailhouse_cell_kobj_release(struct kobject *kobj)
 {
 	struct cell *cell = container_of(kobj, struct cell, kobj);
 
 	jailhouse_pci_cell_cleanup(cell);
+	cell_free_images(cell);
 	vfree(cell->memory_regions);
 	kfree(cell);
 }
@@ -61,6 +82,7 @@ retry:
 		return ERR_PTR(-ENOMEM);
 
 	INIT_LIST_HEAD(&cell->entry);
+	INIT_LIST_HEAD(&cell->images);
 
 	cell->id = id;
 
@@ -283,15 +305,108 @@ static int cell_management_prologue(struct jailhouse_cell_id *cell_id,
 
 #define MEM_REQ_FLAGS	(JAILHOUSE_MEM_WRITE | JAILHOUSE_MEM_LOADABLE)
 
+static bool region_loadable(const struct jailhouse_memory *mem)
+{
+	/* shared read-only regions are only written via the root cell */
+	if (mem->flags & JAILHOUSE_MEM_SHARED_RO)
+		return mem->flags & JAILHOUSE_MEM_LOADABLE;
+	return (mem->flags & MEM_REQ_FLAGS) == MEM_REQ_FLAGS;
+}
+
+typedef int (*image_chunk_fn)(void *chunk, u64 offset, u64 size, void *arg);
+
+static int map_image_chunk(u64 phys, u64 offset, u64 size,
+			   image_chunk_fn fn, void *arg)
+{
+	unsigned int page_offs = offset_in_page(phys);
+	void *image_mem;
+	int err;
+
+	image_mem = jailhouse_ioremap(phys & PAGE_MASK, 0,
+				      PAGE_ALIGN(size + page_offs));
+	if (!image_mem) {
+		pr_err("jailhouse: Unable to map cell RAM at %08llx "
+		       "for image loading\n", (unsigned long long)phys);
+		return -EBUSY;
+	}
+
+	err = fn(image_mem + page_offs, offset, size, arg);
+
+	vunmap(image_mem);
+
+	return err;
+}
+
+/*
+ * Colored regions are only physically contiguous across consecutive colors.
+ * Walk the range run by run, following the hypervisor's stage-2 layout.
+ */
+static int for_each_image_chunk(const struct jailhouse_memory *mem,
+				u64 mem_offset, u64 size,
+				image_chunk_fn fn, void *arg)
+{
+	unsigned int num_colors, color;
+	u64 phys, run, offset;
+	u32 colors;
+	int err;
+
+	if (!(mem->flags & JAILHOUSE_MEM_COLORED))
+		return map_image_chunk(mem->phys_start + mem_offset, 0, size,
+				       fn, arg);
+
+	num_colors = jailhouse_num_colors(jailhouse_llc_way_size);
+	colors = jailhouse_mem_colors(mem, jailhouse_llc_way_size);
+
+	for (offset = 0; offset < size; offset += run) {
+		phys = jailhouse_colored_phys(mem, jailhouse_llc_way_size,
+					      mem_offset + offset);
+		run = PAGE_SIZE - offset_in_page(phys);
+		color = ((unsigned long)(phys >> PAGE_SHIFT) + 1) % num_colors;
+		while (run < size - offset && colors & (1U << color)) {
+			run += PAGE_SIZE;
+			color = (color + 1) % num_colors;
+		}
+		run = min(run, size - offset);
+
+		err = map_image_chunk(phys, offset, run, fn, arg);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int load_image_chunk(void *chunk, u64 offset, u64 size, void *arg)
+{
+	return jailhouse_image_write(chunk, arg, offset, size);
+}
+
+static int snapshot_image_chunk(void *chunk, u64 offset, u64 size, void *arg)
+{
+	struct cell_image *image = arg;
+
+	memcpy(image->snapshot + offset, chunk, size);
+	return 0;
+}
+
+static int restore_image_chunk(void *chunk, u64 offset, u64 size, void *arg)
+{
+	struct cell_image *image = arg;
+
+	memcpy(chunk, image->snapshot + offset, size);
+	jailhouse_image_flush(chunk, size);
+	return 0;
+}
+
 static int load_image(struct cell *cell,
 		      struct jailhouse_preload_image __user *uimage)
 {
 	struct jailhouse_preload_image image;
 	const struct jailhouse_memory *mem;
-	unsigned int regions, page_offs;
-	u64 image_offset, phys_start;
-	void *image_mem;
-	int err = 0;
+	u64 image_offset, image_size, mem_size;
+	struct cell_image *cell_image;
+	unsigned int regions;
+	int err;
 
 	if (copy_from_user(&image, uimage, sizeof(image)))
 		return -EFAULT;
@@ -299,13 +414,19 @@ static int load_image(struct cell *cell,
 	if (image.size == 0)
 		return 0;
 
+	err = jailhouse_image_size(&image, &image_size);
+	if (err)
+		return err;
+
 	mem = cell->memory_regions;
 	for (regions = cell->num_memory_regions; regions > 0; regions--) {
+		mem_size = jailhouse_mem_virt_size(mem,
+						   jailhouse_llc_way_size);
 		image_offset = image.target_address - mem->virt_start;
 		if (image.target_address >= mem->virt_start &&
-		    image_offset < mem->size) {
-			if (image.size > mem->size - image_offset ||
-			    (mem->flags & MEM_REQ_FLAGS) != MEM_REQ_FLAGS)
+		    image_offset < mem_size) {
+			if (image_size > mem_size - image_offset ||
+			    !region_loadable(mem))
 				return -EINVAL;
 			break;
 		}
@@ -314,38 +435,29 @@ static int load_image(struct cell *cell,
 	if (regions == 0)
 		return -EINVAL;
 
-	phys_start = (mem->phys_start + image_offset) & PAGE_MASK;
-	page_offs = offset_in_page(image_offset);
-	image_mem = jailhouse_ioremap(phys_start, 0,
-				      PAGE_ALIGN(image.size + page_offs));
-	if (!image_mem) {
-		pr_err("jailhouse: Unable to map cell RAM at %08llx "
-		       "for image loading\n",
-		       (unsigned long long)(mem->phys_start + image_offset));
-		return -EBUSY;
-	}
+	/* compressed images need a contiguous target */
+	if (mem->flags & JAILHOUSE_MEM_COLORED &&
+	    image.flags & JAILHOUSE_IMAGE_COMPRESSED)
+		return -EINVAL;
 
-	if (copy_from_user(image_mem + page_offs,
-			   (void __user *)(unsigned long)image.source_address,
-			   image.size))
-		err = -EFAULT;
-	/*
-	 * ARMv7 and ARMv8 require to clean D-cache and invalidate I-cache for
-	 * memory containing new instructions. On x86 this is a NOP.
-	 */
-	flush_icache_range((unsigned long)(image_mem + page_offs),
-			   (unsigned long)(image_mem + page_offs) + image.size);
-#ifdef CONFIG_ARM
-	/*
-	 * ARMv7 requires to flush the written code and data out of D-cache to
-	 * allow the guest starting off with caches disabled.
-	 */
-	__cpuc_flush_dcache_area(image_mem + page_offs, image.size);
-#endif
+	cell_image = kzalloc(sizeof(*cell_image), GFP_KERNEL);
+	if (!cell_image)
+		return -ENOMEM;
 
-	vunmap(image_mem);
+	err = for_each_image_chunk(mem, image_offset, image_size,
+				   load_image_chunk, &image);
+	if (err) {
+		kfree(cell_image);
+		return err;
+	}
 
-	return err;
+	/* remember the written range for cell snapshots */
+	cell_image->mem = mem;
+	cell_image->mem_offset = image_offset;
+	cell_image->size = image_size;
+	list_add_tail(&cell_image->entry, &cell->images);
+
+	return 0;
 }
 
 int jailhouse_cmd_cell_load(struct jailhouse_cell_load __user *arg)
@@ -367,6 +479,12 @@ int jailhouse_cmd_cell_load(struct jailhouse_cell_load __user *arg)
 	if (err)
 		goto unlock_out;
 
+	/* new image set after a start, drop the old one and its snapshot */
+	if (cell->images_started) {
+		cell_free_images(cell);
+		cell->images_started = false;
+	}
+
 	for (n = cell_load.num_preload_images; n > 0; n--, image++) {
 		err = load_image(cell, image);
 		if (err)
@@ -379,6 +497,96 @@ unlock_out:
 	return err;
 }
 
+int jailhouse_cmd_cell_snapshot(const char __user *arg)
+{
+	struct jailhouse_cell_id cell_id;
+	struct cell_image *image;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&cell_id, arg, sizeof(cell_id)))
+		return -EFAULT;
+
+	err = cell_management_prologue(&cell_id, &cell);
+	if (err)
+		return err;
+
+	/* only freshly loaded images are pristine and mapped */
+	if (cell->images_started || list_empty(&cell->images)) {
+		err = -EINVAL;
+		goto unlock_out;
+	}
+
+	list_for_each_entry(image, &cell->images, entry) {
+		vfree(image->snapshot);
+		image->snapshot = vmalloc(image->size);
+		if (!image->snapshot) {
+			err = -ENOMEM;
+			break;
+		}
+
+		err = for_each_image_chunk(image->mem, image->mem_offset,
+					   image->size, snapshot_image_chunk,
+					   image);
+		if (err)
+			break;
+	}
+
+	if (err)
+		list_for_each_entry(image, &cell->images, entry) {
+			vfree(image->snapshot);
+			image->snapshot = NULL;
+		}
+
+unlock_out:
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+int jailhouse_cmd_cell_restore(const char __user *arg)
+{
+	struct jailhouse_cell_id cell_id;
+	struct cell_image *image;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&cell_id, arg, sizeof(cell_id)))
+		return -EFAULT;
+
+	err = cell_management_prologue(&cell_id, &cell);
+	if (err)
+		return err;
+
+	if (list_empty(&cell->images)) {
+		err = -ENOENT;
+		goto unlock_out;
+	}
+	list_for_each_entry(image, &cell->images, entry)
+		if (!image->snapshot) {
+			err = -ENOENT;
+			goto unlock_out;
+		}
+
+	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_SET_LOADABLE, cell->id);
+	if (err)
+		goto unlock_out;
+
+	list_for_each_entry(image, &cell->images, entry) {
+		err = for_each_image_chunk(image->mem, image->mem_offset,
+					   image->size, restore_image_chunk,
+					   image);
+		if (err)
+			break;
+	}
+	cell->images_started = false;
+
+unlock_out:
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
 int jailhouse_cmd_cell_start(const char __user *arg)
 {
 	struct jailhouse_cell_id cell_id;
@@ -393,6 +601,8 @@ int jailhouse_cmd_cell_start(const char __user *arg)
 		return err;
 
 	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_START, cell->id);
+	if (!err)
+		cell->images_started = true;
 
 	mutex_unlock(&jailhouse_lock);
 
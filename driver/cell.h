@@ -30,6 +30,8 @@ struct cell {
 	cpumask_t cpus_assigned;
 	u32 num_memory_regions;
 	struct jailhouse_memory *memory_regions;
+	struct list_head images;
+	bool images_started;
 #ifdef CONFIG_PCI
 	u32 num_pci_devices;
 	struct jailhouse_pci_device *pci_devices;
@@ -47,6 +49,8 @@ void jailhouse_cell_delete_root(void);
 int jailhouse_cmd_cell_create(struct jailhouse_cell_create __user *arg);
 int jailhouse_cmd_cell_load(struct jailhouse_cell_load __user *arg);
 int jailhouse_cmd_cell_start(const char __user *arg);
+int jailhouse_cmd_cell_snapshot(const char __user *arg);
+int jailhouse_cmd_cell_restore(const char __user *arg);
 int jailhouse_cmd_cell_destroy(const char __user *arg);
 
 int jailhouse_cmd_cell_destroy_non_root(void);
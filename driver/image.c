@@ -0,0 +1,427 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <linux/kernel.h>
+#include <linux/lz4.h>
+#include <linux/sched.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#include <linux/vmalloc.h>
+#include <asm/cacheflush.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,12,0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+
+#if IS_ENABLED(CONFIG_ZSTD_DECOMPRESS) && \
+	LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0)
+#define HAVE_ZSTD
+#include <linux/zstd.h>
+#endif
+#if IS_ENABLED(CONFIG_LZ4_DECOMPRESS)
+#define HAVE_LZ4
+#endif
+
+#include "image.h"
+
+#define ZSTD_MAGIC			0xfd2fb528
+/* default window limit of the zstd decoder */
+#define ZSTD_MAX_WINDOW_SIZE		(1UL << 27)
+
+#define LZ4_MAGIC			0x184d2204
+#define LZ4_FLG_VERSION_MASK		0xc0
+#define LZ4_FLG_VERSION			0x40
+#define LZ4_FLG_BLOCK_INDEP		0x20
+#define LZ4_FLG_BLOCK_CHECKSUM		0x10
+#define LZ4_FLG_CONTENT_SIZE		0x08
+#define LZ4_FLG_DICT_ID			0x01
+#define LZ4_BLOCK_UNCOMPRESSED		0x80000000
+#define LZ4_HISTORY_SIZE		(64 * 1024)
+/* magic, FLG, BD, content size, HC */
+#define LZ4_HEADER_SIZE			15
+
+#define IMAGE_HEADER_MAX		18
+#define IMAGE_CHUNK_SIZE		(128 * 1024)
+
+struct image_header {
+	u32 magic;
+	u8 flags;
+	u64 content_size;
+	/* zstd: window size, lz4: maximum block size */
+	unsigned long buffer_size;
+};
+
+static inline void __user *image_source(u64 address)
+{
+	return (void __user *)(unsigned long)address;
+}
+
+#ifdef HAVE_ZSTD
+static int zstd_parse_header(const u8 *buf, size_t len,
+			     struct image_header *header)
+{
+	zstd_frame_header params;
+
+	if (zstd_get_frame_header(&params, buf, len) != 0)
+		return -EINVAL;
+
+	if (params.frameContentSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+		pr_err("jailhouse: Compressed image lacks content size\n");
+		return -EINVAL;
+	}
+	if (params.windowSize > ZSTD_MAX_WINDOW_SIZE)
+		return -EINVAL;
+
+	header->content_size = params.frameContentSize;
+	header->buffer_size = params.windowSize;
+
+	return 0;
+}
+
+/*
+ * The frame is streamed through a small bounce buffer, and the output goes
+ * directly to the target. Only the decoder's history window is allocated.
+ */
+static int zstd_decompress(void *dst, u64 size,
+			   const struct jailhouse_preload_image *image,
+			   const struct image_header *header)
+{
+	u64 source = image->source_address;
+	u64 remaining = image->size;
+	zstd_out_buffer out = {
+		.dst = dst,
+		.size = size,
+	};
+	zstd_in_buffer in = { };
+	size_t workspace_size, ret, in_pos, out_pos;
+	zstd_dstream *stream;
+	void *workspace, *buf;
+	size_t chunk;
+	int err = 0;
+
+	workspace_size = zstd_dstream_workspace_bound(header->buffer_size);
+	workspace = vmalloc(workspace_size);
+	buf = vmalloc(IMAGE_CHUNK_SIZE);
+	if (!workspace || !buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	stream = zstd_init_dstream(header->buffer_size, workspace,
+				   workspace_size);
+	if (!stream) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	in.src = buf;
+	do {
+		if (in.pos == in.size) {
+			if (remaining == 0) {
+				err = -EINVAL;
+				break;
+			}
+			chunk = min_t(u64, remaining, IMAGE_CHUNK_SIZE);
+			if (copy_from_user(buf, image_source(source), chunk)) {
+				err = -EFAULT;
+				break;
+			}
+			in.size = chunk;
+			in.pos = 0;
+			source += chunk;
+			remaining -= chunk;
+		}
+
+		in_pos = in.pos;
+		out_pos = out.pos;
+		ret = zstd_decompress_stream(stream, &out, &in);
+		if (zstd_is_error(ret)) {
+			err = -EINVAL;
+			break;
+		}
+		/* no progress means the output exceeds the content size */
+		if (ret != 0 && in.pos == in_pos && out.pos == out_pos) {
+			err = -EINVAL;
+			break;
+		}
+
+		cond_resched();
+	} while (ret != 0);
+
+	if (!err && out.pos != size)
+		err = -EINVAL;
+	if (err == -EINVAL)
+		pr_err("jailhouse: Corrupt zstd image\n");
+
+out:
+	vfree(buf);
+	vfree(workspace);
+	return err;
+}
+#else /* !HAVE_ZSTD */
+static int zstd_parse_header(const u8 *buf, size_t len,
+			     struct image_header *header)
+{
+	pr_err("jailhouse: Kernel lacks zstd support\n");
+	return -EOPNOTSUPP;
+}
+
+static int zstd_decompress(void *dst, u64 size,
+			   const struct jailhouse_preload_image *image,
+			   const struct image_header *header)
+{
+	return -EOPNOTSUPP;
+}
+#endif /* !HAVE_ZSTD */
+
+#ifdef HAVE_LZ4
+static int lz4_parse_header(const u8 *buf, size_t len,
+			    struct image_header *header)
+{
+	unsigned int block_size_id;
+
+	if (len < LZ4_HEADER_SIZE ||
+	    (buf[4] & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION ||
+	    buf[4] & LZ4_FLG_DICT_ID)
+		return -EINVAL;
+
+	if (!(buf[4] & LZ4_FLG_CONTENT_SIZE)) {
+		pr_err("jailhouse: Compressed image lacks content size\n");
+		return -EINVAL;
+	}
+
+	block_size_id = (buf[5] >> 4) & 0x7;
+	if (block_size_id < 4)
+		return -EINVAL;
+
+	header->flags = buf[4];
+	header->content_size = get_unaligned_le64(&buf[6]);
+	/* 64 KiB, 256 KiB, 1 MiB or 4 MiB */
+	header->buffer_size = 1UL << (8 + 2 * block_size_id);
+
+	return 0;
+}
+
+/*
+ * Blocks are decompressed one by one from a block-sized bounce buffer
+ * directly into the target. Linked blocks use the preceding output in the
+ * target as their dictionary.
+ */
+static int lz4_decompress(void *dst, u64 size,
+			  const struct jailhouse_preload_image *image,
+			  const struct image_header *header)
+{
+	u64 source = image->source_address + LZ4_HEADER_SIZE;
+	u64 end = image->source_address + image->size;
+	unsigned int history = 0, checksum = 0;
+	u32 block_size, len;
+	__le32 block_header;
+	u64 pos = 0;
+	int err = 0;
+	void *buf;
+	int ret;
+
+	if (header->flags & LZ4_FLG_BLOCK_CHECKSUM)
+		checksum = sizeof(u32);
+
+	buf = vmalloc(header->buffer_size);
+	if (!buf)
+		return -ENOMEM;
+
+	while (1) {
+		if (end - source < sizeof(block_header)) {
+			err = -EINVAL;
+			break;
+		}
+		if (copy_from_user(&block_header, image_source(source),
+				   sizeof(block_header))) {
+			err = -EFAULT;
+			break;
+		}
+		source += sizeof(block_header);
+
+		block_size = le32_to_cpu(block_header);
+		if (block_size == 0)
+			break;
+
+		len = block_size & ~LZ4_BLOCK_UNCOMPRESSED;
+		if (len > header->buffer_size ||
+		    len + checksum > end - source) {
+			err = -EINVAL;
+			break;
+		}
+
+		if (block_size & LZ4_BLOCK_UNCOMPRESSED) {
+			if (len > size - pos) {
+				err = -EINVAL;
+				break;
+			}
+			if (copy_from_user(dst + pos, image_source(source),
+					   len)) {
+				err = -EFAULT;
+				break;
+			}
+			ret = len;
+		} else {
+			if (copy_from_user(buf, image_source(source), len)) {
+				err = -EFAULT;
+				break;
+			}
+			if (!(header->flags & LZ4_FLG_BLOCK_INDEP))
+				history = min_t(u64, pos, LZ4_HISTORY_SIZE);
+			ret = LZ4_decompress_safe_usingDict(buf, dst + pos, len,
+					min_t(u64, size - pos,
+					      header->buffer_size),
+					dst + pos - history, history);
+			if (ret < 0) {
+				err = -EINVAL;
+				break;
+			}
+		}
+
+		pos += ret;
+		source += len + checksum;
+
+		cond_resched();
+	}
+
+	if (!err && pos != size)
+		err = -EINVAL;
+	if (err == -EINVAL)
+		pr_err("jailhouse: Corrupt lz4 image\n");
+
+	vfree(buf);
+	return err;
+}
+#else /* !HAVE_LZ4 */
+static int lz4_parse_header(const u8 *buf, size_t len,
+			    struct image_header *header)
+{
+	pr_err("jailhouse: Kernel lacks lz4 support\n");
+	return -EOPNOTSUPP;
+}
+
+static int lz4_decompress(void *dst, u64 size,
+			  const struct jailhouse_preload_image *image,
+			  const struct image_header *header)
+{
+	return -EOPNOTSUPP;
+}
+#endif /* !HAVE_LZ4 */
+
+static int parse_header(const struct jailhouse_preload_image *image,
+			struct image_header *header)
+{
+	u8 buf[IMAGE_HEADER_MAX];
+	size_t len = min_t(u64, image->size, sizeof(buf));
+
+	if (len < sizeof(header->magic))
+		return -EINVAL;
+	if (copy_from_user(buf, image_source(image->source_address), len))
+		return -EFAULT;
+
+	header->magic = get_unaligned_le32(buf);
+	switch (header->magic) {
+	case ZSTD_MAGIC:
+		return zstd_parse_header(buf, len, header);
+	case LZ4_MAGIC:
+		return lz4_parse_header(buf, len, header);
+	default:
+		pr_err("jailhouse: Unsupported image compression\n");
+		return -EINVAL;
+	}
+}
+
+/**
+ * Make written image data visible to a cell that starts with caches off.
+ * @param dst		Mapped target memory.
+ * @param size		Size of the written range.
+ */
+void jailhouse_image_flush(void *dst, u64 size)
+{
+	/*
+	 * ARMv7 and ARMv8 require to clean D-cache and invalidate I-cache for
+	 * memory containing new instructions. On x86 this is a NOP.
+	 */
+	flush_icache_range((unsigned long)dst, (unsigned long)dst + size);
+#ifdef CONFIG_ARM
+	/*
+	 * ARMv7 requires to flush the written code and data out of D-cache to
+	 * allow the guest starting off with caches disabled.
+	 */
+	__cpuc_flush_dcache_area(dst, size);
+#endif
+}
+
+/**
+ * Determine how much target memory an image occupies.
+ * @param image		Image descriptor.
+ * @param size		Set to the size of the raw or decompressed image.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int jailhouse_image_size(const struct jailhouse_preload_image *image,
+			 u64 *size)
+{
+	struct image_header header;
+	int err;
+
+	if (!(image->flags & JAILHOUSE_IMAGE_COMPRESSED)) {
+		*size = image->size;
+		return 0;
+	}
+
+	err = parse_header(image, &header);
+	if (err)
+		return err;
+
+	*size = header.content_size;
+	return 0;
+}
+
+/**
+ * Write an image or a part of it to the mapped target memory.
+ * @param dst		Mapped target memory.
+ * @param image		Image descriptor.
+ * @param offset	Offset into the raw image to start from.
+ * @param size		Number of bytes to write, as reported by
+ * 			jailhouse_image_size() for compressed images.
+ *
+ * Compressed images are decompressed while loading and can only be written
+ * as a whole.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int jailhouse_image_write(void *dst,
+			  const struct jailhouse_preload_image *image,
+			  u64 offset, u64 size)
+{
+	struct image_header header;
+	int err = 0;
+
+	if (image->flags & JAILHOUSE_IMAGE_COMPRESSED) {
+		if (offset != 0)
+			return -EINVAL;
+
+		err = parse_header(image, &header);
+		if (!err && header.content_size != size)
+			err = -EINVAL;
+		if (!err && header.magic == ZSTD_MAGIC)
+			err = zstd_decompress(dst, size, image, &header);
+		else if (!err)
+			err = lz4_decompress(dst, size, image, &header);
+	} else if (copy_from_user(dst,
+				  image_source(image->source_address + offset),
+				  size)) {
+		err = -EFAULT;
+	}
+
+	jailhouse_image_flush(dst, size);
+
+	return err;
+}
@@ -0,0 +1,20 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_DRIVER_IMAGE_H
+#define _JAILHOUSE_DRIVER_IMAGE_H
+
+#include "jailhouse.h"
+
+int jailhouse_image_size(const struct jailhouse_preload_image *image,
+			 u64 *size);
+int jailhouse_image_write(void *dst,
+			  const struct jailhouse_preload_image *image,
+			  u64 offset, u64 size);
+void jailhouse_image_flush(void *dst, u64 size);
+
+#endif /* !_JAILHOUSE_DRIVER_IMAGE_H */
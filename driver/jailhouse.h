@@ -71,6 +71,8 @@ struct jailhouse_axvm_create {
 	__u64 img_addr[JAILHOUSE_FILE_MAXNUM];
 	// size for each image.
 	__u64 img_size[JAILHOUSE_FILE_MAXNUM];
+	// JAILHOUSE_IMAGE_* flags for each image.
+	__u32 img_flags[JAILHOUSE_FILE_MAXNUM];
 };
 
 struct jailhouse_cell_create {
@@ -83,9 +85,13 @@ struct jailhouse_preload_image {
 	__u64 source_address;
 	__u64 size;
 	__u64 target_address;
-	__u64 padding;
+	__u32 flags;
+	__u32 padding;
 };
 
+/* The image is a zstd or lz4 frame that is decompressed while loading. */
+#define JAILHOUSE_IMAGE_COMPRESSED	0x0001
+
 struct jailhouse_cell_id {
 	__s32 id;
 	__u32 padding;
@@ -110,4 +116,7 @@ struct jailhouse_cell_load {
 
 #define JAILHOUSE_AXVM_CREATE _IOW(0, 6, struct jailhouse_axvm_create)
 
+#define JAILHOUSE_CELL_SNAPSHOT		_IOW(0, 7, struct jailhouse_cell_id)
+#define JAILHOUSE_CELL_RESTORE		_IOW(0, 8, struct jailhouse_cell_id)
+
 #endif /* !_JAILHOUSE_DRIVER_H */
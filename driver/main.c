@@ -97,6 +97,7 @@ struct console_state {
 DEFINE_MUTEX(jailhouse_lock);
 bool jailhouse_enabled;
 void *hypervisor_mem;
+u32 jailhouse_llc_way_size;
 
 static struct device *jailhouse_dev;
 static unsigned long hv_core_and_percpu_size;
@@ -566,6 +567,9 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 		config->platform_info.x86.apic_khz =
 			*lapic_timer_period_sym / (1000 / HZ);
 #endif
+#if defined(CONFIG_ARM) || defined(CONFIG_ARM64)
+	jailhouse_llc_way_size = config->platform_info.arm.llc_way_size;
+#endif
 
 	err = jailhouse_cell_prepare_root(&config->root_cell);
 	if (err)
@@ -753,6 +757,12 @@ static long jailhouse_ioctl(struct file *file, unsigned int ioctl,
 	case JAILHOUSE_CELL_DESTROY:
 		err = jailhouse_cmd_cell_destroy((const char __user *)arg);
 		break;
+	case JAILHOUSE_CELL_SNAPSHOT:
+		err = jailhouse_cmd_cell_snapshot((const char __user *)arg);
+		break;
+	case JAILHOUSE_CELL_RESTORE:
+		err = jailhouse_cmd_cell_restore((const char __user *)arg);
+		break;
 	case JAILHOUSE_AXVM_CREATE:
 		err = arceos_cmd_axvm_create(
 			(struct jailhouse_axvm_create __user *)arg);
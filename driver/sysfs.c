@@ -15,11 +15,13 @@
 #include "main.h"
 #include "sysfs.h"
 
+#include <jailhouse/header.h>
 #include <jailhouse/hypercall.h>
 
 /* For compatibility with older kernel versions */
 #include <linux/version.h>
 #include <linux/gfp.h>
+#include <linux/math64.h>
 #include <linux/stat.h>
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,11,0)
@@ -114,6 +116,7 @@ JAILHOUSE_CPU_STATS_ATTR(vmexits_maintenance, JAILHOUSE_CPU_STAT_VMEXITS_MAINTEN
 JAILHOUSE_CPU_STATS_ATTR(vmexits_virt_irq, JAILHOUSE_CPU_STAT_VMEXITS_VIRQ);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_virt_sgi, JAILHOUSE_CPU_STAT_VMEXITS_VSGI);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_psci, JAILHOUSE_CPU_STAT_VMEXITS_PSCI);
+JAILHOUSE_CPU_STATS_ATTR(vmexits_vtimer, JAILHOUSE_CPU_STAT_VMEXITS_VTIMER);
 #ifdef CONFIG_ARM
 JAILHOUSE_CPU_STATS_ATTR(vmexits_cp15, JAILHOUSE_CPU_STAT_VMEXITS_CP15);
 #endif
@@ -137,6 +140,7 @@ static struct attribute *no_attrs[] = {
 	&vmexits_virt_irq_attr.kattr.attr,
 	&vmexits_virt_sgi_attr.kattr.attr,
 	&vmexits_psci_attr.kattr.attr,
+	&vmexits_vtimer_attr.kattr.attr,
 #ifdef CONFIG_ARM
 	&vmexits_cp15_attr.kattr.attr,
 #endif
@@ -355,6 +359,69 @@ static ssize_t info_show(struct device *dev, char *buffer, unsigned int type)
 	return result;
 }
 
+static u64 ticks_to_ns(u64 ticks, u32 khz)
+{
+	return khz ? mul_u64_u32_div(ticks, 1000000, khz) : 0;
+}
+
+static int get_info_part(unsigned int type, u32 *part)
+{
+	int ret = (int)jailhouse_call_arg1(JAILHOUSE_HC_HYPERVISOR_GET_INFO,
+					   type);
+
+	if (ret < 0)
+		return ret;
+	*part = ret;
+	return 0;
+}
+
+/*
+ * Read a 64-bit information value from its two 31-bit parts, repeating if the
+ * value carried into the high part between the two calls.
+ */
+static int get_info_u64(unsigned int type, u64 *value)
+{
+	u32 high, low, check;
+	int err;
+
+	err = get_info_part(type | JAILHOUSE_INFO_HIGH_PART, &high);
+	while (!err) {
+		err = get_info_part(type, &low);
+		if (!err)
+			err = get_info_part(type | JAILHOUSE_INFO_HIGH_PART,
+					    &check);
+		if (!err && check == high) {
+			*value = ((u64)high << JAILHOUSE_INFO_PART_BITS) | low;
+			return 0;
+		}
+		high = check;
+	}
+	return err;
+}
+
+static ssize_t info_ns_show(struct device *dev, char *buffer,
+			    unsigned int type)
+{
+	u64 ticks = 0;
+	u32 khz = 0;
+	int err = 0;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0)
+		return -EINTR;
+
+	if (jailhouse_enabled) {
+		err = get_info_part(JAILHOUSE_INFO_TIMESTAMP_KHZ, &khz);
+		if (!err)
+			err = get_info_u64(type, &ticks);
+	}
+
+	mutex_unlock(&jailhouse_lock);
+
+	if (err)
+		return err;
+	return sprintf(buffer, "%llu\n", ticks_to_ns(ticks, khz));
+}
+
 static ssize_t mem_pool_size_show(struct device *dev,
 				  struct device_attribute *attr, char *buffer)
 {
@@ -381,6 +448,211 @@ static ssize_t remap_pool_used_show(struct device *dev,
 	return info_show(dev, buffer, JAILHOUSE_INFO_REMAP_POOL_USED);
 }
 
+static ssize_t suspend_count_show(struct device *dev,
+				  struct device_attribute *attr, char *buffer)
+{
+	return info_show(dev, buffer, JAILHOUSE_INFO_SUSPEND_COUNT);
+}
+
+static ssize_t suspend_signal_ns_show(struct device *dev,
+				      struct device_attribute *attr,
+				      char *buffer)
+{
+	return info_ns_show(dev, buffer, JAILHOUSE_INFO_SUSPEND_SIGNAL_LAST);
+}
+
+static ssize_t suspend_wait_ns_show(struct device *dev,
+				    struct device_attribute *attr,
+				    char *buffer)
+{
+	return info_ns_show(dev, buffer, JAILHOUSE_INFO_SUSPEND_WAIT_LAST);
+}
+
+static ssize_t suspend_max_ns_show(struct device *dev,
+				   struct device_attribute *attr, char *buffer)
+{
+	return info_ns_show(dev, buffer, JAILHOUSE_INFO_SUSPEND_MAX);
+}
+
+static ssize_t resume_ns_show(struct device *dev,
+			      struct device_attribute *attr, char *buffer)
+{
+	return info_ns_show(dev, buffer, JAILHOUSE_INFO_RESUME_LAST);
+}
+
+static const char *lock_class_names[JAILHOUSE_NUM_LOCK_CLASSES] = {
+	[JAILHOUSE_LOCK_OTHER] = "other",
+	[JAILHOUSE_LOCK_PRINTK] = "printk",
+	[JAILHOUSE_LOCK_SHUTDOWN] = "shutdown",
+	[JAILHOUSE_LOCK_CPU_CONTROL] = "cpu_control",
+	[JAILHOUSE_LOCK_MMIO_REGION] = "mmio_region",
+	[JAILHOUSE_LOCK_IVSHMEM_REMOTE] = "ivshmem_remote",
+	[JAILHOUSE_LOCK_IOAPIC] = "ioapic",
+	[JAILHOUSE_LOCK_VTD_INV_QUEUE] = "vtd_inv_queue",
+	[JAILHOUSE_LOCK_PCI] = "pci",
+	[JAILHOUSE_LOCK_GIC_DIST] = "gic_dist",
+};
+
+static ssize_t lock_stat_show(struct device *dev,
+			      struct device_attribute *attr, char *buffer)
+{
+	u64 stats[JAILHOUSE_NUM_LOCK_STATS];
+	unsigned int class, stat;
+	ssize_t result = 0;
+	u32 khz;
+	int err;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0)
+		return -EINTR;
+
+	if (!jailhouse_enabled)
+		goto unlock;
+
+	err = get_info_part(JAILHOUSE_INFO_TIMESTAMP_KHZ, &khz);
+	if (err) {
+		result = err;
+		goto unlock;
+	}
+
+	result = scnprintf(buffer, PAGE_SIZE, "%-16s %12s %12s %14s %16s\n",
+			   "class", "acquired", "contended", "wait_max_ns",
+			   "wait_total_ns");
+	for (class = 0; class < JAILHOUSE_NUM_LOCK_CLASSES; class++) {
+		for (stat = 0; stat < JAILHOUSE_NUM_LOCK_STATS; stat++) {
+			err = get_info_u64(JAILHOUSE_INFO_LOCK_STAT_BASE +
+					   class * JAILHOUSE_NUM_LOCK_STATS +
+					   stat, &stats[stat]);
+			if (err) {
+				result = err;
+				goto unlock;
+			}
+		}
+		result += scnprintf(buffer + result, PAGE_SIZE - result,
+			"%-16s %12llu %12llu %14llu %16llu\n",
+			lock_class_names[class],
+			stats[JAILHOUSE_LOCK_STAT_ACQUIRED],
+			stats[JAILHOUSE_LOCK_STAT_CONTENDED],
+			ticks_to_ns(stats[JAILHOUSE_LOCK_STAT_WAIT_MAX], khz),
+			ticks_to_ns(stats[JAILHOUSE_LOCK_STAT_WAIT_TOTAL],
+				    khz));
+	}
+
+unlock:
+	mutex_unlock(&jailhouse_lock);
+	return result;
+}
+
+static const char *lock_bench_names[] = {
+	[JAILHOUSE_LOCK_BENCH_TICKET] = "ticket",
+	[JAILHOUSE_LOCK_BENCH_MCS] = "mcs",
+};
+
+struct lock_bench_run {
+	unsigned int type;
+	unsigned int handoffs;
+	unsigned int cpu[2];
+	int result[2];
+	u64 total_ns;
+};
+
+/* last successful benchmark run, protected by jailhouse_lock */
+static struct lock_bench_run lock_bench_last;
+
+static void lock_bench_cpu(void *info)
+{
+	struct lock_bench_run *run = info;
+	unsigned int rank = smp_processor_id() == run->cpu[0] ? 0 : 1;
+
+	run->result[rank] = (int)jailhouse_call_arg2(JAILHOUSE_HC_LOCK_BENCH,
+						     run->type, run->handoffs);
+}
+
+static ssize_t lock_bench_show(struct device *dev,
+			       struct device_attribute *attr, char *buffer)
+{
+	ssize_t result = 0;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0)
+		return -EINTR;
+
+	if (lock_bench_last.handoffs)
+		result = sprintf(buffer, "%s %u %u %u %llu %llu\n",
+				 lock_bench_names[lock_bench_last.type],
+				 lock_bench_last.handoffs,
+				 lock_bench_last.cpu[0], lock_bench_last.cpu[1],
+				 lock_bench_last.total_ns,
+				 div_u64(lock_bench_last.total_ns,
+					 lock_bench_last.handoffs));
+
+	mutex_unlock(&jailhouse_lock);
+	return result;
+}
+
+/*
+ * Expects "<lock type> <handoffs> <cpu> <cpu>" and runs the benchmark on both
+ * root cell CPUs with interrupts disabled.
+ */
+static ssize_t lock_bench_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buffer, size_t count)
+{
+	struct lock_bench_run run;
+	cpumask_var_t cpus;
+	char name[8];
+	u32 khz;
+	int err;
+
+	if (sscanf(buffer, "%7s %u %u %u", name, &run.handoffs, &run.cpu[0],
+		   &run.cpu[1]) != 4)
+		return -EINVAL;
+	for (run.type = 0; run.type < ARRAY_SIZE(lock_bench_names);
+	     run.type++)
+		if (strcmp(name, lock_bench_names[run.type]) == 0)
+			break;
+	if (run.type == ARRAY_SIZE(lock_bench_names) ||
+	    run.cpu[0] == run.cpu[1] || run.cpu[0] >= nr_cpu_ids ||
+	    run.cpu[1] >= nr_cpu_ids)
+		return -EINVAL;
+
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_set_cpu(run.cpu[0], cpus);
+	cpumask_set_cpu(run.cpu[1], cpus);
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0) {
+		err = -EINTR;
+		goto free_out;
+	}
+
+	if (!jailhouse_enabled ||
+	    !cpumask_subset(cpus, &root_cell->cpus_assigned) ||
+	    !cpumask_subset(cpus, cpu_online_mask)) {
+		err = -EINVAL;
+		goto unlock_out;
+	}
+
+	run.result[0] = run.result[1] = -EIO;
+	on_each_cpu_mask(cpus, lock_bench_cpu, &run, true);
+
+	if (run.result[0] < 0)
+		err = run.result[0];
+	else if (run.result[1] < 0)
+		err = run.result[1];
+	else
+		err = get_info_part(JAILHOUSE_INFO_TIMESTAMP_KHZ, &khz);
+	if (!err) {
+		run.total_ns = ticks_to_ns(run.result[0], khz);
+		lock_bench_last = run;
+	}
+
+unlock_out:
+	mutex_unlock(&jailhouse_lock);
+free_out:
+	free_cpumask_var(cpus);
+
+	return err ? err : count;
+}
+
 static ssize_t core_show(struct file *filp, struct kobject *kobj,
 			 struct bin_attribute *attr, char *buf, loff_t off,
 			 size_t count)
@@ -389,12 +661,70 @@ static ssize_t core_show(struct file *filp, struct kobject *kobj,
 				       attr->size);
 }
 
+/*
+ * The trace and profile files are concatenations of per-CPU buffers. Reads
+ * are split at buffer boundaries and not synchronized with the hypervisor,
+ * see Documentation/tracing.md for how to obtain consistent records.
+ */
+static ssize_t percpu_buffer_read(struct bin_attribute *attr, char *buf,
+				  loff_t off, size_t count,
+				  unsigned long buffer_offset,
+				  size_t buffer_size)
+{
+	const struct jailhouse_header *header = hypervisor_mem;
+	unsigned int cpu;
+	u32 buffer_off;
+	loff_t pos;
+
+	if (off >= attr->size)
+		return 0;
+
+	cpu = div_u64_rem(off, buffer_size, &buffer_off);
+	count = min(count, buffer_size - buffer_off);
+	pos = buffer_off;
+
+	return memory_read_from_buffer(buf, count, &pos,
+				       hypervisor_mem + header->core_size +
+				       cpu * header->percpu_size +
+				       buffer_offset,
+				       buffer_size);
+}
+
+static ssize_t trace_show(struct file *filp, struct kobject *kobj,
+			  struct bin_attribute *attr, char *buf, loff_t off,
+			  size_t count)
+{
+	const struct jailhouse_header *header = hypervisor_mem;
+
+	return percpu_buffer_read(attr, buf, off, count, header->trace_offset,
+				  sizeof(struct jailhouse_trace_buffer));
+}
+
+static ssize_t profile_show(struct file *filp, struct kobject *kobj,
+			    struct bin_attribute *attr, char *buf, loff_t off,
+			    size_t count)
+{
+	const struct jailhouse_header *header = hypervisor_mem;
+
+	return percpu_buffer_read(attr, buf, off, count,
+				  header->profile_offset,
+				  sizeof(struct jailhouse_profile_buffer));
+}
+
 static DEVICE_ATTR_RO(console);
 static DEVICE_ATTR_RO(enabled);
 static DEVICE_ATTR_RO(mem_pool_size);
 static DEVICE_ATTR_RO(mem_pool_used);
 static DEVICE_ATTR_RO(remap_pool_size);
 static DEVICE_ATTR_RO(remap_pool_used);
+static DEVICE_ATTR_RO(suspend_count);
+static DEVICE_ATTR_RO(suspend_signal_ns);
+static DEVICE_ATTR_RO(suspend_wait_ns);
+static DEVICE_ATTR_RO(suspend_max_ns);
+static DEVICE_ATTR_RO(resume_ns);
+static DEVICE_ATTR_RO(lock_stat);
+static DEVICE_ATTR(lock_bench, S_IRUSR | S_IWUSR, lock_bench_show,
+		   lock_bench_store);
 
 static struct attribute *jailhouse_sysfs_entries[] = {
 	&dev_attr_console.attr,
@@ -403,6 +733,13 @@ static struct attribute *jailhouse_sysfs_entries[] = {
 	&dev_attr_mem_pool_used.attr,
 	&dev_attr_remap_pool_size.attr,
 	&dev_attr_remap_pool_used.attr,
+	&dev_attr_suspend_count.attr,
+	&dev_attr_suspend_signal_ns.attr,
+	&dev_attr_suspend_wait_ns.attr,
+	&dev_attr_suspend_max_ns.attr,
+	&dev_attr_resume_ns.attr,
+	&dev_attr_lock_stat.attr,
+	&dev_attr_lock_bench.attr,
 	NULL
 };
 
@@ -417,14 +754,57 @@ static struct bin_attribute bin_attr_core = {
 	.read = core_show,
 };
 
+static struct bin_attribute bin_attr_trace = {
+	.attr.name = "trace",
+	.attr.mode = S_IRUSR,
+	.read = trace_show,
+};
+
+static struct bin_attribute bin_attr_profile = {
+	.attr.name = "profile",
+	.attr.mode = S_IRUSR,
+	.read = profile_show,
+};
+
 int jailhouse_sysfs_core_init(struct device *dev, size_t hypervisor_size)
 {
+	const struct jailhouse_header *header = hypervisor_mem;
+	int err;
+
 	bin_attr_core.size = hypervisor_size;
-	return sysfs_create_bin_file(&dev->kobj, &bin_attr_core);
+	err = sysfs_create_bin_file(&dev->kobj, &bin_attr_core);
+	if (err)
+		return err;
+
+	if (header->trace_offset) {
+		bin_attr_trace.size = header->max_cpus *
+			sizeof(struct jailhouse_trace_buffer);
+		err = sysfs_create_bin_file(&dev->kobj, &bin_attr_trace);
+		if (err)
+			goto remove_core;
+	}
+
+	if (header->profile_offset) {
+		bin_attr_profile.size = header->max_cpus *
+			sizeof(struct jailhouse_profile_buffer);
+		err = sysfs_create_bin_file(&dev->kobj, &bin_attr_profile);
+		if (err)
+			goto remove_trace;
+	}
+
+	return 0;
+
+remove_trace:
+	sysfs_remove_bin_file(&dev->kobj, &bin_attr_trace);
+remove_core:
+	sysfs_remove_bin_file(&dev->kobj, &bin_attr_core);
+	return err;
 }
 
 void jailhouse_sysfs_core_exit(struct device *dev)
 {
+	sysfs_remove_bin_file(&dev->kobj, &bin_attr_profile);
+	sysfs_remove_bin_file(&dev->kobj, &bin_attr_trace);
 	sysfs_remove_bin_file(&dev->kobj, &bin_attr_core);
 }
 
@@ -144,7 +144,18 @@ bool arch_handle_phys_irq(u32 irqn, unsigned int count_event)
 		return true;
 	}
 
-	cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_VIRQ] += count_event;
+	/*
+	 * The timer interrupt is injected with the hardware bit set, so the
+	 * physical PPI stays active until the guest deactivates it. Only the
+	 * exit itself remains, account it separately to make the per-tick
+	 * overhead visible.
+	 */
+	if (irqn == VTIMER_IRQ)
+		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_VTIMER] +=
+			count_event;
+	else
+		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_VIRQ] +=
+			count_event;
 	irqchip_set_pending(cpu_public, irqn);
 
 	return false;
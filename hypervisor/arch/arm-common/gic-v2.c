@@ -269,6 +269,7 @@ static int gicv2_send_sgi(struct sgi *sgi)
 
 static int gicv2_inject_irq(u16 irq_id, u16 sender)
 {
+	u16 *lr_irq = this_cpu_public()->pending_irqs.lr_irq;
 	int i;
 	int first_free = -1;
 	u32 lr;
@@ -284,9 +285,11 @@ static int gicv2_inject_irq(u16 irq_id, u16 sender)
 			continue;
 		}
 
-		/* Check that there is no overlapping */
-		lr = gicv2_read_lr(i);
-		if ((lr & GICH_LR_VIRT_ID_MASK) == irq_id)
+		/*
+		 * Check that there is no overlapping. The shadow avoids
+		 * reading back each list register via MMIO.
+		 */
+		if (lr_irq[i] == irq_id)
 			return -EEXIST;
 	}
 
@@ -305,6 +308,7 @@ static int gicv2_inject_irq(u16 irq_id, u16 sender)
 	}
 
 	gicv2_write_lr(first_free, lr);
+	lr_irq[first_free] = irq_id;
 
 	return 0;
 }
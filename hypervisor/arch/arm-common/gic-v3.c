@@ -513,6 +513,7 @@ static void gicv3_eoi_irq(u32 irq_id, bool deactivate)
 
 static int gicv3_inject_irq(u16 irq_id, u16 sender)
 {
+	u16 *lr_irq = this_cpu_public()->pending_irqs.lr_irq;
 	int i;
 	int free_lr = -1;
 	u32 elsr;
@@ -529,15 +530,10 @@ static int gicv3_inject_irq(u16 irq_id, u16 sender)
 
 		/*
 		 * Entry is in use, check that it doesn't match the one we want
-		 * to inject.
+		 * to inject. A strict phys->virt id mapping is used for SPIs,
+		 * so comparing the shadowed ID is sufficient.
 		 */
-		lr = gicv3_read_lr(i);
-
-		/*
-		 * A strict phys->virt id mapping is used for SPIs, so this test
-		 * should be sufficient.
-		 */
-		if ((u32)lr == irq_id)
+		if (lr_irq[i] == irq_id)
 			return -EEXIST;
 	}
 
@@ -556,6 +552,7 @@ static int gicv3_inject_irq(u16 irq_id, u16 sender)
 	/* GICv3 doesn't support the injection of the calling CPU ID */
 
 	gicv3_write_lr(free_lr, lr);
+	lr_irq[free_lr] = irq_id;
 
 	return 0;
 }
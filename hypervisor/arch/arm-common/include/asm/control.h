@@ -16,6 +16,9 @@
 #define SGI_INJECT	0
 #define SGI_EVENT	1
 
+/* PPI of the EL1 virtual timer, as recommended by SBSA */
+#define VTIMER_IRQ	27
+
 #ifndef __ASSEMBLY__
 
 #include <jailhouse/percpu.h>
@@ -33,6 +36,10 @@ void arm_cpu_reset(unsigned long pc);
 void arm_cpu_park(void);
 void arm_cpu_kick(unsigned int cpu_id);
 
+void arm_pmu_cpu_init(void);
+void arm_pmu_cpu_reset(void);
+void arm_pmu_cpu_shutdown(void);
+
 static inline void arch_send_event(struct public_per_cpu *target_data)
 {
 	arm_cpu_kick(target_data->cpu_id);
@@ -13,7 +13,9 @@
 #ifndef _JAILHOUSE_ASM_IRQCHIP_H
 #define _JAILHOUSE_ASM_IRQCHIP_H
 
-#define MAX_PENDING_IRQS	256
+/* GICv2 supports up to 64 list registers, GICv3 up to 16 */
+#define MAX_LIST_REGS		64
+#define NUM_SGI_SENDERS		8
 
 #include <jailhouse/cell.h>
 #include <jailhouse/mmio.h>
@@ -68,14 +70,20 @@ struct irqchip {
 };
 
 struct pending_irqs {
-	/* synchronizes parallel insertions of SGIs into the pending ring */
-	spinlock_t lock;
-	u16 irqs[MAX_PENDING_IRQS];
-	/* contains the calling CPU ID in case of a SGI */
-	u16 sender[MAX_PENDING_IRQS];
-	unsigned int head;
-	/* removal from the ring happens lockless, thus tail is volatile */
-	volatile unsigned int tail;
+	/*
+	 * Interrupts that did not fit into the list registers. Other CPUs
+	 * only set bits atomically, the owning CPU clears them when
+	 * injecting. SGIs are tracked per sender, bit number
+	 * (irq_id * NUM_SGI_SENDERS + sender % NUM_SGI_SENDERS).
+	 */
+	volatile unsigned long sgis[16 * NUM_SGI_SENDERS / BITS_PER_LONG];
+	volatile unsigned long irqs[1024 / BITS_PER_LONG];
+	/*
+	 * Interrupt ID each list register was last loaded with. Only valid
+	 * for registers in use according to the ELSR, only accessed by the
+	 * owning CPU.
+	 */
+	u16 lr_irq[MAX_LIST_REGS];
 };
 
 int irqchip_cpu_init(struct per_cpu *cpu_data);
@@ -18,6 +18,7 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/unit.h>
 #include <asm/control.h>
 #include <asm/gic.h>
@@ -29,7 +30,7 @@
 	     (counter) < (config)->num_irqchips;			\
 	     (chip)++, (counter)++)
 
-DEFINE_SPINLOCK(dist_lock);
+DEFINE_SPINLOCK_CLASS(dist_lock, JAILHOUSE_LOCK_GIC_DIST);
 
 void *gicd_base;
 
@@ -175,6 +176,19 @@ static enum mmio_result gic_handle_dist_access(void *arg,
 	return ret;
 }
 
+static bool irqchip_has_spilled_irqs(const struct pending_irqs *pending)
+{
+	unsigned int n;
+
+	for (n = 0; n < ARRAY_SIZE(pending->sgis); n++)
+		if (pending->sgis[n])
+			return true;
+	for (n = 0; n < ARRAY_SIZE(pending->irqs); n++)
+		if (pending->irqs[n])
+			return true;
+	return false;
+}
+
 void irqchip_handle_irq(void)
 {
 	unsigned int count_event = 1;
@@ -205,6 +219,13 @@ void irqchip_handle_irq(void)
 		 */
 		irqchip.eoi_irq(irq_id, handled);
 	}
+
+	/*
+	 * Refill list registers the guest freed up meanwhile while we are
+	 * here anyway. This saves the separate maintenance interrupt.
+	 */
+	if (irqchip_has_spilled_irqs(&this_cpu_public()->pending_irqs))
+		irqchip_inject_pending();
 }
 
 bool irqchip_irq_in_cell(struct cell *cell, unsigned int irq_id)
@@ -225,9 +246,11 @@ void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
 	struct pending_irqs *pending = &cpu_public->pending_irqs;
 	bool local_injection = (this_cpu_public() == cpu_public);
 	const u16 sender = this_cpu_id();
-	unsigned int new_tail;
 	struct sgi sgi;
 
+	trace_event(JAILHOUSE_TRACE_IRQ_PENDING, irq_id,
+		    cpu_public ? cpu_public->cpu_id : -1);
+
 	if (!cpu_public) {
 		/* Injection via GICD */
 		mmio_write32(gicd_base + GICD_ISPENDR + (irq_id / 32) * 4,
@@ -238,23 +261,18 @@ void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
 	if (local_injection && irqchip.inject_irq(irq_id, sender) != -EBUSY)
 		return;
 
-	spin_lock(&pending->lock);
-
-	new_tail = (pending->tail + 1) % MAX_PENDING_IRQS;
-
-	/* Queue space available? */
-	if (new_tail != pending->head) {
-		pending->irqs[pending->tail] = irq_id;
-		pending->sender[pending->tail] = sender;
-		pending->tail = new_tail;
-		/*
-		 * Make the change to pending_irqs.tail visible before the
-		 * caller sends SGI_INJECT.
-		 */
-		memory_barrier();
-	}
+	/*
+	 * Spill into the pending bitmap. Multiple requests for the same
+	 * interrupt collapse into a single injection, like on a real GIC.
+	 */
+	if (is_sgi(irq_id))
+		set_bit(irq_id * NUM_SGI_SENDERS + sender % NUM_SGI_SENDERS,
+			pending->sgis);
+	else
+		set_bit(irq_id, pending->irqs);
 
-	spin_unlock(&pending->lock);
+	/* Make the pending bit visible before the caller sends SGI_INJECT. */
+	memory_barrier();
 
 	/*
 	 * The list registers are full, trigger maintenance interrupt if we are
@@ -274,25 +292,61 @@ void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
 	}
 }
 
-void irqchip_inject_pending(void)
+/*
+ * Refill the list registers from a pending bitmap in ascending bit order.
+ * Returns false if the list registers ran full.
+ */
+static bool inject_pending_bitmap(volatile unsigned long *bitmap,
+				  unsigned int num_words, bool sgis)
 {
-	struct pending_irqs *pending = &this_cpu_public()->pending_irqs;
-	u16 irq_id, sender;
+	unsigned int n, bit;
+	unsigned long word;
+	int err;
 
-	while (pending->head != pending->tail) {
-		irq_id = pending->irqs[pending->head];
-		sender = pending->sender[pending->head];
+	for (n = 0; n < num_words; n++) {
+		word = bitmap[n];
+		while (word) {
+			bit = ffsl(word);
+			word &= ~(1UL << bit);
+			bit += n * BITS_PER_LONG;
 
-		if (irqchip.inject_irq(irq_id, sender) == -EBUSY) {
 			/*
-			 * The list registers are full, trigger maintenance
-			 * interrupt and leave.
+			 * Clear before injecting so that a request arriving
+			 * in between is not lost.
 			 */
-			irqchip.enable_maint_irq(true);
-			return;
+			clear_bit(bit, bitmap);
+			if (sgis)
+				err = irqchip.inject_irq(bit / NUM_SGI_SENDERS,
+							 bit % NUM_SGI_SENDERS);
+			else
+				err = irqchip.inject_irq(bit, 0);
+			if (err == -EBUSY) {
+				set_bit(bit, bitmap);
+				return false;
+			}
 		}
+	}
+	return true;
+}
 
-		pending->head = (pending->head + 1) % MAX_PENDING_IRQS;
+void irqchip_inject_pending(void)
+{
+	struct pending_irqs *pending = &this_cpu_public()->pending_irqs;
+
+	/*
+	 * SGIs and PPIs go first as they carry IPIs and timer ticks, then
+	 * SPIs in the order of their IDs.
+	 */
+	if (!inject_pending_bitmap(pending->sgis, ARRAY_SIZE(pending->sgis),
+				   true) ||
+	    !inject_pending_bitmap(pending->irqs, ARRAY_SIZE(pending->irqs),
+				   false)) {
+		/*
+		 * The list registers are full, trigger maintenance
+		 * interrupt and leave.
+		 */
+		irqchip.enable_maint_irq(true);
+		return;
 	}
 
 	/*
@@ -352,8 +406,10 @@ u64 irqchip_get_cluster_target(unsigned int cpu_id)
 
 void irqchip_cpu_reset(struct per_cpu *cpu_data)
 {
-	cpu_data->public.pending_irqs.head = 0;
-	cpu_data->public.pending_irqs.tail = 0;
+	struct pending_irqs *pending = &cpu_data->public.pending_irqs;
+
+	memset((void *)pending->sgis, 0, sizeof(pending->sgis));
+	memset((void *)pending->irqs, 0, sizeof(pending->irqs));
 
 	irqchip.cpu_reset(cpu_data);
 }
@@ -361,6 +417,7 @@ void irqchip_cpu_reset(struct per_cpu *cpu_data)
 void irqchip_cpu_shutdown(struct public_per_cpu *cpu_public)
 {
 	struct pending_irqs *pending = &cpu_public->pending_irqs;
+	unsigned int n;
 	int irq_id;
 
 	/*
@@ -384,13 +441,12 @@ void irqchip_cpu_shutdown(struct public_per_cpu *cpu_public)
 	} while (irq_id >= 0);
 
 	/* Migrate interrupts queued in software. */
-	while (pending->head != pending->tail) {
-		irq_id = pending->irqs[pending->head];
-
-		irqchip.inject_phys_irq(irq_id);
-
-		pending->head = (pending->head + 1) % MAX_PENDING_IRQS;
-	}
+	for (n = 0; n < ARRAY_SIZE(pending->sgis) * BITS_PER_LONG; n++)
+		if (test_bit(n, pending->sgis))
+			irqchip.inject_phys_irq(n / NUM_SGI_SENDERS);
+	for (n = 0; n < ARRAY_SIZE(pending->irqs) * BITS_PER_LONG; n++)
+		if (test_bit(n, pending->irqs))
+			irqchip.inject_phys_irq(n);
 }
 
 static int irqchip_cell_init(struct cell *cell)
@@ -23,6 +23,14 @@ unsigned long phys_processor_id(void)
 	return mpidr & MPIDR_CPUID_MASK;
 }
 
+unsigned long timestamp_khz(void)
+{
+	unsigned long freq;
+
+	arm_read_sysreg(CNTFRQ_EL0, freq);
+	return freq / 1000;
+}
+
 unsigned int arm_cpu_by_mpidr(struct cell *cell, unsigned long mpidr)
 {
 	unsigned int cpu;
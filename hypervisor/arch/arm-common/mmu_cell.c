@@ -16,11 +16,106 @@
 #include <asm/sysregs.h>
 #include <asm/control.h>
 
+/*
+ * Validate a colored memory region and return the number of colors of the
+ * platform.
+ */
+static int colored_region_check(const struct cell *cell,
+				const struct jailhouse_memory *mem)
+{
+	u32 way_size = system_config->platform_info.arm.llc_way_size;
+	unsigned int num_colors = jailhouse_num_colors(way_size);
+
+	if (num_colors == 0 || num_colors > JAILHOUSE_MAX_COLORS ||
+	    (way_size & (way_size - 1)) || PAGE_SIZE != JAILHOUSE_COLOR_PAGE_SIZE)
+		return trace_error(-EINVAL);
+
+	if (mem->flags & (JAILHOUSE_MEM_IO | JAILHOUSE_MEM_COMM_REGION) ||
+	    jailhouse_mem_colors(mem, way_size) == 0)
+		return trace_error(-EINVAL);
+
+	/*
+	 * The root cell only gets pages of colored regions handed back and
+	 * taken away. Those ranges may be clipped by its own regions.
+	 */
+	if (cell != &root_cell &&
+	    ((mem->phys_start | mem->size) & (way_size - 1)))
+		return trace_error(-EINVAL);
+
+	return num_colors;
+}
+
+/*
+ * Walk all physically contiguous runs of pages in a colored memory region
+ * that match the region's colors. The runs are mapped consecutively starting
+ * at the region's virt_start, except for the root cell which has them mapped
+ * 1:1.
+ */
+static int colored_region_walk(const struct cell *cell,
+			       const struct jailhouse_memory *mem,
+			       int (*handler)(const struct cell *cell,
+					      unsigned long phys,
+					      unsigned long virt,
+					      unsigned long size, void *arg),
+			       void *arg)
+{
+	u32 colors = jailhouse_mem_colors(mem,
+			system_config->platform_info.arm.llc_way_size);
+	unsigned long phys = mem->phys_start;
+	unsigned long end = mem->phys_start + mem->size;
+	unsigned long virt = mem->virt_start;
+	unsigned long run_start;
+	int num_colors, err;
+	unsigned int color;
+
+	num_colors = colored_region_check(cell, mem);
+	if (num_colors < 0)
+		return num_colors;
+
+	color = (phys >> PAGE_SHIFT) % num_colors;
+	while (phys < end) {
+		if (!(colors & (1U << color))) {
+			phys += PAGE_SIZE;
+			color = (color + 1) % num_colors;
+			continue;
+		}
+
+		run_start = phys;
+		do {
+			phys += PAGE_SIZE;
+			color = (color + 1) % num_colors;
+		} while (phys < end && colors & (1U << color));
+
+		err = handler(cell, run_start,
+			      cell == &root_cell ? run_start : virt,
+			      phys - run_start, arg);
+		if (err)
+			return err;
+
+		virt += phys - run_start;
+	}
+
+	return 0;
+}
+
+static int colored_run_map(const struct cell *cell, unsigned long phys,
+			   unsigned long virt, unsigned long size, void *arg)
+{
+	return paging_create(&cell->arch.mm, phys, size, virt,
+			     *(unsigned long *)arg, PAGING_COHERENT);
+}
+
+static int colored_run_unmap(const struct cell *cell, unsigned long phys,
+			     unsigned long virt, unsigned long size, void *arg)
+{
+	return paging_destroy(&cell->arch.mm, virt, size, PAGING_COHERENT);
+}
+
 int arch_map_memory_region(struct cell *cell,
 			   const struct jailhouse_memory *mem)
 {
 	u64 phys_start = mem->phys_start;
-	u32 flags = PTE_FLAG_VALID | PTE_ACCESS_FLAG;
+	unsigned long flags = PTE_FLAG_VALID | PTE_ACCESS_FLAG;
 
 	if (mem->flags & JAILHOUSE_MEM_READ)
 		flags |= S2_PTE_ACCESS_RO;
@@ -28,8 +123,18 @@ int arch_map_memory_region(struct cell *cell,
 		flags |= S2_PTE_ACCESS_WO;
 	if (mem->flags & JAILHOUSE_MEM_IO)
 		flags |= S2_PTE_FLAG_DEVICE;
+	else if (mem->flags & JAILHOUSE_MEM_TYPE_MASK)
+		flags |= S2_PTE_FLAG_NC;
 	else
 		flags |= S2_PTE_FLAG_NORMAL;
+
+	if ((mem->flags & JAILHOUSE_MEM_TYPE_MASK) > JAILHOUSE_MEM_TYPE_WC ||
+	    (mem->flags & JAILHOUSE_MEM_SHARE_MASK) > JAILHOUSE_MEM_SHARE_OUTER)
+		return trace_error(-EINVAL);
+	if (mem->flags & JAILHOUSE_MEM_SHARE_INNER)
+		flags |= PTE_INNER_SHAREABLE;
+	else if (mem->flags & JAILHOUSE_MEM_SHARE_OUTER)
+		flags |= PTE_OUTER_SHAREABLE;
 	if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
 		phys_start = paging_hvirt2phys(&cell->comm_page);
 	/*
@@ -37,6 +142,9 @@ int arch_map_memory_region(struct cell *cell,
 		flags |= S2_PAGE_ACCESS_XN;
 	*/
 
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		return colored_region_walk(cell, mem, colored_run_map, &flags);
+
 	return paging_create(&cell->arch.mm, phys_start, mem->size,
 			     mem->virt_start, flags, PAGING_COHERENT);
 }
@@ -44,44 +152,64 @@ int arch_map_memory_region(struct cell *cell,
 int arch_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem)
 {
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		return colored_region_walk(cell, mem, colored_run_unmap, NULL);
+
 	return paging_destroy(&cell->arch.mm, mem->virt_start, mem->size,
 			      PAGING_COHERENT);
 }
 
+const struct paging_structures *arch_get_cell_paging(struct cell *cell)
+{
+	return &cell->arch.mm;
+}
+
 unsigned long arch_paging_gphys2phys(unsigned long gphys, unsigned long flags)
 {
 	/* Translate IPA->PA */
 	return paging_virt2phys(&this_cell()->arch.mm, gphys, flags);
 }
 
+static int dcaches_flush_range(const struct cell *cell, unsigned long phys,
+			       unsigned long virt, unsigned long size,
+			       void *arg)
+{
+	unsigned long chunk;
+
+	while (size > 0) {
+		chunk = MIN(size, NUM_TEMPORARY_PAGES * PAGE_SIZE);
+
+		/* cannot fail, mapping area is preallocated */
+		paging_create(&this_cpu_data()->pg_structs, phys, chunk,
+			      TEMPORARY_MAPPING_BASE, PAGE_DEFAULT_FLAGS,
+			      PAGING_NON_COHERENT);
+
+		arm_dcaches_flush((void *)TEMPORARY_MAPPING_BASE, chunk,
+				  *(enum dcache_flush *)arg);
+
+		phys += chunk;
+		size -= chunk;
+	}
+
+	return 0;
+}
+
 void arm_cell_dcaches_flush(struct cell *cell, enum dcache_flush flush)
 {
-	unsigned long region_addr, region_size, size;
 	struct jailhouse_memory const *mem;
 	unsigned int n;
 
-	for_each_mem_region(mem, cell->config, n) {
+	for_each_indexed_mem_region(mem, cell, n) {
 		if (mem->flags & (JAILHOUSE_MEM_IO | JAILHOUSE_MEM_COMM_REGION))
 			continue;
 
-		region_addr = mem->phys_start;
-		region_size = mem->size;
-
-		while (region_size > 0) {
-			size = MIN(region_size,
-				   NUM_TEMPORARY_PAGES * PAGE_SIZE);
-
-			/* cannot fail, mapping area is preallocated */
-			paging_create(&this_cpu_data()->pg_structs, region_addr,
-				      size, TEMPORARY_MAPPING_BASE,
-				      PAGE_DEFAULT_FLAGS, PAGING_NON_COHERENT);
-
-			arm_dcaches_flush((void *)TEMPORARY_MAPPING_BASE, size,
-					  flush);
-
-			region_addr += size;
-			region_size -= size;
-		}
+		/* only touch the cache lines of the cell's own colors */
+		if (mem->flags & JAILHOUSE_MEM_COLORED)
+			colored_region_walk(cell, mem, dcaches_flush_range,
+					    &flush);
+		else
+			dcaches_flush_range(cell, mem->phys_start, 0,
+					    mem->size, &flush);
 	}
 
 	/* ensure completion of the flush */
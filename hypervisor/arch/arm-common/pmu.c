@@ -0,0 +1,126 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/processor.h>
+#include <asm/control.h>
+#include <asm/sysregs.h>
+
+/* MDCR_EL2 bits controlled by the PMU policy */
+#define MDCR_PMU_MASK	(MDCR_HPMN_MASK | MDCR_TPMCR_BIT | MDCR_TPM_BIT | \
+			 MDCR_HPMD_BIT)
+
+/* PMU version from which on MDCR_EL2.HPMD is available (PMUv3p1) */
+#define PMU_VERSION_HPMD	4
+
+#define PMU_CYCLE_COUNTER	31
+
+static unsigned int pmu_version(void)
+{
+	unsigned long id;
+
+	arm_read_sysreg(PMU_ID_REG, id);
+	return PMU_ID_VERSION(id);
+}
+
+static bool pmu_present(unsigned int version)
+{
+	return version != 0 && version != 0xf;
+}
+
+static unsigned int pmu_num_counters(void)
+{
+	unsigned long pmcr;
+
+	/* reports all counters when read at EL2 */
+	arm_read_sysreg(PMCR_EL0, pmcr);
+	return PMCR_N(pmcr);
+}
+
+static void pmu_set_mdcr(unsigned long bits)
+{
+	unsigned long mdcr;
+
+	arm_read_sysreg(MDCR_EL2, mdcr);
+	arm_write_sysreg(MDCR_EL2, (mdcr & ~MDCR_PMU_MASK) | bits);
+	isb();
+}
+
+/* Stop and clear all counters and reset their configuration. */
+static void pmu_scrub(unsigned int counters)
+{
+	unsigned int n;
+
+	arm_write_sysreg(PMCR_EL0, PMCR_P_BIT | PMCR_C_BIT);
+	arm_write_sysreg(PMCNTENCLR_EL0, 0xffffffff);
+	arm_write_sysreg(PMINTENCLR_EL1, 0xffffffff);
+	arm_write_sysreg(PMOVSCLR_EL0, 0xffffffff);
+	arm_write_sysreg(PMUSERENR_EL0, 0);
+
+	for (n = 0; n < counters; n++) {
+		arm_write_sysreg(PMSELR_EL0, n);
+		arm_write_sysreg(PMXEVTYPER_EL0, 0);
+	}
+	arm_write_sysreg(PMSELR_EL0, PMU_CYCLE_COUNTER);
+	arm_write_sysreg(PMXEVTYPER_EL0, 0);
+	arm_write_sysreg(PMSELR_EL0, 0);
+}
+
+static void pmu_cpu_setup(struct cell *cell, bool scrub)
+{
+	unsigned int version = pmu_version();
+	unsigned int counters;
+	unsigned long mdcr;
+
+	if (!pmu_present(version))
+		return;
+
+	counters = pmu_num_counters();
+	if (scrub)
+		pmu_scrub(counters);
+
+	/* all counters belong to EL1 and EL0 */
+	mdcr = counters;
+	if (cell_owns_pmu(cell)) {
+		/* direct access, but do not count while in the hypervisor */
+		if (version >= PMU_VERSION_HPMD)
+			mdcr |= MDCR_HPMD_BIT;
+	} else {
+		/* trap all accesses, they are emulated as RAZ/WI */
+		mdcr |= MDCR_TPM_BIT | MDCR_TPMCR_BIT;
+	}
+	pmu_set_mdcr(mdcr);
+}
+
+/**
+ * Hand the PMU of the calling CPU over to the root cell on hypervisor
+ * activation.
+ *
+ * The counters are only wiped if the root cell does not own the PMU so that
+ * running measurements of an owning root cell continue.
+ */
+void arm_pmu_cpu_init(void)
+{
+	pmu_cpu_setup(&root_cell, !cell_owns_pmu(&root_cell));
+}
+
+/**
+ * Wipe the PMU of the calling CPU and apply the policy of its current cell.
+ */
+void arm_pmu_cpu_reset(void)
+{
+	pmu_cpu_setup(this_cell(), true);
+}
+
+/**
+ * Return full control over the PMU of the calling CPU to Linux.
+ */
+void arm_pmu_cpu_shutdown(void)
+{
+	if (pmu_present(pmu_version()))
+		pmu_set_mdcr(pmu_num_counters());
+}
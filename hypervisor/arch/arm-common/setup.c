@@ -13,6 +13,7 @@
 #include <jailhouse/control.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/processor.h>
+#include <asm/control.h>
 #include <asm/setup.h>
 
 static u32 __attribute__((aligned(PAGE_SIZE))) parking_code[PAGE_SIZE / 4] = {
@@ -42,5 +43,7 @@ int arm_cpu_init(struct per_cpu *cpu_data)
 
 	arm_paging_vcpu_init(&root_cell.arch.mm);
 
+	arm_pmu_cpu_init();
+
 	return irqchip_cpu_init(cpu_data);
 }
@@ -65,6 +65,10 @@ void arm_cpu_reset(unsigned long pc)
 	arm_write_sysreg(CNTP_CVAL_EL0, 0);
 	arm_write_sysreg(CNTV_CTL_EL0, 0);
 	arm_write_sysreg(CNTV_CVAL_EL0, 0);
+	/* deadlines programmed via CNTV_CVAL are based on the physical count */
+	arm_write_sysreg(CNTVOFF_EL2, 0);
+
+	arm_pmu_cpu_reset();
 
 	/* AArch32 specific */
 	arm_write_sysreg(TTBCR, 0);
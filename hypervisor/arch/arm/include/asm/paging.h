@@ -143,6 +143,7 @@
 /* Stage 2 memory attributes (MemAttr[3:0]) */
 #define S2_MEMATTR_OWBIWB	0xf
 #define S2_MEMATTR_DEV		0x1
+#define S2_MEMATTR_ONCINC	0x5
 
 #define S1_PTE_FLAG_NORMAL	PTE_MEMATTR(HMAIR_IDX_WBRAWA)
 #define S1_PTE_FLAG_DEVICE	PTE_MEMATTR(HMAIR_IDX_DEV)
@@ -150,6 +151,7 @@
 
 #define S2_PTE_FLAG_NORMAL	PTE_MEMATTR(S2_MEMATTR_OWBIWB)
 #define S2_PTE_FLAG_DEVICE	PTE_MEMATTR(S2_MEMATTR_DEV)
+#define S2_PTE_FLAG_NC		PTE_MEMATTR(S2_MEMATTR_ONCINC)
 
 #define S1_DEFAULT_FLAGS	(PTE_FLAG_VALID | PTE_ACCESS_FLAG	\
 				| S1_PTE_FLAG_NORMAL | PTE_INNER_SHAREABLE\
@@ -224,6 +226,15 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 	}
 }
 
+/* Only executed on cell paging struct changes, affects all VMIDs */
+static inline void arch_paging_flush_cell_tlbs(void)
+{
+	dsb(ishst);
+	arm_write_sysreg(TLBIALLNSNHIS, 0);
+	dsb(ish);
+	isb();
+}
+
 /* Used to clean the PAGING_COHERENT page table changes */
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
 {
@@ -59,6 +59,16 @@ static inline void memory_load_barrier(void)
 {
 }
 
+static inline u64 get_timestamp(void)
+{
+	u64 cnt;
+
+	isb();
+	arm_read_sysreg(CNTPCT_EL0, cnt);
+
+	return cnt;
+}
+
 static inline bool is_el2(void)
 {
 	u32 psr;
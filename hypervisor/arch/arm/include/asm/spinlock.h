@@ -18,7 +18,6 @@
 
 #ifndef __ASSEMBLY__
 
-#define DEFINE_SPINLOCK(name)	spinlock_t (name)
 #define TICKET_SHIFT		16
 
 typedef struct {
@@ -29,13 +28,14 @@ typedef struct {
 			u16 next;
 		} tickets;
 	};
-} spinlock_t;
+} arch_spinlock_t;
 
-static inline void spin_lock(spinlock_t *lock)
+static inline bool arch_spin_lock(arch_spinlock_t *lock)
 {
 	unsigned long tmp;
 	u32 newval;
-	spinlock_t lockval;
+	arch_spinlock_t lockval;
+	bool contended;
 
 	/* Take the lock by updating the high part atomically */
 	asm volatile (
@@ -51,6 +51,7 @@ static inline void spin_lock(spinlock_t *lock)
 		: "r" (&lock->slock), "I" (1 << TICKET_SHIFT)
 		: "cc");
 
+	contended = lockval.tickets.next != lockval.tickets.owner;
 	while (lockval.tickets.next != lockval.tickets.owner)
 		asm volatile (
 			"wfe\n\t"
@@ -60,9 +61,11 @@ static inline void spin_lock(spinlock_t *lock)
 
 	/* Ensure we have the lock before doing any more memory ops */
 	dmb(ish);
+
+	return contended;
 }
 
-static inline void spin_unlock(spinlock_t *lock)
+static inline void arch_spin_unlock(arch_spinlock_t *lock)
 {
 	/* Ensure all memory ops are finished before releasing the lock */
 	dmb(ish);
@@ -64,6 +64,10 @@
 #define ID_PFR0_EL1	SYSREG_32(0, c0, c1, 0)
 #define ID_PFR1_EL1	SYSREG_32(0, c0, c1, 1)
 #define  PFR1_VIRT(pfr)		((pfr) >> 12 & 0xf)
+#define ID_DFR0_EL1	SYSREG_32(0, c0, c1, 2)
+/* ID register holding the PMU version, 0 and 0xf mean no PMU */
+#define  PMU_ID_REG		ID_DFR0_EL1
+#define  PMU_ID_VERSION(id)	((id) >> 24 & 0xf)
 #define SCTLR_EL1	SYSREG_32(0, c1, c0, 0)
 #define  SCTLR_M_BIT		(1 << 0)
 #define  SCTLR_A_BIT		(1 << 1)
@@ -169,6 +173,7 @@
 #define CNTV_CVAL_EL0	SYSREG_64(3, c14)
 
 #define CNTPCT_EL0	SYSREG_64(0, c14)
+#define CNTVOFF_EL2	SYSREG_64(4, c14)
 
 /*
  * AArch32-specific registers: they are 64bit on AArch64, and will need some
@@ -217,6 +222,23 @@
 #define HMAIR0		SYSREG_32(4, c10, c2, 0)
 #define HMAIR1		SYSREG_32(4, c10, c2, 1)
 #define HVBAR		SYSREG_32(4, c12, c0, 0)
+#define MDCR_EL2	SYSREG_32(4, c1, c1, 1)
+#define  MDCR_HPMN_MASK		0x1f
+#define  MDCR_TPMCR_BIT		(1 << 5)
+#define  MDCR_TPM_BIT		(1 << 6)
+#define  MDCR_HPMD_BIT		(1 << 17)
+
+/* Performance monitors */
+#define PMCR_EL0	SYSREG_32(0, c9, c12, 0)
+#define  PMCR_P_BIT		(1 << 1)
+#define  PMCR_C_BIT		(1 << 2)
+#define  PMCR_N(pmcr)		((pmcr) >> 11 & 0x1f)
+#define PMCNTENCLR_EL0	SYSREG_32(0, c9, c12, 2)
+#define PMOVSCLR_EL0	SYSREG_32(0, c9, c12, 3)
+#define PMSELR_EL0	SYSREG_32(0, c9, c12, 5)
+#define PMXEVTYPER_EL0	SYSREG_32(0, c9, c13, 1)
+#define PMUSERENR_EL0	SYSREG_32(0, c9, c14, 0)
+#define PMINTENCLR_EL1	SYSREG_32(0, c9, c14, 2)
 
 /* Mapped to HSR, IFSR32 and FAR in AArch64 */
 #define DFSR		SYSREG_32(0, c5, c0, 0)
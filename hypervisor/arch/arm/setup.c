@@ -120,6 +120,7 @@ void __attribute__((noreturn)) arch_cpu_activate_vmm(void)
 void arch_shutdown_self(struct per_cpu *cpu_data)
 {
 	irqchip_cpu_shutdown(&cpu_data->public);
+	arm_pmu_cpu_shutdown();
 
 	/* Free the guest */
 	arm_write_sysreg(HCR, 0);
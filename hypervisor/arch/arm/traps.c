@@ -16,6 +16,7 @@
 
 #include <jailhouse/control.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/trace.h>
 #include <asm/control.h>
 #include <asm/gic.h>
 #include <asm/psci.h>
@@ -299,8 +300,16 @@ static int arch_handle_cp15_32(struct trap_context *ctx)
 	if (!read)
 		access_cell_reg(ctx, rt, &val, true);
 
+	/*
+	 * PMU registers, trapped by HDCR.TPM(CR) for cells not owning the PMU.
+	 * Read-as-zero, write-ignored.
+	 */
+	if ((GET_FIELD(hsr, 13, 10) == 9 && GET_FIELD(hsr, 4, 1) >= 12) ||
+	    (GET_FIELD(hsr, 13, 10) == 14 && GET_FIELD(hsr, 4, 1) >= 8)) {
+		val = 0;
+	}
 	/* trapped by HCR.TAC */
-	if (HSR_MATCH_MCR_MRC(ctx->hsr, 1, 0, 0, 1)) { /* ACTLR */
+	else if (HSR_MATCH_MCR_MRC(ctx->hsr, 1, 0, 0, 1)) { /* ACTLR */
 		/* Do not let the guest disable coherency by writing ACTLR... */
 		if (read)
 			arm_read_sysreg(ACTLR_EL1, val);
@@ -488,6 +497,7 @@ static void arch_dump_abt(bool is_data)
 union registers* arch_handle_exit(union registers *regs)
 {
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL]++;
+	trace_event(JAILHOUSE_TRACE_VMEXIT, regs->exit_reason, 0);
 
 	switch (regs->exit_reason) {
 	case EXIT_REASON_IRQ:
@@ -25,7 +25,6 @@ void arm_cpu_reset(unsigned long pc)
 	arm_write_sysreg(SPSR_EL2, RESET_PSR);
 	arm_write_sysreg(SCTLR_EL1, SCTLR_EL1_RES1);
 	arm_write_sysreg(CNTKCTL_EL1, 0);
-	arm_write_sysreg(PMCR_EL0, 0);
 
 	/* wipe any other state to avoid leaking information accross cells */
 	memset(&this_cpu_data()->guest_regs, 0, sizeof(union registers));
@@ -63,8 +62,11 @@ void arm_cpu_reset(unsigned long pc)
 	arm_write_sysreg(CNTV_CTL_EL0, 0);
 	arm_write_sysreg(CNTV_CVAL_EL0, 0);
 	arm_write_sysreg(CNTV_TVAL_EL0, 0);
+	/* deadlines programmed via CNTV_CVAL are based on the physical count */
+	arm_write_sysreg(CNTVOFF_EL2, 0);
+
+	arm_pmu_cpu_reset();
 
-	/* AARCH64_TODO: handle PMU registers */
 	/* AARCH64_TODO: handle debug registers */
 	/* AARCH64_TODO: handle system registers for AArch32 state */
 
@@ -140,6 +140,7 @@
 /* Stage 2 memory attributes (MemAttr[3:0]) */
 #define S2_MEMATTR_OWBIWB	0xf
 #define S2_MEMATTR_DEV		0x1
+#define S2_MEMATTR_ONCINC	0x5
 
 #define S1_PTE_FLAG_NORMAL	PTE_MEMATTR(MAIR_IDX_WBRAWA)
 #define S1_PTE_FLAG_DEVICE	PTE_MEMATTR(MAIR_IDX_DEV)
@@ -147,6 +148,7 @@
 
 #define S2_PTE_FLAG_NORMAL	PTE_MEMATTR(S2_MEMATTR_OWBIWB)
 #define S2_PTE_FLAG_DEVICE	PTE_MEMATTR(S2_MEMATTR_DEV)
+#define S2_PTE_FLAG_NC		PTE_MEMATTR(S2_MEMATTR_ONCINC)
 
 #define S1_DEFAULT_FLAGS	(PTE_FLAG_VALID | PTE_ACCESS_FLAG	\
 				| S1_PTE_FLAG_NORMAL | PTE_INNER_SHAREABLE\
@@ -240,6 +242,15 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 		: : "r" (page_addr >> PAGE_SHIFT));
 }
 
+/* Only executed on cell paging struct changes, affects all VMIDs */
+static inline void arch_paging_flush_cell_tlbs(void)
+{
+	dsb(ishst);
+	asm volatile("tlbi alle1is");
+	dsb(ish);
+	isb();
+}
+
 /* Used to clean the PAGE_MAP_COHERENT page table changes */
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
 {
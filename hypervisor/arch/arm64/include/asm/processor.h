@@ -53,6 +53,16 @@ static inline void memory_load_barrier(void)
 {
 }
 
+static inline u64 get_timestamp(void)
+{
+	u64 cnt;
+
+	isb();
+	asm volatile("mrs	%0, cntpct_el0" : "=r" (cnt));
+
+	return cnt;
+}
+
 #endif /* !__ASSEMBLY__ */
 
 #endif /* !_JAILHOUSE_ASM_PROCESSOR_H */
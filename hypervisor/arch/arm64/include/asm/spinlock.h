@@ -21,19 +21,18 @@
 
 #include <jailhouse/types.h>
 
-#define DEFINE_SPINLOCK(name)	spinlock_t (name)
 #define TICKET_SHIFT	16
 
 /* TODO: fix this if we add support for BE */
 typedef struct {
 	u16 owner;
 	u16 next;
-} spinlock_t __attribute__((aligned(4)));
+} arch_spinlock_t __attribute__((aligned(4)));
 
-static inline void spin_lock(spinlock_t *lock)
+static inline bool arch_spin_lock(arch_spinlock_t *lock)
 {
 	unsigned int tmp;
-	spinlock_t lockval, newval;
+	arch_spinlock_t lockval, newval;
 
 	asm volatile(
 	/* Atomically increment the next ticket. */
@@ -59,9 +58,12 @@ static inline void spin_lock(spinlock_t *lock)
 	: "=&r" (lockval), "=&r" (newval), "=&r" (tmp), "+Q" (*lock)
 	: "Q" (lock->owner), "I" (1 << TICKET_SHIFT)
 	: "memory");
+
+	/* lockval still holds the ticket state found before taking one */
+	return lockval.owner != lockval.next;
 }
 
-static inline void spin_unlock(spinlock_t *lock)
+static inline void arch_spin_unlock(arch_spinlock_t *lock)
 {
 	asm volatile(
 "	stlrh	%w1, %0\n"
@@ -106,6 +106,19 @@
 #define HCR_SWIO_BIT	(1u << 1)
 #define HCR_VM_BIT	(1u << 0)
 
+#define MDCR_HPMN_MASK	0x1f
+#define MDCR_TPMCR_BIT	(1u << 5)
+#define MDCR_TPM_BIT	(1u << 6)
+#define MDCR_HPMD_BIT	(1u << 17)
+
+#define PMCR_P_BIT	(1u << 1)
+#define PMCR_C_BIT	(1u << 2)
+#define PMCR_N(pmcr)	GET_FIELD((pmcr), 15, 11)
+
+/* ID register holding the PMU version, 0 and 0xf mean no PMUv3 */
+#define PMU_ID_REG		ID_AA64DFR0_EL1
+#define PMU_ID_VERSION(id)	GET_FIELD((id), 11, 8)
+
 /* exception class */
 #define ESR_EC(esr)		GET_FIELD((esr), 31, 26)
 /* instruction length */
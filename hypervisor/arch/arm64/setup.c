@@ -91,6 +91,7 @@ void arch_shutdown_self(struct per_cpu *cpu_data)
 		(void (*)(struct per_cpu *))paging_hvirt2phys(shutdown_el2);
 
 	irqchip_cpu_shutdown(&cpu_data->public);
+	arm_pmu_cpu_shutdown();
 
 	/* Free the guest */
 	arm_write_sysreg(HCR_EL2, HCR_RW_BIT);
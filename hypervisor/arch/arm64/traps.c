@@ -13,6 +13,7 @@
 
 #include <jailhouse/control.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/trace.h>
 #include <asm/control.h>
 #include <asm/entry.h>
 #include <asm/gic.h>
@@ -55,8 +56,22 @@ static int handle_sysreg(struct trap_context *ctx)
 {
 	u32 esr = ctx->esr;
 	u32 rt  = (esr >> 5) & 0x1f;
+	u32 crn = GET_FIELD(esr, 13, 10);
+	u32 crm = GET_FIELD(esr, 4, 1);
+
+	/*
+	 * PMU registers, trapped by MDCR_EL2.TPM(CR) for cells not owning the
+	 * PMU. Read-as-zero, write-ignored.
+	 */
+	if (GET_FIELD(esr, 21, 20) == 3 &&
+	    ((crn == 9 && crm >= 12) || (crn == 14 && crm >= 8))) {
+		if ((esr & 1) && rt != 31)
+			ctx->regs[rt] = 0;
+		arch_skip_instruction(ctx);
+		return TRAP_HANDLED;
+	}
 
-	/* All handled registers are write-only. */
+	/* All other handled registers are write-only. */
 	if (esr & 1)
 		return TRAP_UNHANDLED;
 
@@ -195,6 +210,7 @@ static void arch_dump_exit(union registers *regs, const char *reason)
 union registers *arch_handle_exit(union registers *regs)
 {
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL]++;
+	trace_event(JAILHOUSE_TRACE_VMEXIT, regs->exit_reason, 0);
 
 	switch (regs->exit_reason) {
 	case EXIT_REASON_EL1_IRQ:
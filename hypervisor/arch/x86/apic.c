@@ -17,6 +17,7 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/control.h>
 #include <jailhouse/mmio.h>
+#include <jailhouse/profile.h>
 #include <asm/apic.h>
 #include <asm/bitops.h>
 #include <asm/control.h>
@@ -209,6 +210,16 @@ int apic_init(void)
 	return 0;
 }
 
+u32 apic_read_lvtpc(void)
+{
+	return apic_ops.read(APIC_REG_LVTPC);
+}
+
+void apic_write_lvtpc(u32 val)
+{
+	apic_ops.write(APIC_REG_LVTPC, val);
+}
+
 void apic_send_nmi_ipi(struct public_per_cpu *target_data)
 {
 	apic_ops.send_ipi(target_data->apic_id,
@@ -317,7 +328,8 @@ void apic_clear(void)
 	apic_mask_lvt(APIC_REG_LVTT);
 	if (maxlvt >= 5)
 		apic_mask_lvt(APIC_REG_LVTTHMR);
-	if (maxlvt >= 4)
+	/* the hypervisor profiler keeps performance counter NMIs */
+	if (maxlvt >= 4 && !profile_active())
 		apic_mask_lvt(APIC_REG_LVTPC);
 	apic_mask_lvt(APIC_REG_LVT0);
 	apic_mask_lvt(APIC_REG_LVT1);
@@ -525,6 +537,8 @@ unsigned int apic_mmio_access(const struct guest_paging_structures *pg_structs,
 			panic_printk("FATAL: Unsupported change to DFR: %x\n",
 				     val);
 			return 0;
+		} else if (reg == APIC_REG_LVTPC && profile_active()) {
+			/* owned by the hypervisor profiler, ignore */
 		} else if (reg >= APIC_REG_LVTCMCI && reg <= APIC_REG_LVTERR &&
 			   apic_invalid_lvt_delivery_mode(reg, val))
 			return 0;
@@ -554,6 +568,9 @@ bool x2apic_handle_write(void)
 		printk("Unhandled x2APIC self IPI write\n");
 	else if (reg == APIC_REG_ICR)
 		return apic_handle_icr_write(val, guest_regs->rdx);
+	else if (reg == APIC_REG_LVTPC && profile_active())
+		/* owned by the hypervisor profiler, ignore */
+		return true;
 	else if (reg >= APIC_REG_LVTCMCI && reg <= APIC_REG_LVTERR &&
 		 apic_invalid_lvt_delivery_mode(reg, val))
 		return false;
@@ -18,6 +18,7 @@
 #include <asm/control.h>
 #include <asm/ioapic.h>
 #include <asm/iommu.h>
+#include <asm/profile.h>
 #include <asm/vcpu.h>
 
 struct exception_frame {
@@ -46,6 +47,10 @@ int arch_map_memory_region(struct cell *cell,
 {
 	int err;
 
+	/* cache coloring is only supported on ARM */
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		return trace_error(-EINVAL);
+
 	err = vcpu_map_memory_region(cell, mem);
 	if (err)
 		return err;
@@ -56,6 +61,11 @@ int arch_map_memory_region(struct cell *cell,
 	return err;
 }
 
+const struct paging_structures *arch_get_cell_paging(struct cell *cell)
+{
+	return vcpu_vendor_get_cell_paging(cell);
+}
+
 int arch_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem)
 {
@@ -107,6 +117,11 @@ void arch_cell_reset(struct cell *cell)
 	ioapic_cell_reset(cell);
 }
 
+unsigned long timestamp_khz(void)
+{
+	return system_config->platform_info.x86.tsc_khz;
+}
+
 void arch_config_commit(struct cell *cell_added_removed)
 {
 	iommu_config_commit(cell_added_removed);
@@ -238,6 +253,17 @@ void x86_check_events(void)
 	iommu_check_pending_faults();
 }
 
+void x86_nmi_handler(unsigned long rip)
+{
+	profile_handle_nmi(rip);
+
+	/*
+	 * A profiling NMI may have merged with an event NMI, so always let
+	 * the vCPU check for events.
+	 */
+	vcpu_nmi_handler();
+}
+
 void __attribute__((noreturn))
 x86_exception_handler(struct exception_frame *frame)
 {
@@ -156,6 +156,9 @@ int apic_cpu_init(struct per_cpu *cpu_data);
 
 void apic_clear(void);
 
+u32 apic_read_lvtpc(void);
+void apic_write_lvtpc(u32 val);
+
 void apic_send_nmi_ipi(struct public_per_cpu *target_data);
 bool apic_filter_irq_dest(struct cell *cell, struct apic_irq_message *irq_msg);
 void apic_send_irq(struct apic_irq_message irq_msg);
@@ -21,6 +21,8 @@ void x86_send_init_sipi(unsigned int cpu_id, enum x86_init_sipi type,
 
 void x86_check_events(void);
 
+void x86_nmi_handler(unsigned long rip);
+
 void __attribute__((noreturn))
 x86_exception_handler(struct exception_frame *frame);
 
@@ -11,7 +11,7 @@
  */
 
 #include <jailhouse/cell.h>
-#include <asm/spinlock.h>
+#include <jailhouse/spinlock.h>
 
 /*
  * There can be up to 240 pins according to the specs, but it remains unclear
@@ -65,8 +65,18 @@ struct phys_ioapic {
 	unsigned int pins;
 	/** Lock protecting physical accesses. */
 	spinlock_t lock;
+	/**
+	 * Values of the ID, version and arbitration registers. Cells cannot
+	 * modify them, so they are read from the hardware only once.
+	 */
+	u32 id_regs[3];
 	/** Shadow state of redirection entries as seen by the cells. */
 	union ioapic_redir_entry shadow_redir_table[IOAPIC_MAX_PINS];
+	/**
+	 * Redirection entries as last written to the hardware, i.e. after
+	 * translation. Protected by @c lock.
+	 */
+	union ioapic_redir_entry phys_redir_table[IOAPIC_MAX_PINS];
 };
 
 /**
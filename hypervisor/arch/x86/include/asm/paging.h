@@ -62,6 +62,14 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 	asm volatile("invlpg (%0)" : : "r" (page_addr));
 }
 
+/*
+ * x86 does not require break-before-make. Cells whose paging structures are
+ * modified are suspended and flush their TLBs before they resume.
+ */
+static inline void arch_paging_flush_cell_tlbs(void)
+{
+}
+
 extern unsigned long cache_line_size;
 
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
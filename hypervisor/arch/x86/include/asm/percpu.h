@@ -69,6 +69,7 @@
 	struct segment linux_gs;					\
 	struct segment linux_tss;					\
 	unsigned long linux_efer;					\
+	u32 linux_lvtpc;						\
 	/** @} */							\
 									\
 	/** Shadow states. @{ */					\
@@ -97,6 +98,10 @@
 	/** Number of iterations to clear pending APIC IRQs. */		\
 	unsigned int num_clear_apic_irqs;				\
 									\
+	/** True if a counter overflow NMI is to be forwarded to the	\
+	 *  cell. */							\
+	bool pmi_pending;						\
+									\
 	union {								\
 		struct {						\
 			/** VMXON region, required by VMX. */		\
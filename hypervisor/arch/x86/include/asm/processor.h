@@ -28,7 +28,12 @@
 #define X86_FEATURE_OSXSAVE				(1 << 27)
 #define X86_FEATURE_HYPERVISOR				(1 << 31)
 
+/* leaf 0x01, EDX */
+#define X86_FEATURE_DS					(1 << 21)
+
 /* leaf 0x07, subleaf 0, EBX */
+#define X86_FEATURE_HLE					(1 << 4)
+#define X86_FEATURE_RTM					(1 << 11)
 #define X86_FEATURE_INVPCID				(1 << 10)
 #define X86_FEATURE_CAT					(1 << 15)
 
@@ -37,6 +42,7 @@
 
 /* leaf 0x80000001, ECX */
 #define X86_FEATURE_SVM					(1 << 2)
+#define X86_FEATURE_PERFCTR_CORE			(1 << 23)
 
 /* leaf 0x80000001, EDX */
 #define X86_FEATURE_GBPAGES				(1 << 26)
@@ -72,12 +78,20 @@
 
 #define MSR_IA32_APICBASE				0x0000001b
 #define MSR_IA32_FEATURE_CONTROL			0x0000003a
+#define MSR_IA32_PMC0					0x000000c1
 #define MSR_IA32_PAT					0x00000277
 #define MSR_IA32_MTRR_DEF_TYPE				0x000002ff
 #define MSR_IA32_SYSENTER_CS				0x00000174
 #define MSR_IA32_SYSENTER_ESP				0x00000175
 #define MSR_IA32_SYSENTER_EIP				0x00000176
+#define MSR_IA32_PERFEVTSEL0				0x00000186
+#define MSR_IA32_PERFEVTSEL7				0x0000018d
+#define MSR_IA32_FIXED_CTR0				0x00000309
+#define MSR_IA32_FIXED_CTR_CTRL				0x0000038d
+#define MSR_IA32_PERF_GLOBAL_STATUS			0x0000038e
 #define MSR_IA32_PERF_GLOBAL_CTRL			0x0000038f
+#define MSR_IA32_PERF_GLOBAL_OVF_CTRL			0x00000390
+#define MSR_IA32_PEBS_ENABLE				0x000003f1
 #define MSR_IA32_VMX_BASIC				0x00000480
 #define MSR_IA32_VMX_PINBASED_CTLS			0x00000481
 #define MSR_IA32_VMX_PROCBASED_CTLS			0x00000482
@@ -91,8 +105,10 @@
 #define MSR_IA32_VMX_PROCBASED_CTLS2			0x0000048b
 #define MSR_IA32_VMX_EPT_VPID_CAP			0x0000048c
 #define MSR_IA32_VMX_TRUE_PROCBASED_CTLS		0x0000048e
+#define MSR_IA32_A_PMC0					0x000004c1
 #define MSR_X2APIC_BASE					0x00000800
 #define MSR_X2APIC_ICR					0x00000830
+#define MSR_X2APIC_LVTPC				0x00000834
 #define MSR_X2APIC_END					0x0000083f
 #define MSR_IA32_PQR_ASSOC				0x00000c8f
 #define MSR_IA32_L3_MASK_0				0x00000c90
@@ -104,6 +120,11 @@
 #define MSR_FS_BASE					0xc0000100
 #define MSR_GS_BASE					0xc0000101
 #define MSR_KERNGS_BASE					0xc0000102
+#define MSR_AMD_PERF_CTL0				0xc0010000
+#define MSR_AMD_PERF_CTL3				0xc0010003
+#define MSR_AMD_PERF_CTR0				0xc0010004
+#define MSR_AMD_PERF_CTL_EXT0				0xc0010200
+#define MSR_AMD_PERF_CTL_EXT5				0xc001020a
 
 #define FEATURE_CONTROL_LOCKED				(1 << 0)
 #define FEATURE_CONTROL_VMXON_ENABLED_OUTSIDE_SMX	(1 << 2)
@@ -114,6 +135,24 @@
 
 #define MTRR_ENABLE					(1UL << 11)
 
+#define PERFEVTSEL_USR					(1UL << 16)
+#define PERFEVTSEL_OS					(1UL << 17)
+#define PERFEVTSEL_INT					(1UL << 20)
+#define PERFEVTSEL_ANY					(1UL << 21)
+#define PERFEVTSEL_EN					(1UL << 22)
+#define PERFEVTSEL_IN_TX				(1UL << 32)
+#define PERFEVTSEL_IN_TXCP				(1UL << 33)
+#define PERFEVTSEL_HOST_ONLY				(1UL << 41)
+
+/* reserved bits of Intel and AMD event selectors */
+#define PERFEVTSEL_RESERVED				0xffffffff00000000UL
+#define AMD_PERFEVTSEL_RESERVED				0xfffffcf000000000UL
+
+/* AnyThread bits of all fixed counters */
+#define FIXED_CTR_CTRL_ANY				0x4444444444444444UL
+
+#define PERF_GLOBAL_PMC0				(1UL << 0)
+
 #define EFER_LME					0x00000100
 #define EFER_LMA					0x00000400
 #define EFER_NXE					0x00000800
@@ -160,6 +199,7 @@
 
 #define DB_VECTOR					1
 #define NMI_VECTOR					2
+#define GP_VECTOR					13
 #define PF_VECTOR					14
 #define AC_VECTOR					17
 
@@ -230,6 +270,15 @@ static inline void memory_load_barrier(void)
 	asm volatile("lfence" : : : "memory");
 }
 
+static inline u64 get_timestamp(void)
+{
+	u32 lo, hi;
+
+	asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+
+	return ((u64)hi << 32) | lo;
+}
+
 static inline void cpuid(unsigned int *eax, unsigned int *ebx,
 			 unsigned int *ecx, unsigned int *edx)
 {
@@ -0,0 +1,27 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_ASM_PROFILE_H
+#define _JAILHOUSE_ASM_PROFILE_H
+
+#include <jailhouse/profile.h>
+
+#ifdef CONFIG_JAILHOUSE_PROFILE
+
+void profile_cpu_init(struct per_cpu *cpu_data);
+void profile_cpu_exit(struct per_cpu *cpu_data);
+void profile_handle_nmi(unsigned long rip);
+
+#else /* !CONFIG_JAILHOUSE_PROFILE */
+
+static inline void profile_cpu_init(struct per_cpu *cpu_data) {}
+static inline void profile_cpu_exit(struct per_cpu *cpu_data) {}
+static inline void profile_handle_nmi(unsigned long rip) {}
+
+#endif /* !CONFIG_JAILHOUSE_PROFILE */
+
+#endif /* !_JAILHOUSE_ASM_PROFILE_H */
@@ -21,26 +21,28 @@
 
 typedef struct {
 	u16 owner, next;
-} spinlock_t;
+} arch_spinlock_t;
 
-#define DEFINE_SPINLOCK(name)	spinlock_t (name)
-
-static inline void spin_lock(spinlock_t *lock)
+static inline bool arch_spin_lock(arch_spinlock_t *lock)
 {
-	register spinlock_t inc = { .next = 1 };
+	register arch_spinlock_t inc = { .next = 1 };
+	bool contended;
 
 	asm volatile("lock xaddl %0, %1"
 		: "+r" (inc), "+m" (*lock)
 		: : "memory", "cc");
 
-	if (inc.owner != inc.next)
+	contended = inc.owner != inc.next;
+	if (contended)
 		while (lock->owner != inc.next)
 			cpu_relax();
 
 	asm volatile("" : : : "memory");
+
+	return contended;
 }
 
-static inline void spin_unlock(spinlock_t *lock)
+static inline void arch_spin_unlock(arch_spinlock_t *lock)
 {
 	asm volatile("addw %1, %0"
 		: "+m" (lock->owner)
@@ -69,6 +69,10 @@ void vcpu_park(void);
 
 void vcpu_nmi_handler(void);
 
+bool vcpu_vendor_profile_init(unsigned int period);
+bool vcpu_vendor_profile_overflow(unsigned int period);
+void vcpu_vendor_profile_exit(void);
+
 void vcpu_tlb_flush(void);
 
 /*
@@ -91,6 +95,9 @@ void vcpu_skip_emulated_instruction(unsigned int inst_len);
 void vcpu_vendor_get_cell_io_bitmap(struct cell *cell,
 		                    struct vcpu_io_bitmap *out);
 
+const struct paging_structures *
+vcpu_vendor_get_cell_paging(struct cell *cell);
+
 #define VCPU_CS_DPL_MASK	BIT_MASK(6, 5)
 #define VCPU_CS_L		(1 << 13)
 #define VCPU_CS_DB		(1 << 14)
@@ -110,6 +117,17 @@ pt_entry_t vcpu_pae_get_pdpte(page_table_t page_table, unsigned long virt);
 
 void vcpu_vendor_set_guest_pat(unsigned long val);
 
+/**
+ * Check if writing a PMU event selection or control MSR is valid on this CPU.
+ * @param msr		MSR to be written.
+ * @param val		Value the guest wants to write.
+ *
+ * @return True if the CPU accepts the write, false if it would raise #GP.
+ */
+bool vcpu_vendor_pmu_msr_valid(unsigned long msr, unsigned long val);
+
+void vcpu_vendor_inject_gp(void);
+
 void vcpu_handle_hypercall(void);
 
 bool vcpu_handle_io_access(void);
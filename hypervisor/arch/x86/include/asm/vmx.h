@@ -208,6 +208,10 @@ enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 #define GUEST_ACTIVITY_ACTIVE			0
 #define GUEST_ACTIVITY_HLT			1
 
+#define GUEST_INTR_STATE_STI			(1UL << 0)
+#define GUEST_INTR_STATE_MOV_SS			(1UL << 1)
+#define GUEST_INTR_STATE_NMI			(1UL << 3)
+
 #define VMX_MSR_BMP_0000_READ			0
 #define VMX_MSR_BMP_C000_READ			1
 #define VMX_MSR_BMP_0000_WRITE			2
@@ -216,6 +220,7 @@ enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 #define PIN_BASED_NMI_EXITING			(1UL << 3)
 #define PIN_BASED_VMX_PREEMPTION_TIMER		(1UL << 6)
 
+#define CPU_BASED_VIRTUAL_INTR_PENDING		(1UL << 2)
 #define CPU_BASED_CR3_LOAD_EXITING		(1UL << 15)
 #define CPU_BASED_CR3_STORE_EXITING		(1UL << 16)
 #define CPU_BASED_USE_IO_BITMAPS		(1UL << 25)
@@ -230,21 +235,26 @@ enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 #define SECONDARY_EXEC_XSAVES			(1UL << 20)
 
 #define VM_EXIT_HOST_ADDR_SPACE_SIZE		(1UL << 9)
+#define VM_EXIT_LOAD_IA32_PERF_GLOBAL_CTRL	(1UL << 12)
 #define VM_EXIT_SAVE_IA32_PAT			(1UL << 18)
 #define VM_EXIT_LOAD_IA32_PAT			(1UL << 19)
 #define VM_EXIT_SAVE_IA32_EFER			(1UL << 20)
 #define VM_EXIT_LOAD_IA32_EFER			(1UL << 21)
 
 #define VM_ENTRY_IA32E_MODE			(1UL << 9)
+#define VM_ENTRY_LOAD_IA32_PERF_GLOBAL_CTRL	(1UL << 13)
 #define VM_ENTRY_LOAD_IA32_PAT			(1UL << 14)
 #define VM_ENTRY_LOAD_IA32_EFER			(1UL << 15)
 
 #define VMX_MISC_ACTIVITY_HLT			(1UL << 6)
 
 #define INTR_INFO_INTR_TYPE_MASK		BIT_MASK(10, 8)
+#define INTR_INFO_DELIVER_CODE			(1UL << 11)
 #define INTR_INFO_UNBLOCK_NMI			(1UL << 12)
+#define INTR_INFO_VALID				(1UL << 31)
 
 #define INTR_TYPE_NMI_INTR			(2UL << 8)
+#define INTR_TYPE_HARD_EXCEPTION		(3UL << 8)
 
 #define INTR_TO_VECTORING_INFO_MASK		((1UL << 31) | BIT_MASK(11, 0))
 
@@ -301,6 +311,8 @@ enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 #define EPT_FLAG_READ				0x001
 #define EPT_FLAG_WRITE				0x002
 #define EPT_FLAG_EXECUTE			0x004
+#define EPT_FLAG_UC_TYPE			0x000
+#define EPT_FLAG_WC_TYPE			0x008
 #define EPT_FLAG_WB_TYPE			0x030
 
 #define EPT_TYPE_UNCACHEABLE			0
@@ -13,12 +13,12 @@
 #include <jailhouse/control.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/spinlock.h>
 #include <jailhouse/string.h>
 #include <jailhouse/unit.h>
 #include <asm/apic.h>
 #include <asm/ioapic.h>
 #include <asm/iommu.h>
-#include <asm/spinlock.h>
 
 #include <jailhouse/cell-config.h>
 
@@ -27,8 +27,10 @@
 #define IOAPIC_REG_INDEX	0x00
 #define IOAPIC_REG_DATA		0x10
 #define IOAPIC_REG_EOI		0x40
+#define IOAPIC_ID		0x00
 #define IOAPIC_VER		0x01
 # define IOPAPIC_VER_MRE(ver)	(((ver) & BIT_MASK(23, 16)) >> 16)
+#define IOAPIC_ARB		0x02
 #define IOAPIC_REDIR_TBL_START	0x10
 # define IOAPIC_REDIR_MASK	(1 << 16)
 
@@ -66,13 +68,24 @@ static u32 ioapic_reg_read(struct phys_ioapic *ioapic, unsigned int reg)
 	return value;
 }
 
-static void ioapic_reg_write(struct phys_ioapic *ioapic, unsigned int reg,
-			     u32 value)
+/*
+ * Write a redirection table register. The hardware is only touched if the
+ * value differs from what was last written to it.
+ */
+static void ioapic_redir_reg_write(struct phys_ioapic *ioapic,
+				   unsigned int reg, u32 value)
 {
+	unsigned int index = reg - IOAPIC_REDIR_TBL_START;
+	union ioapic_redir_entry *phys_entry =
+		&ioapic->phys_redir_table[index / 2];
+
 	spin_lock(&ioapic->lock);
 
-	mmio_write32(ioapic->reg_base + IOAPIC_REG_INDEX, reg);
-	mmio_write32(ioapic->reg_base + IOAPIC_REG_DATA, value);
+	if (phys_entry->raw[index % 2] != value) {
+		mmio_write32(ioapic->reg_base + IOAPIC_REG_INDEX, reg);
+		mmio_write32(ioapic->reg_base + IOAPIC_REG_DATA, value);
+		phys_entry->raw[index % 2] = value;
+	}
 
 	spin_unlock(&ioapic->lock);
 }
@@ -127,7 +140,8 @@ static int ioapic_virt_redir_write(struct cell_ioapic *ioapic,
 		 * register half is written.
 		 */
 		if ((reg & 1) == 0)
-			ioapic_reg_write(phys_ioapic, reg, IOAPIC_REDIR_MASK);
+			ioapic_redir_reg_write(phys_ioapic, reg,
+					       IOAPIC_REDIR_MASK);
 		return 0;
 	}
 
@@ -138,8 +152,8 @@ static int ioapic_virt_redir_write(struct cell_ioapic *ioapic,
 	// HACK for QEMU
 	if (result == -ENOSYS) {
 		/* see regular update below, lazy version */
-		ioapic_reg_write(phys_ioapic, reg | 1, entry.raw[1]);
-		ioapic_reg_write(phys_ioapic, reg, entry.raw[reg & 1]);
+		ioapic_redir_reg_write(phys_ioapic, reg | 1, entry.raw[1]);
+		ioapic_redir_reg_write(phys_ioapic, reg, entry.raw[reg & 1]);
 		return 0;
 	}
 	if (result < 0)
@@ -155,8 +169,8 @@ static int ioapic_virt_redir_write(struct cell_ioapic *ioapic,
 	 * far. Write them unconditionally when setting the lower bits.
 	 */
 	if ((reg & 1) == 0)
-		ioapic_reg_write(phys_ioapic, reg | 1, entry.raw[1]);
-	ioapic_reg_write(phys_ioapic, reg, entry.raw[reg & 1]);
+		ioapic_redir_reg_write(phys_ioapic, reg | 1, entry.raw[1]);
+	ioapic_redir_reg_write(phys_ioapic, reg, entry.raw[reg & 1]);
 
 	return 0;
 }
@@ -175,11 +189,11 @@ static void ioapic_mask_cell_pins(struct cell_ioapic *ioapic,
 
 		reg = IOAPIC_REDIR_TBL_START + pin * 2;
 
-		entry.raw[0] = ioapic_reg_read(phys_ioapic, reg);
+		entry = phys_ioapic->phys_redir_table[pin];
 		if (entry.remap.mask)
 			continue;
 
-		ioapic_reg_write(phys_ioapic, reg, IOAPIC_REDIR_MASK);
+		ioapic_redir_reg_write(phys_ioapic, reg, IOAPIC_REDIR_MASK);
 
 		if (handover == PINS_MASKED) {
 			phys_ioapic->shadow_redir_table[pin].native.mask = 1;
@@ -225,6 +239,8 @@ int ioapic_get_or_add_phys(const struct jailhouse_irqchip *irqchip,
 	if (num_phys_ioapics == IOAPIC_MAX_CHIPS)
 		return trace_error(-ERANGE);
 
+	spin_lock_set_class(&phys_ioapic->lock, JAILHOUSE_LOCK_IOAPIC);
+
 	phys_ioapic->reg_base = paging_map_device(irqchip->address, PAGE_SIZE);
 	if (!phys_ioapic->reg_base)
 		return -ENOMEM;
@@ -239,10 +255,16 @@ int ioapic_get_or_add_phys(const struct jailhouse_irqchip *irqchip,
 	phys_ioapic->base_addr = irqchip->address;
 	num_phys_ioapics++;
 
+	for (index = IOAPIC_ID; index <= IOAPIC_ARB; index++)
+		phys_ioapic->id_regs[index] =
+			ioapic_reg_read(phys_ioapic, index);
+
 	for (index = 0; index < phys_ioapic->pins * 2; index++)
-		phys_ioapic->shadow_redir_table[index / 2].raw[index % 2] =
+		phys_ioapic->phys_redir_table[index / 2].raw[index % 2] =
 			ioapic_reg_read(phys_ioapic,
 					IOAPIC_REDIR_TBL_START + index);
+	memcpy(phys_ioapic->shadow_redir_table, phys_ioapic->phys_redir_table,
+	       sizeof(phys_ioapic->shadow_redir_table));
 
 done:
 	*phys_ioapic_ptr = phys_ioapic;
@@ -285,8 +307,12 @@ static enum mmio_result ioapic_access_handler(void *arg,
 		if (index < IOAPIC_REDIR_TBL_START) {
 			if (mmio->is_write)
 				goto invalid_access;
-			mmio->value = ioapic_reg_read(ioapic->phys_ioapic,
-						      index);
+			if (index <= IOAPIC_ARB)
+				mmio->value =
+					ioapic->phys_ioapic->id_regs[index];
+			else
+				mmio->value = ioapic_reg_read(
+					ioapic->phys_ioapic, index);
 			return MMIO_HANDLED;
 		}
 
@@ -480,7 +506,7 @@ static void ioapic_shutdown(void)
 		/* write in reverse order to preserve the mask as long as
 		 * needed */
 		for (index = phys_ioapic->pins * 2 - 1; index >= 0; index--)
-			ioapic_reg_write(phys_ioapic,
+			ioapic_redir_reg_write(phys_ioapic,
 				IOAPIC_REDIR_TBL_START + index,
 				shadow_table[index / 2].raw[index % 2]);
 	}
@@ -23,7 +23,7 @@
 #include <asm/processor.h>
 
 /** Protects the root bridge's PIO interface to the PCI config space. */
-static DEFINE_SPINLOCK(pci_lock);
+static DEFINE_SPINLOCK_CLASS(pci_lock, JAILHOUSE_LOCK_PCI);
 
 u32 arch_pci_read_config(u16 bdf, u16 address, unsigned int size)
 {
@@ -0,0 +1,62 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <asm/apic.h>
+#include <asm/profile.h>
+#include <asm/vcpu.h>
+
+/**
+ * Start sampling on the calling CPU.
+ * @param cpu_data	Data structure of the calling CPU.
+ *
+ * Programs a general-purpose PMU counter to count unhalted cycles in host
+ * mode only and to raise an NMI on overflow. Must be called before
+ * vcpu_init() so that the VMCS/VMCB setup can account for the counter.
+ */
+void profile_cpu_init(struct per_cpu *cpu_data)
+{
+	cpu_data->linux_lvtpc = apic_read_lvtpc();
+
+	/* a period of 0 tells the reader that the CPU takes no samples */
+	if (!vcpu_vendor_profile_init(CONFIG_JAILHOUSE_PROFILE_PERIOD))
+		return;
+
+	cpu_data->public.profile.period = CONFIG_JAILHOUSE_PROFILE_PERIOD;
+	apic_write_lvtpc(APIC_LVT_DLVR_NMI);
+}
+
+/**
+ * Stop sampling on the calling CPU and hand the PMU back to Linux.
+ * @param cpu_data	Data structure of the calling CPU.
+ */
+void profile_cpu_exit(struct per_cpu *cpu_data)
+{
+	if (!cpu_data->public.profile.period)
+		return;
+
+	vcpu_vendor_profile_exit();
+	cpu_data->public.profile.period = 0;
+	apic_write_lvtpc(cpu_data->linux_lvtpc);
+}
+
+/**
+ * Take a sample if the PMU counter of the calling CPU overflowed.
+ * @param rip		Instruction pointer interrupted by the NMI.
+ */
+void profile_handle_nmi(unsigned long rip)
+{
+	struct public_per_cpu *cpu_public = this_cpu_public();
+
+	if (!cpu_public->profile.period ||
+	    !vcpu_vendor_profile_overflow(cpu_public->profile.period))
+		return;
+
+	profile_sample(rip);
+
+	/* the LVT entry is masked on delivery of the interrupt */
+	apic_write_lvtpc(APIC_LVT_DLVR_NMI);
+}
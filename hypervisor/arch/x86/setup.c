@@ -18,6 +18,7 @@
 #include <jailhouse/processor.h>
 #include <asm/apic.h>
 #include <asm/bitops.h>
+#include <asm/profile.h>
 #include <asm/vcpu.h>
 
 #define IDT_PRESENT_INT		0x00008e00
@@ -199,6 +200,9 @@ int arch_cpu_init(struct per_cpu *cpu_data)
 	if (err)
 		goto error_out;
 
+	/* must precede vcpu_init which configures the counter switching */
+	profile_cpu_init(cpu_data);
+
 	err = vcpu_init(cpu_data);
 	if (err)
 		goto error_out;
@@ -238,6 +242,7 @@ void arch_cpu_restore(unsigned int cpu_id, int return_code)
 	if (!cpu_data->initialized)
 		return;
 
+	profile_cpu_exit(cpu_data);
 	vcpu_exit(cpu_data);
 
 	write_msr(MSR_IA32_PAT, cpu_data->pat);
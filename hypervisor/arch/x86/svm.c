@@ -22,6 +22,7 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/processor.h>
 #include <jailhouse/string.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/utils.h>
 #include <asm/amd_iommu.h>
 #include <asm/apic.h>
@@ -45,7 +46,7 @@
 
 #define NPT_IOMMU_PAGE_DIR_LEVELS	4
 
-static bool has_avic, has_assists, has_flush_by_asid;
+static bool has_avic, has_assists, has_flush_by_asid, has_perfctr_core;
 
 static const struct segment invalid_seg;
 
@@ -88,7 +89,11 @@ static u8 __attribute__((aligned(PAGE_SIZE))) msrpm[][0x2000/4] = {
 		[  0x084/4 ... 0x1fff/4 ] = 0
 	},
 	[ SVM_MSRPM_C001 ] = {
-		[      0/4 ... 0x1fff/4 ] = 0,
+		[      0/4 ...  0x003/4 ] = 0xaa, /* 0x000 - 0x003 (w) */
+		[  0x004/4 ...  0x1ff/4 ] = 0,
+		/* 0x200, 0x202, 0x204, 0x206, 0x208, 0x20a (w) */
+		[  0x200/4 ...  0x20b/4 ] = 0x22,
+		[  0x20c/4 ... 0x1fff/4 ] = 0,
 	},
 	[ SVM_MSRPM_RESV ] = {
 		[      0/4 ... 0x1fff/4 ] = 0,
@@ -120,6 +125,10 @@ static int svm_check_features(void)
 	if (cpuid_edx(0x8000000A, 0) & X86_FEATURE_FLUSH_BY_ASID)
 		has_flush_by_asid = true;
 
+	/* Core performance counter extensions */
+	if (cpuid_ecx(0x80000001, 0) & X86_FEATURE_PERFCTR_CORE)
+		has_perfctr_core = true;
+
 	return 0;
 }
 
@@ -379,6 +388,20 @@ int vcpu_map_memory_region(struct cell *cell,
 	if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
 		phys_start = paging_hvirt2phys(&cell->comm_page);
 
+	/* selects UC- or WC via PAT_HOST_VALUE */
+	switch (mem->flags & JAILHOUSE_MEM_TYPE_MASK) {
+	case JAILHOUSE_MEM_TYPE_WB:
+		break;
+	case JAILHOUSE_MEM_TYPE_NC:
+		flags |= PAGE_FLAG_DEVICE;
+		break;
+	case JAILHOUSE_MEM_TYPE_WC:
+		flags |= PAGE_FLAG_FRAMEBUFFER;
+		break;
+	default:
+		return trace_error(-EINVAL);
+	}
+
 	flags |= amd_iommu_get_memory_region_flags(mem);
 
 	/*
@@ -404,6 +427,28 @@ void vcpu_vendor_cell_exit(struct cell *cell)
 	page_free(&mem_pool, cell->arch.svm.iopm, 3);
 }
 
+/*
+ * Stop all performance counters and wipe their state so that the next owner
+ * of the CPU neither inherits running events nor sees the previous counts.
+ */
+static void svm_pmu_reset(void)
+{
+	unsigned int n;
+
+	if (has_perfctr_core) {
+		/* also covers the legacy counters */
+		for (n = 0; n < 6; n++) {
+			write_msr(MSR_AMD_PERF_CTL_EXT0 + 2 * n, 0);
+			write_msr(MSR_AMD_PERF_CTL_EXT0 + 2 * n + 1, 0);
+		}
+	} else {
+		for (n = 0; n < 4; n++) {
+			write_msr(MSR_AMD_PERF_CTL0 + n, 0);
+			write_msr(MSR_AMD_PERF_CTR0 + n, 0);
+		}
+	}
+}
+
 int vcpu_init(struct per_cpu *cpu_data)
 {
 	unsigned long efer;
@@ -413,6 +458,10 @@ int vcpu_init(struct per_cpu *cpu_data)
 	if (err)
 		return err;
 
+	/* make sure all perf counters are off unless the root cell owns them */
+	if (!cell_owns_pmu(&root_cell))
+		svm_pmu_reset();
+
 	efer = read_msr(MSR_EFER);
 	if (efer & EFER_SVME)
 		return trace_error(-EBUSY);
@@ -632,6 +681,8 @@ void vcpu_vendor_reset(unsigned int sipi_vector)
 
 	svm_set_cell_config(cpu_data->public.cell, vmcb);
 
+	svm_pmu_reset();
+
 	vmcb_pa = paging_hvirt2phys(&per_cpu(this_cpu_id())->vmcb);
 	asm volatile("vmload %%rax" : : "a" (vmcb_pa) : "memory");
 	/* vmload overwrites GS_BASE - restore the host state */
@@ -686,6 +737,35 @@ void vcpu_vendor_set_guest_pat(unsigned long val)
 	vmcb->clean_bits &= ~CLEAN_BITS_NP;
 }
 
+bool vcpu_vendor_pmu_msr_valid(unsigned long msr, unsigned long val)
+{
+	switch (msr) {
+	case MSR_AMD_PERF_CTL0 ... MSR_AMD_PERF_CTL3:
+		break;
+	case MSR_AMD_PERF_CTL_EXT0 ... MSR_AMD_PERF_CTL_EXT5:
+		/* the counters in between are not intercepted */
+		if (!has_perfctr_core || (msr - MSR_AMD_PERF_CTL_EXT0) % 2)
+			return false;
+		break;
+	default:
+		return false;
+	}
+	return !(val & AMD_PERFEVTSEL_RESERVED);
+}
+
+void vcpu_vendor_inject_gp(void)
+{
+	struct vmcb *vmcb = &this_cpu_data()->vmcb;
+
+	vmcb->eventinj = GP_VECTOR | SVM_EVENTINJ_EXCEPTION |
+		SVM_EVENTINJ_VALID;
+	/* real mode does not push error codes */
+	if (vmcb->cr0 & X86_CR0_PE) {
+		vmcb->eventinj |= SVM_EVENTINJ_ERR_VALID;
+		vmcb->eventinj_err = 0;
+	}
+}
+
 struct parse_context {
 	unsigned int remaining;
 	unsigned int size;
@@ -895,6 +975,7 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 	write_msr(MSR_GS_BASE, (unsigned long)cpu_data);
 
 	cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL]++;
+	trace_event(JAILHOUSE_TRACE_VMEXIT, vmcb->exitcode, vmcb->rip);
 	/*
 	 * All guest state is marked unmodified; individual handlers must clear
 	 * the bits as needed.
@@ -1035,6 +1116,11 @@ void vcpu_vendor_get_cell_io_bitmap(struct cell *cell,
 	iobm->size = IOPM_PAGES * PAGE_SIZE;
 }
 
+const struct paging_structures *vcpu_vendor_get_cell_paging(struct cell *cell)
+{
+	return &cell->arch.svm.npt_iommu_structs;
+}
+
 #define VCPU_VENDOR_GET_REGISTER(__reg__)	\
 u64 vcpu_vendor_get_##__reg__(void)		\
 {						\
@@ -1064,6 +1150,27 @@ void enable_irq(void)
 	asm volatile("stgi; sti" : : : "memory");
 }
 
+#ifdef CONFIG_JAILHOUSE_PROFILE
+/*
+ * Jailhouse runs with GIF cleared, so a counter overflow in host mode would
+ * only be delivered on the next VM exit due to an NMI, attributing all samples
+ * to vcpu_handle_exit. Profiling is therefore not supported.
+ */
+bool vcpu_vendor_profile_init(unsigned int period)
+{
+	return false;
+}
+
+bool vcpu_vendor_profile_overflow(unsigned int period)
+{
+	return false;
+}
+
+void vcpu_vendor_profile_exit(void)
+{
+}
+#endif /* CONFIG_JAILHOUSE_PROFILE */
+
 /* Jailhouse runs with GIF cleared, so we need to restore this state */
 void disable_irq(void)
 {
@@ -64,14 +64,10 @@ invalid_access:
 
 static unsigned long testdev_get_mmio_base(struct cell *cell)
 {
-	const struct jailhouse_memory *mem;
-	unsigned int n;
+	if (!cell->comm_region_mem)
+		return INVALID_PHYS_ADDR;
 
-	for_each_mem_region(mem, cell->config, n)
-		if (mem->flags & JAILHOUSE_MEM_COMM_REGION)
-			return mem->virt_start + PAGE_SIZE;
-
-	return INVALID_PHYS_ADDR;
+	return cell->comm_region_mem->virt_start + PAGE_SIZE;
 }
 
 static int testdev_cell_init(struct cell *cell)
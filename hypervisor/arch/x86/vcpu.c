@@ -86,6 +86,12 @@ int vcpu_cell_init(struct cell *cell)
 	int err;
 	u8 *b;
 
+#ifdef CONFIG_JAILHOUSE_PROFILE
+	/* the hypervisor profiler claims the PMU */
+	if (cell_owns_pmu(cell))
+		return trace_error(-EBUSY);
+#endif
+
 	err = vcpu_vendor_cell_init(cell);
 	if (err)
 		return err;
@@ -328,6 +334,36 @@ bool vcpu_handle_msr_write(void)
 		vcpu_vendor_set_guest_pat((val & MTRR_ENABLE) ?
 					  cpu_data->pat : 0);
 		break;
+	case MSR_IA32_PERFEVTSEL0 ... MSR_IA32_PERFEVTSEL7:
+	case MSR_AMD_PERF_CTL0 ... MSR_AMD_PERF_CTL3:
+	case MSR_AMD_PERF_CTL_EXT0 ... MSR_AMD_PERF_CTL_EXT5:
+	case MSR_IA32_FIXED_CTR_CTRL:
+		/*
+		 * Event selection of PMU owners, without counting events of
+		 * the sibling thread or only those of the hypervisor. Ignored
+		 * for all other cells.
+		 */
+		val = get_wrmsr_value(&cpu_data->guest_regs);
+		if (!cell_owns_pmu(cpu_data->public.cell))
+			break;
+		/*
+		 * Writes the CPU would refuse have to fault in the guest, not
+		 * in the hypervisor.
+		 */
+		if (!vcpu_vendor_pmu_msr_valid(cpu_data->guest_regs.rcx,
+					       val)) {
+			vcpu_vendor_inject_gp();
+			return true;
+		}
+		if (cpu_data->guest_regs.rcx == MSR_IA32_FIXED_CTR_CTRL)
+			val &= ~FIXED_CTR_CTRL_ANY;
+		else
+			val &= ~(PERFEVTSEL_ANY | PERFEVTSEL_HOST_ONLY);
+		write_msr(cpu_data->guest_regs.rcx, val);
+		break;
+	case MSR_IA32_PEBS_ENABLE:
+		/* PEBS is not supported, ignore */
+		break;
 	default:
 		panic_printk("FATAL: Unhandled MSR write: %lx\n",
 			     cpu_data->guest_regs.rcx);
@@ -377,6 +413,17 @@ void vcpu_handle_cpuid(void)
 			guest_regs->rcx &= ~X86_FEATURE_OSXSAVE;
 			if (vcpu_vendor_get_guest_cr4() & X86_CR4_OSXSAVE)
 				guest_regs->rcx |= X86_FEATURE_OSXSAVE;
+
+			/* no debug store, thus no PEBS */
+			guest_regs->rdx &= ~X86_FEATURE_DS;
+		} else if (function == 0x0a) {
+			/* hide the architectural PMU from non-owners */
+			if (!cell_owns_pmu(this_cell())) {
+				guest_regs->rax = 0;
+				guest_regs->rbx = 0;
+				guest_regs->rcx = 0;
+				guest_regs->rdx = 0;
+			}
 		} else if (function == 0x80000001) {
 			if (this_cell() != &root_cell)
 				guest_regs->rcx &= ~X86_FEATURE_SVM;
@@ -19,6 +19,8 @@
 #include <jailhouse/string.h>
 #include <jailhouse/control.h>
 #include <jailhouse/hypercall.h>
+#include <jailhouse/profile.h>
+#include <jailhouse/trace.h>
 #include <asm/apic.h>
 #include <asm/control.h>
 #include <asm/iommu.h>
@@ -59,13 +61,18 @@ static u8 __attribute__((aligned(PAGE_SIZE))) msr_bitmap[][0x2000/8] = {
 	[ VMX_MSR_BMP_0000_WRITE ] = {
 		[      0/8 ...   0x17/8 ] = 0,
 		[   0x18/8 ...   0x1f/8 ] = 0x08, /* 0x01b */
-		[   0x20/8 ...  0x1ff/8 ] = 0,
+		[   0x20/8 ...  0x17f/8 ] = 0,
+		[  0x180/8 ...  0x187/8 ] = 0xc0, /* 0x186, 0x187 */
+		[  0x188/8 ...  0x18f/8 ] = 0x3f, /* 0x188 - 0x18d */
+		[  0x190/8 ...  0x1ff/8 ] = 0,
 		[  0x200/8 ...  0x277/8 ] = 0xff, /* 0x200 - 0x277 */
 		[  0x278/8 ...  0x2f7/8 ] = 0,
 		[  0x2f8/8 ...  0x2ff/8 ] = 0x80, /* 0x2ff */
 		[  0x300/8 ...  0x387/8 ] = 0,
-		[  0x388/8 ...  0x38f/8 ] = 0x80, /* 0x38f */
-		[  0x390/8 ...  0x7ff/8 ] = 0,
+		[  0x388/8 ...  0x38f/8 ] = 0x20, /* 0x38d */
+		[  0x390/8 ...  0x3ef/8 ] = 0,
+		[  0x3f0/8 ...  0x3f7/8 ] = 0x02, /* 0x3f1 */
+		[  0x3f8/8 ...  0x7ff/8 ] = 0,
 		[  0x808/8 ...  0x80f/8 ] = 0x89, /* 0x808, 0x80b, 0x80f */
 		[  0x810/8 ...  0x827/8 ] = 0,
 		[  0x828/8 ...  0x82f/8 ] = 0x81, /* 0x828, 0x82f */
@@ -84,6 +91,9 @@ static u8 __attribute__((aligned(PAGE_SIZE))) apic_access_page[PAGE_SIZE];
 static struct paging ept_paging[EPT_PAGE_DIR_LEVELS];
 static u32 secondary_exec_addon;
 static unsigned long cr_maybe1[2], cr_required1[2];
+static unsigned int pmu_version, pmu_gp_counters, pmu_fixed_counters;
+static bool pmu_has_tsx;
+static unsigned long pmu_overflow_mask;
 
 static bool vmxon(void)
 {
@@ -214,9 +224,13 @@ static int vmx_check_features(void)
 	    !(vmx_pin_ctrl & PIN_BASED_VMX_PREEMPTION_TIMER))
 		return trace_error(-EIO);
 
-	/* require I/O and MSR bitmap as well as secondary controls support */
+	/*
+	 * require interrupt-window exiting, I/O and MSR bitmap as well as
+	 * secondary controls support
+	 */
 	vmx_proc_ctrl = read_msr(MSR_IA32_VMX_PROCBASED_CTLS) >> 32;
-	if (!(vmx_proc_ctrl & CPU_BASED_USE_IO_BITMAPS) ||
+	if (!(vmx_proc_ctrl & CPU_BASED_VIRTUAL_INTR_PENDING) ||
+	    !(vmx_proc_ctrl & CPU_BASED_USE_IO_BITMAPS) ||
 	    !(vmx_proc_ctrl & CPU_BASED_USE_MSR_BITMAPS) ||
 	    !(vmx_proc_ctrl & CPU_BASED_ACTIVATE_SECONDARY_CONTROLS))
 		return trace_error(-EIO);
@@ -297,12 +311,26 @@ static void ept_set_next_pt(pt_entry_t pte, unsigned long next_pt)
 int vcpu_vendor_early_init(void)
 {
 	unsigned int n;
+	u32 pmu_info;
 	int err;
 
 	err = vmx_check_features();
 	if (err)
 		return err;
 
+	/* architectural PMU, see vmx_pmu_reset */
+	pmu_info = cpuid_eax(0x0a, 0);
+	pmu_version = pmu_info & 0xff;
+	if (pmu_version > 0)
+		pmu_gp_counters = MIN((pmu_info >> 8) & 0xff,
+				      MSR_IA32_PERFEVTSEL7 -
+				      MSR_IA32_PERFEVTSEL0 + 1);
+	if (pmu_version > 1)
+		pmu_fixed_counters = cpuid_edx(0x0a, 0) & 0x1f;
+	pmu_has_tsx = cpuid_ebx(0x07, 0) & (X86_FEATURE_HLE | X86_FEATURE_RTM);
+	pmu_overflow_mask = ((1UL << pmu_gp_counters) - 1) |
+		((1UL << pmu_fixed_counters) - 1) << 32;
+
 	/* derive ept_paging from very similar x86_64_paging */
 	memcpy(ept_paging, x86_64_paging, sizeof(ept_paging));
 	for (n = 0; n < EPT_PAGE_DIR_LEVELS; n++)
@@ -368,7 +396,21 @@ int vcpu_map_memory_region(struct cell *cell,
 			   const struct jailhouse_memory *mem)
 {
 	u64 phys_start = mem->phys_start;
-	u32 flags = EPT_FLAG_WB_TYPE;
+	u32 flags;
+
+	switch (mem->flags & JAILHOUSE_MEM_TYPE_MASK) {
+	case JAILHOUSE_MEM_TYPE_WB:
+		flags = EPT_FLAG_WB_TYPE;
+		break;
+	case JAILHOUSE_MEM_TYPE_NC:
+		flags = EPT_FLAG_UC_TYPE;
+		break;
+	case JAILHOUSE_MEM_TYPE_WC:
+		flags = EPT_FLAG_WC_TYPE;
+		break;
+	default:
+		return trace_error(-EINVAL);
+	}
 
 	if (mem->flags & JAILHOUSE_MEM_READ)
 		flags |= EPT_FLAG_READ;
@@ -602,6 +644,12 @@ static bool vmcs_setup(void)
 	val |= VM_EXIT_HOST_ADDR_SPACE_SIZE |
 		VM_EXIT_SAVE_IA32_PAT | VM_EXIT_LOAD_IA32_PAT |
 		VM_EXIT_SAVE_IA32_EFER | VM_EXIT_LOAD_IA32_EFER;
+	/* let the profiling counter only run in root mode */
+	if (profile_active()) {
+		val |= VM_EXIT_LOAD_IA32_PERF_GLOBAL_CTRL;
+		ok &= vmcs_write64(HOST_IA32_PERF_GLOBAL_CTRL,
+				   PERF_GLOBAL_PMC0);
+	}
 	ok &= vmcs_write32(VM_EXIT_CONTROLS, val);
 
 	ok &= vmcs_write32(VM_EXIT_MSR_STORE_COUNT, 0);
@@ -611,6 +659,10 @@ static bool vmcs_setup(void)
 	val = read_msr(MSR_IA32_VMX_ENTRY_CTLS);
 	val |= VM_ENTRY_IA32E_MODE | VM_ENTRY_LOAD_IA32_PAT |
 		VM_ENTRY_LOAD_IA32_EFER;
+	if (profile_active()) {
+		val |= VM_ENTRY_LOAD_IA32_PERF_GLOBAL_CTRL;
+		ok &= vmcs_write64(GUEST_IA32_PERF_GLOBAL_CTRL, 0);
+	}
 	ok &= vmcs_write32(VM_ENTRY_CONTROLS, val);
 
 	ok &= vmcs_write64(CR4_GUEST_HOST_MASK, 0);
@@ -620,6 +672,33 @@ static bool vmcs_setup(void)
 	return ok;
 }
 
+/*
+ * Stop all performance counters and wipe their state so that the next owner
+ * of the CPU neither inherits running events nor sees the previous counts.
+ */
+static void vmx_pmu_reset(void)
+{
+	unsigned int n;
+
+	this_cpu_data()->pmi_pending = false;
+
+	/* cells cannot use the PMU while the hypervisor profiler owns it */
+	if (profile_active())
+		return;
+
+	for (n = 0; n < pmu_gp_counters; n++) {
+		write_msr(MSR_IA32_PERFEVTSEL0 + n, 0);
+		write_msr(MSR_IA32_PMC0 + n, 0);
+	}
+	if (pmu_version > 1) {
+		write_msr(MSR_IA32_PERF_GLOBAL_CTRL, 0);
+		write_msr(MSR_IA32_FIXED_CTR_CTRL, 0);
+		for (n = 0; n < pmu_fixed_counters; n++)
+			write_msr(MSR_IA32_FIXED_CTR0 + n, 0);
+		write_msr(MSR_IA32_PERF_GLOBAL_OVF_CTRL, pmu_overflow_mask);
+	}
+}
+
 int vcpu_init(struct per_cpu *cpu_data)
 {
 	unsigned long feature_ctrl, mask;
@@ -627,8 +706,11 @@ int vcpu_init(struct per_cpu *cpu_data)
 	int err;
 
 	/* make sure all perf counters are off */
-	if ((cpuid_eax(0x0a, 0) & 0xff) > 0)
+	if (pmu_version > 0)
 		write_msr(MSR_IA32_PERF_GLOBAL_CTRL, 0);
+	/* and wipe them unless the root cell owns the PMU */
+	if (!cell_owns_pmu(&root_cell))
+		vmx_pmu_reset();
 
 	if (cpu_data->linux_cr4 & X86_CR4_VMXE)
 		return trace_error(-EBUSY);
@@ -884,6 +966,8 @@ void vcpu_vendor_reset(unsigned int sipi_vector)
 
 	ok &= vmx_set_cell_config();
 
+	vmx_pmu_reset();
+
 	if (!ok) {
 		panic_printk("FATAL: CPU reset failed\n");
 		panic_stop();
@@ -901,10 +985,33 @@ static void vmx_preemption_timer_set_enable(bool enable)
 	vmcs_write32(PIN_BASED_VM_EXEC_CONTROL, pin_based_ctrl);
 }
 
+/*
+ * Check if a counter of the PMU-owning cell overflowed and raised an NMI. The
+ * local APIC masks the LVT entry on delivery until the guest handled it.
+ */
+static bool vmx_pmi_raised(void)
+{
+	u32 lvtpc;
+
+	if (pmu_version < 2 || !cell_owns_pmu(this_cell()))
+		return false;
+
+	lvtpc = apic_read_lvtpc();
+	return (lvtpc & APIC_LVT_DLVR_MASK) == APIC_LVT_DLVR_NMI &&
+		lvtpc & APIC_LVT_MASKED &&
+		read_msr(MSR_IA32_PERF_GLOBAL_STATUS) & pmu_overflow_mask;
+}
+
 void vcpu_nmi_handler(void)
 {
-	if (this_cpu_data()->vmx_state == VMCS_READY)
-		vmx_preemption_timer_set_enable(true);
+	struct per_cpu *cpu_data = this_cpu_data();
+
+	if (cpu_data->vmx_state != VMCS_READY)
+		return;
+
+	if (vmx_pmi_raised())
+		cpu_data->pmi_pending = true;
+	vmx_preemption_timer_set_enable(true);
 }
 
 void vcpu_park(void)
@@ -926,10 +1033,39 @@ void vcpu_skip_emulated_instruction(unsigned int inst_len)
 	vmcs_write64(GUEST_RIP, vmcs_read64(GUEST_RIP) + inst_len);
 }
 
+/*
+ * Forward a counter overflow NMI to the PMU-owning cell. While the guest
+ * cannot take the NMI, wait for the next interrupt window. If the guest is
+ * still handling an earlier NMI, its handler will pick up the new overflow
+ * status as well.
+ */
+static void vmx_inject_pmi(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	u32 proc_ctrl = vmcs_read32(CPU_BASED_VM_EXEC_CONTROL);
+	u32 intr_state = vmcs_read32(GUEST_INTERRUPTIBILITY_INFO);
+
+	proc_ctrl &= ~CPU_BASED_VIRTUAL_INTR_PENDING;
+	if (!cpu_data->pmi_pending || intr_state & GUEST_INTR_STATE_NMI) {
+		cpu_data->pmi_pending = false;
+	} else if (intr_state &
+		   (GUEST_INTR_STATE_STI | GUEST_INTR_STATE_MOV_SS) ||
+		   vmcs_read32(VM_ENTRY_INTR_INFO_FIELD) & INTR_INFO_VALID) {
+		proc_ctrl |= CPU_BASED_VIRTUAL_INTR_PENDING;
+	} else {
+		vmcs_write32(VM_ENTRY_INTR_INFO_FIELD, INTR_INFO_VALID |
+			     INTR_TYPE_NMI_INTR | NMI_VECTOR);
+		cpu_data->pmi_pending = false;
+	}
+	vmcs_write32(CPU_BASED_VM_EXEC_CONTROL, proc_ctrl);
+}
+
 static void vmx_check_events(void)
 {
 	vmx_preemption_timer_set_enable(false);
 	x86_check_events();
+	if (this_cpu_data()->pmi_pending)
+		vmx_inject_pmi();
 }
 
 static void vmx_handle_exception_nmi(void)
@@ -1050,6 +1186,40 @@ void vcpu_vendor_set_guest_pat(unsigned long val)
 	vmcs_write64(GUEST_IA32_PAT, val);
 }
 
+bool vcpu_vendor_pmu_msr_valid(unsigned long msr, unsigned long val)
+{
+	unsigned long reserved = PERFEVTSEL_RESERVED;
+
+	switch (msr) {
+	case MSR_IA32_PERFEVTSEL0 ... MSR_IA32_PERFEVTSEL7:
+		if (pmu_has_tsx)
+			reserved &= ~(PERFEVTSEL_IN_TX | PERFEVTSEL_IN_TXCP);
+		return msr - MSR_IA32_PERFEVTSEL0 < pmu_gp_counters &&
+			!(val & reserved);
+	case MSR_IA32_FIXED_CTR_CTRL:
+		/* 4 control bits per fixed counter */
+		if (pmu_version < 2)
+			return false;
+		return pmu_fixed_counters >= 16 ||
+			!(val >> (4 * pmu_fixed_counters));
+	default:
+		return false;
+	}
+}
+
+void vcpu_vendor_inject_gp(void)
+{
+	u32 intr_info = INTR_INFO_VALID | INTR_TYPE_HARD_EXCEPTION |
+		GP_VECTOR;
+
+	/* real mode does not push error codes */
+	if (vmcs_read64(GUEST_CR0) & X86_CR0_PE) {
+		intr_info |= INTR_INFO_DELIVER_CODE;
+		vmcs_write32(VM_ENTRY_EXCEPTION_ERROR_CODE, 0);
+	}
+	vmcs_write32(VM_ENTRY_INTR_INFO_FIELD, intr_info);
+}
+
 static bool vmx_handle_apic_access(void)
 {
 	struct guest_paging_structures pg_structs;
@@ -1157,11 +1327,20 @@ void vcpu_vendor_get_mmio_intercept(struct vcpu_mmio_intercept *mmio)
 	mmio->is_write = !!(exitq & 0x2);
 }
 
+/* PMU MSRs used by the hypervisor profiler */
+static bool vmx_is_profile_msr(unsigned long msr)
+{
+	return msr == MSR_IA32_PMC0 || msr == MSR_IA32_A_PMC0 ||
+		msr == MSR_IA32_PERFEVTSEL0 || msr == MSR_IA32_PERF_GLOBAL_CTRL;
+}
+
 void vcpu_handle_exit(struct per_cpu *cpu_data)
 {
 	u32 reason = vmcs_read32(VM_EXIT_REASON);
 
 	cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL]++;
+	trace_event(JAILHOUSE_TRACE_VMEXIT, reason, vmcs_read64(GUEST_RIP));
+	profile_set_exit_reason(reason);
 
 	switch (reason) {
 	case EXIT_REASON_EXCEPTION_NMI:
@@ -1171,6 +1350,10 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT]++;
 		vmx_check_events();
 		return;
+	case EXIT_REASON_PENDING_INTERRUPT:
+		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT]++;
+		vmx_inject_pmi();
+		return;
 	case EXIT_REASON_CPUID:
 		vcpu_handle_cpuid();
 		return;
@@ -1189,7 +1372,8 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		break;
 	case EXIT_REASON_MSR_WRITE:
 		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR]++;
-		if (cpu_data->guest_regs.rcx == MSR_IA32_PERF_GLOBAL_CTRL) {
+		if (profile_active() &&
+		    vmx_is_profile_msr(cpu_data->guest_regs.rcx)) {
 			/* ignore writes */
 			vcpu_skip_emulated_instruction(X86_INST_LEN_WRMSR);
 			return;
@@ -1242,6 +1426,11 @@ void vcpu_vendor_get_cell_io_bitmap(struct cell *cell,
 	iobm->size = PIO_BITMAP_PAGES * PAGE_SIZE;
 }
 
+const struct paging_structures *vcpu_vendor_get_cell_paging(struct cell *cell)
+{
+	return &cell->arch.vmx.ept_structs;
+}
+
 #define VCPU_VENDOR_GET_REGISTER(__reg__, __field__)	\
 u64 vcpu_vendor_get_##__reg__(void)			\
 {							\
@@ -1266,3 +1455,59 @@ void disable_irq(void)
 {
 	asm volatile("cli" : : : "memory");
 }
+
+#ifdef CONFIG_JAILHOUSE_PROFILE
+static void vmx_intercept_msr_write(unsigned long msr)
+{
+	msr_bitmap[VMX_MSR_BMP_0000_WRITE][msr / 8] |= 1 << (msr % 8);
+}
+
+bool vcpu_vendor_profile_init(unsigned int period)
+{
+	u32 pmu_info = cpuid_eax(0x0a, 0);
+
+	/* architectural PMU with at least one general-purpose counter */
+	if ((pmu_info & 0xff) == 0 || ((pmu_info >> 8) & 0xff) == 0)
+		return false;
+	/* the unhalted core cycles event must not be marked unavailable */
+	if (cpuid_ebx(0x0a, 0) & 0x1)
+		return false;
+	if (!((read_msr(MSR_IA32_VMX_ENTRY_CTLS) >> 32) &
+	      VM_ENTRY_LOAD_IA32_PERF_GLOBAL_CTRL) ||
+	    !((read_msr(MSR_IA32_VMX_EXIT_CTLS) >> 32) &
+	      VM_EXIT_LOAD_IA32_PERF_GLOBAL_CTRL))
+		return false;
+
+	/* keep guests from reprogramming the counter and its interrupt */
+	vmx_intercept_msr_write(MSR_IA32_PERF_GLOBAL_CTRL);
+	vmx_intercept_msr_write(MSR_IA32_PMC0);
+	vmx_intercept_msr_write(MSR_IA32_A_PMC0);
+	vmx_intercept_msr_write(MSR_IA32_PERFEVTSEL0);
+	vmx_intercept_msr_write(MSR_X2APIC_LVTPC);
+
+	/* unhalted core cycles: event 0x3c, umask 0 */
+	write_msr(MSR_IA32_PERFEVTSEL0, 0);
+	write_msr(MSR_IA32_PMC0, -(u64)period);
+	write_msr(MSR_IA32_PERF_GLOBAL_OVF_CTRL, PERF_GLOBAL_PMC0);
+	write_msr(MSR_IA32_PERFEVTSEL0, 0x3c | PERFEVTSEL_USR | PERFEVTSEL_OS |
+		  PERFEVTSEL_INT | PERFEVTSEL_EN);
+
+	return true;
+}
+
+bool vcpu_vendor_profile_overflow(unsigned int period)
+{
+	if (!(read_msr(MSR_IA32_PERF_GLOBAL_STATUS) & PERF_GLOBAL_PMC0))
+		return false;
+
+	write_msr(MSR_IA32_PMC0, -(u64)period);
+	write_msr(MSR_IA32_PERF_GLOBAL_OVF_CTRL, PERF_GLOBAL_PMC0);
+	return true;
+}
+
+void vcpu_vendor_profile_exit(void)
+{
+	write_msr(MSR_IA32_PERFEVTSEL0, 0);
+	write_msr(MSR_IA32_PERF_GLOBAL_OVF_CTRL, PERF_GLOBAL_PMC0);
+}
+#endif /* CONFIG_JAILHOUSE_PROFILE */
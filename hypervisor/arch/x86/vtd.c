@@ -18,13 +18,13 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/pci.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/spinlock.h>
 #include <jailhouse/string.h>
 #include <jailhouse/unit.h>
 #include <asm/apic.h>
 #include <asm/iommu.h>
 #include <asm/bitops.h>
 #include <asm/ioapic.h>
-#include <asm/spinlock.h>
 
 #define VTD_INTERRUPT_LIMIT()	\
 	system_config->platform_info.x86.vtd_interrupt_limit
@@ -201,7 +201,8 @@ static void *unit_inv_queue;
 static unsigned int dmar_units;
 static unsigned int dmar_pt_levels;
 static unsigned int dmar_num_did = ~0U;
-static DEFINE_SPINLOCK(inv_queue_lock);
+static DEFINE_SPINLOCK_CLASS(inv_queue_lock,
+			     JAILHOUSE_LOCK_VTD_INV_QUEUE);
 static struct vtd_emulation root_cell_units[JAILHOUSE_MAX_IOMMU_UNITS];
 static bool dmar_units_initialized;
 
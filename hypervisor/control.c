@@ -16,14 +16,16 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/processor.h>
+#include <jailhouse/spinlock.h>
 #include <jailhouse/string.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/unit.h>
 #include <jailhouse/utils.h>
 #include <asm/bitops.h>
 #include <asm/control.h>
-#include <asm/spinlock.h>
 
 enum msg_type {MSG_REQUEST, MSG_INFORMATION};
+enum msg_reply {MSG_REPLY_PENDING, MSG_REPLY_ACCEPTED, MSG_REPLY_REFUSED};
 enum failure_mode {ABORT_ON_ERROR, WARN_ON_ERROR};
 enum management_task {CELL_START, CELL_SET_LOADABLE, CELL_DESTROY};
 
@@ -32,9 +34,25 @@ struct jailhouse_system *system_config;
 /** State structure of the root cell. @ingroup Control */
 struct cell root_cell;
 
-static DEFINE_SPINLOCK(shutdown_lock);
+static DEFINE_MCS_SPINLOCK_CLASS(shutdown_lock, JAILHOUSE_LOCK_SHUTDOWN);
 static unsigned int num_cells = 1;
 
+/**
+ * Duration of cell suspensions and resumptions in timestamp counter ticks,
+ * reported via JAILHOUSE_HC_HYPERVISOR_GET_INFO. Only updated by the CPU
+ * that performs a management operation.
+ */
+static struct {
+	unsigned long suspend_count;
+	u64 suspend_signal_last;
+	u64 suspend_wait_last;
+	u64 suspend_max;
+	u64 resume_last;
+} suspend_timing;
+
+/** Incremented on each reply delivered via JAILHOUSE_HC_MSG_REPLY. */
+static volatile unsigned long msg_reply_events;
+
 volatile unsigned long panic_in_progress;
 unsigned long panic_cpu = -1;
 
@@ -82,13 +100,16 @@ bool cpu_id_valid(unsigned long cpu_id)
  * arbitrary hypervisor code. It may actively busy-wait in the hypervisor
  * context, so the suspension time should be kept short.
  *
- * The function waits for the target CPU to enter suspended state.
+ * The function only signals the request to the target CPU. Use
+ * suspend_cpu_wait() to wait for the target CPU to enter suspended state.
+ * This allows to suspend multiple CPUs in parallel.
  *
  * This service can be used to synchronize with other CPUs before performing
  * management tasks.
  *
  * @note This function must not be invoked for the caller's CPU.
  *
+ * @see suspend_cpu_wait
  * @see resume_cpu
  * @see arch_reset_cpu
  * @see arch_park_cpu
@@ -98,6 +119,8 @@ static void suspend_cpu(unsigned int cpu_id)
 	struct public_per_cpu *target_data = public_per_cpu(cpu_id);
 	bool target_suspended;
 
+	trace_event(JAILHOUSE_TRACE_SUSPEND, cpu_id, 0);
+
 	spin_lock(&target_data->control_lock);
 
 	target_data->suspend_cpu = true;
@@ -105,24 +128,38 @@ static void suspend_cpu(unsigned int cpu_id)
 
 	spin_unlock(&target_data->control_lock);
 
-	if (!target_suspended) {
-		/*
-		 * Send a maintenance signal to the target CPU.
-		 * Then, wait for the target CPU to enter the suspended state.
-		 * The target CPU, in turn, will leave the guest and handle the
-		 * request in the event loop.
-		 */
+	/*
+	 * Send a maintenance signal to the target CPU. It will leave the guest
+	 * and handle the request in the event loop.
+	 */
+	if (!target_suspended)
 		arch_send_event(target_data);
+}
 
-		while (!target_data->cpu_suspended)
-			cpu_relax();
-	}
+/**
+ * Wait for a remote CPU to enter suspended state.
+ * @param cpu_id	ID of the target CPU.
+ *
+ * @note suspend_cpu() must have been called for the target CPU before.
+ *
+ * @see suspend_cpu
+ */
+static void suspend_cpu_wait(unsigned int cpu_id)
+{
+	struct public_per_cpu *target_data = public_per_cpu(cpu_id);
+
+	while (!target_data->cpu_suspended)
+		cpu_relax();
+
+	trace_event(JAILHOUSE_TRACE_SUSPENDED, cpu_id, 0);
 }
 
 void resume_cpu(unsigned int cpu_id)
 {
 	struct public_per_cpu *target_data = public_per_cpu(cpu_id);
 
+	trace_event(JAILHOUSE_TRACE_RESUME, cpu_id, 0);
+
 	/* take lock to avoid theoretical race with a pending suspension */
 	spin_lock(&target_data->control_lock);
 
@@ -134,75 +171,194 @@ void resume_cpu(unsigned int cpu_id)
 /*
  * Suspend all CPUs assigned to the cell except the one executing
  * the function (if it is in the cell's CPU set) to prevent races.
+ *
+ * All CPUs are signaled before waiting for the first of them so that their
+ * handshakes overlap.
  */
 static void cell_suspend(struct cell *cell)
 {
-	unsigned int cpu;
+	unsigned int cpu, this_cpu = this_cpu_id();
+	u64 start, signaled, suspended;
 
-	for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id())
+	start = get_timestamp();
+
+	for_each_cpu_except(cpu, cell->cpu_set, this_cpu)
 		suspend_cpu(cpu);
+
+	signaled = get_timestamp();
+
+	for_each_cpu_except(cpu, cell->cpu_set, this_cpu)
+		suspend_cpu_wait(cpu);
+
+	suspended = get_timestamp();
+
+	suspend_timing.suspend_count++;
+	suspend_timing.suspend_signal_last = signaled - start;
+	suspend_timing.suspend_wait_last = suspended - signaled;
+	if (suspended - start > suspend_timing.suspend_max)
+		suspend_timing.suspend_max = suspended - start;
 }
 
 static void cell_resume(struct cell *cell)
 {
-	unsigned int cpu;
+	unsigned int cpu, this_cpu = this_cpu_id();
+	u64 start = get_timestamp();
 
-	for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id())
+	for_each_cpu_except(cpu, cell->cpu_set, this_cpu)
 		resume_cpu(cpu);
+
+	suspend_timing.resume_last = get_timestamp() - start;
 }
 
-/**
- * Deliver a message to cell and wait for the reply.
- * @param cell		Target cell.
- * @param message	Message code to be sent (JAILHOUSE_MSG_*).
- * @param type		Message type, defines the valid replies.
- *
- * @return True if a request message was approved or reception of an
- * 	   informational message was acknowledged by the target cell. It also
- * 	   returns true if the target cell does not support an active
- * 	   communication region, is shut down or in failed state.
- *	   In case of timeout (if enabled) it also stops the cell and put it
- *	   in failed state.
- *	   Returns false on request denial or invalid replies.
- */
-static bool cell_exchange_message(struct cell *cell, u32 message,
-				  enum msg_type type)
+static void cell_send_message(struct cell *cell, u32 message)
+{
+	jailhouse_send_msg_to_cell(&cell->comm_page.comm_region, message);
+	trace_event(JAILHOUSE_TRACE_MSG_SEND, cell->config->id, message);
+}
+
+static enum msg_reply cell_check_reply(struct cell *cell, enum msg_type type)
 {
-	u64 timeout = cell->config->msg_reply_timeout;
+	u32 reply = cell->comm_page.comm_region.reply_from_cell;
+	u32 cell_state = cell->comm_page.comm_region.cell_state;
 
-	if (cell->config->flags & JAILHOUSE_CELL_PASSIVE_COMMREG)
-		return true;
+	if (reply != JAILHOUSE_MSG_NONE)
+		trace_event(JAILHOUSE_TRACE_MSG_REPLY, cell->config->id, reply);
 
-	jailhouse_send_msg_to_cell(&cell->comm_page.comm_region, message);
+	if (cell_state == JAILHOUSE_CELL_SHUT_DOWN ||
+	    cell_state == JAILHOUSE_CELL_FAILED)
+		return MSG_REPLY_ACCEPTED;
+
+	if ((type == MSG_REQUEST &&
+	     reply == JAILHOUSE_MSG_REQUEST_APPROVED) ||
+	    (type == MSG_INFORMATION &&
+	     reply == JAILHOUSE_MSG_RECEIVED))
+		return MSG_REPLY_ACCEPTED;
+
+	if (reply != JAILHOUSE_MSG_NONE)
+		return MSG_REPLY_REFUSED;
+
+	return MSG_REPLY_PENDING;
+}
+
+/*
+ * Timeouts are kept as product of microseconds and timestamp frequency in kHz
+ * in order to avoid divisions.
+ */
+static bool msg_timeout_expired(u64 start, u64 timeout)
+{
+	return timeout > 0 && (get_timestamp() - start) * 1000 >= timeout;
+}
+
+static void cell_message_timeout(struct cell *cell)
+{
+	printk("Timeout expired while waiting for reply from target cell\n");
+	cell_suspend(cell);
+	cell->comm_page.comm_region.cell_state = JAILHOUSE_CELL_FAILED;
+}
 
-	while (1) {
-		u32 reply = cell->comm_page.comm_region.reply_from_cell;
-		u32 cell_state = cell->comm_page.comm_region.cell_state;
+/*
+ * Shutting down or failing ends the exchange with a cell as well. Neither
+ * rings the reply doorbell: cells write their state directly, and panic_park
+ * marks them failed.
+ */
+static bool msg_pending_cell_stopped(void)
+{
+	struct cell *cell;
+	u32 cell_state;
 
+	for_each_non_root_cell(cell) {
+		if (!cell->msg_pending)
+			continue;
+		cell_state = cell->comm_page.comm_region.cell_state;
 		if (cell_state == JAILHOUSE_CELL_SHUT_DOWN ||
 		    cell_state == JAILHOUSE_CELL_FAILED)
 			return true;
+	}
+	return false;
+}
 
-		if ((type == MSG_REQUEST &&
-		     reply == JAILHOUSE_MSG_REQUEST_APPROVED) ||
-		    (type == MSG_INFORMATION &&
-		     reply == JAILHOUSE_MSG_RECEIVED))
-			return true;
+/**
+ * Deliver a message to cells and wait for their replies.
+ * @param target	Target cell or NULL to address all non-root cells.
+ * @param message	Message code to be sent (JAILHOUSE_MSG_*).
+ * @param type		Message type, defines the valid replies.
+ *
+ * The message is posted to all target cells before collecting the replies,
+ * so that the cells can process it in parallel. The reply timeouts of all
+ * cells start with the posting.
+ *
+ * @return True if a request message was approved or reception of an
+ * 	   informational message was acknowledged by all target cells. Cells
+ * 	   that do not support an active communication region, are shut down
+ * 	   or in failed state are considered to agree.
+ *	   In case of timeout (if enabled) it also stops the affected cell and
+ *	   put it in failed state.
+ *	   Returns false if any cell denied a request or replied invalidly.
+ */
+static bool cells_exchange_message(struct cell *target, u32 message,
+				   enum msg_type type)
+{
+	unsigned long khz = timestamp_khz();
+	unsigned int pending = 0;
+	u64 start, timeout, next_timeout;
+	bool accepted = true;
+	unsigned long events;
+	enum msg_reply reply;
+	struct cell *cell;
+	bool polling;
 
-		if (reply != JAILHOUSE_MSG_NONE)
-			return false;
+	start = get_timestamp();
 
-		if (cell->config->msg_reply_timeout > 0 && --timeout == 0) {
-			printk("Timeout expired while waiting for reply from "
-			       "target cell\n");
-			cell_suspend(cell);
-			cell->comm_page.comm_region.cell_state =
-				JAILHOUSE_CELL_FAILED;
-			return true;
+	for_each_non_root_cell(cell) {
+		cell->msg_pending = (!target || cell == target) &&
+			!(cell->config->flags & JAILHOUSE_CELL_PASSIVE_COMMREG);
+		if (cell->msg_pending) {
+			cell_send_message(cell, message);
+			pending++;
 		}
+	}
+
+	while (pending > 0) {
+		events = msg_reply_events;
+		next_timeout = 0;
+		polling = false;
+
+		for_each_non_root_cell(cell) {
+			if (!cell->msg_pending)
+				continue;
+
+			timeout = cell->config->msg_reply_timeout * khz;
+			reply = cell_check_reply(cell, type);
+			if (reply == MSG_REPLY_PENDING) {
+				if (!msg_timeout_expired(start, timeout)) {
+					polling |= !cell->msg_reply_doorbell;
+					if (timeout > 0 && (next_timeout == 0 ||
+							    timeout < next_timeout))
+						next_timeout = timeout;
+					continue;
+				}
+				cell_message_timeout(cell);
+			} else if (reply == MSG_REPLY_REFUSED) {
+				accepted = false;
+			}
+			cell->msg_pending = false;
+			pending--;
+		}
+
+		/*
+		 * Cells that reply via doorbell do not need to be polled. If
+		 * only those are left, wait for the next doorbell instead of
+		 * competing with the cells for their communication regions.
+		 */
+		while (pending > 0 && !polling && msg_reply_events == events &&
+		       !msg_pending_cell_stopped() &&
+		       !msg_timeout_expired(start, next_timeout))
+			cpu_relax();
 
 		cpu_relax();
 	}
+
+	return accepted;
 }
 
 static bool cell_reconfig_ok(struct cell *excluded_cell)
@@ -219,13 +375,245 @@ static bool cell_reconfig_ok(struct cell *excluded_cell)
 
 static void cell_reconfig_completed(void)
 {
-	struct cell *cell;
+	cells_exchange_message(NULL, JAILHOUSE_MSG_RECONFIG_COMPLETED,
+			       MSG_INFORMATION);
+}
 
-	for_each_non_root_cell(cell)
-		cell_exchange_message(cell, JAILHOUSE_MSG_RECONFIG_COMPLETED,
-				      MSG_INFORMATION);
+/*
+ * Checks that apply to a memory region independent of the others. The
+ * hypervisor trusts the configuration after this, no further validation of
+ * these properties is performed when mapping, loading or destroying the cell.
+ */
+static bool mem_region_valid(const struct jailhouse_memory *mem)
+{
+	/*
+	 * Regions shared between cells have to be read-only so that none of
+	 * the cells can modify what the others execute.
+	 */
+	if (mem->flags & JAILHOUSE_MEM_SHARED_RO &&
+	    (!(mem->flags & JAILHOUSE_MEM_READ) ||
+	     mem->flags & (JAILHOUSE_MEM_WRITE | JAILHOUSE_MEM_IO |
+			   JAILHOUSE_MEM_COMM_REGION |
+			   JAILHOUSE_MEM_ROOTSHARED | JAILHOUSE_MEM_COLORED)))
+		return false;
+
+	return true;
+}
+
+static void mem_index_sift_down(struct sorted_mem_region *regions,
+				unsigned int pos, unsigned int num)
+{
+	struct sorted_mem_region tmp;
+	unsigned int child;
+
+	while ((child = 2 * pos + 1) < num) {
+		if (child + 1 < num && regions[child + 1].mem->virt_start >
+		    regions[child].mem->virt_start)
+			child++;
+		if (regions[pos].mem->virt_start >=
+		    regions[child].mem->virt_start)
+			break;
+		tmp = regions[pos];
+		regions[pos] = regions[child];
+		regions[child] = tmp;
+		pos = child;
+	}
+}
+
+/* heapsort, keeps the worst case at O(n log n) without extra memory */
+static void mem_index_sort(struct sorted_mem_region *regions,
+			   unsigned int num)
+{
+	struct sorted_mem_region tmp;
+	unsigned int n;
+
+	for (n = num / 2; n > 0; n--)
+		mem_index_sift_down(regions, n - 1, num);
+	for (n = num; n > 1; n--) {
+		tmp = regions[0];
+		regions[0] = regions[n - 1];
+		regions[n - 1] = tmp;
+		mem_index_sift_down(regions, 0, n - 1);
+	}
+}
+
+/*
+ * Validate the memory regions of a cell configuration and build the sorted
+ * region index. Regions of size 0 are ignored.
+ */
+static int cell_index_init(struct cell *cell)
+{
+	unsigned int num_regions = cell->config->num_memory_regions;
+	const struct jailhouse_memory *mem;
+	struct sorted_mem_region *sorted;
+	u64 max_end = 0;
+	unsigned int n;
+
+	if (num_regions == 0)
+		return 0;
+
+	sorted = page_alloc(&mem_pool, PAGES(num_regions * sizeof(*sorted)));
+	if (!sorted)
+		return -ENOMEM;
+	cell->sorted_mem_regions = sorted;
+
+	for_each_mem_region(mem, cell->config, n) {
+		if (!mem_region_valid(mem))
+			return trace_error(-EINVAL);
+		if (mem->size == 0)
+			continue;
+
+		if (JAILHOUSE_MEMORY_IS_SUBPAGE(mem))
+			cell->num_subpage_regions++;
+		if (mem->flags & JAILHOUSE_MEM_COMM_REGION) {
+			if (cell->comm_region_mem)
+				return trace_error(-EINVAL);
+			cell->comm_region_mem = mem;
+		}
+
+		sorted[cell->num_sorted_mem_regions++].mem = mem;
+	}
+
+	mem_index_sort(sorted, cell->num_sorted_mem_regions);
+
+	/*
+	 * The size of colored regions is an upper bound of their guest size,
+	 * which is good enough for narrowing down lookups.
+	 */
+	for (n = 0; n < cell->num_sorted_mem_regions; n++) {
+		mem = sorted[n].mem;
+		if (mem->virt_start + mem->size > max_end)
+			max_end = mem->virt_start + mem->size;
+		sorted[n].max_end = max_end;
+	}
+
+	/*
+	 * Non-root cells must not contain overlapping regions. Root cell
+	 * configurations are derived from the host's memory map which may
+	 * describe the same range more than once. The guest size of colored
+	 * regions depends on the LLC geometry, their placement is validated
+	 * by the architecture when mapping them.
+	 */
+	if (cell == &root_cell)
+		return 0;
+
+	max_end = 0;
+	for (n = 0; n < cell->num_sorted_mem_regions; n++) {
+		mem = sorted[n].mem;
+		if (mem->flags & JAILHOUSE_MEM_COLORED)
+			continue;
+		/* compare against all earlier regions, not just the last */
+		if (mem->virt_start < max_end)
+			return trace_error(-EINVAL);
+		max_end = mem->virt_start + mem->size;
+	}
+
+	return 0;
 }
 
+static void cell_index_exit(struct cell *cell)
+{
+	unsigned int num_regions = cell->config->num_memory_regions;
+
+	if (cell->sorted_mem_regions)
+		page_free(&mem_pool, cell->sorted_mem_regions,
+			  PAGES(num_regions *
+				sizeof(*cell->sorted_mem_regions)));
+}
+
+/*
+ * Return the range [*first, *last) of sorted index entries whose memory
+ * regions may overlap with the given guest address range. The entries in
+ * this range still have to be checked individually.
+ */
+static void cell_index_lookup(const struct cell *cell, u64 start, u64 size,
+			      unsigned int *first, unsigned int *last)
+{
+	const struct sorted_mem_region *sorted = cell->sorted_mem_regions;
+	unsigned int low, high, mid;
+
+	/* first entry that ends after start, max_end is monotonic */
+	low = 0;
+	high = cell->num_sorted_mem_regions;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (sorted[mid].max_end > start)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	*first = low;
+
+	/* first entry that starts at or after the end of the range */
+	high = cell->num_sorted_mem_regions;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (sorted[mid].mem->virt_start < start + size)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	*last = low;
+}
+
+#ifdef CONFIG_TRACE_PAGE_SIZES
+static void count_range_pages(const struct paging_structures *pg_structs,
+			      u64 start, u64 end,
+			      unsigned long counts[MAX_PAGE_TABLE_LEVELS])
+{
+	if (end > start)
+		paging_count_pages(pg_structs, start, end - start, counts);
+}
+
+/*
+ * Print how many pages of each size back the memory regions of a cell. This
+ * reveals hugepages that were broken up while other cells were created.
+ */
+static void cell_dump_page_sizes(struct cell *cell)
+{
+	const struct paging_structures *pg_structs = arch_get_cell_paging(cell);
+	unsigned long counts[MAX_PAGE_TABLE_LEVELS] = { 0 };
+	const struct jailhouse_memory *mem;
+	const struct paging *paging;
+	u64 run_start = 0, run_end = 0;
+	unsigned int n;
+
+	/*
+	 * Walk the union of all regions so that overlapping or adjacent
+	 * regions do not count the same mapping twice.
+	 */
+	for (n = 0; n < cell->num_sorted_mem_regions; n++) {
+		mem = cell->sorted_mem_regions[n].mem;
+		if (mem->virt_start > run_end) {
+			count_range_pages(pg_structs, run_start, run_end,
+					  counts);
+			run_start = mem->virt_start;
+		}
+		if (mem->virt_start + mem->size > run_end)
+			run_end = mem->virt_start + mem->size;
+	}
+	count_range_pages(pg_structs, run_start, run_end, counts);
+
+	printk("Page sizes of cell \"%s\":", cell->config->name);
+	for (n = 0, paging = pg_structs->root_paging; n < MAX_PAGE_TABLE_LEVELS;
+	     n++, paging++) {
+		if (paging->page_size >= 1024 * 1024)
+			printk(" %uM: %lu", paging->page_size / (1024 * 1024),
+			       counts[n]);
+		else if (paging->page_size > 0)
+			printk(" %uK: %lu", paging->page_size / 1024,
+			       counts[n]);
+		if (paging->page_size == PAGE_SIZE)
+			break;
+	}
+	printk("\n");
+}
+#else /* !CONFIG_TRACE_PAGE_SIZES */
+static inline void cell_dump_page_sizes(struct cell *cell)
+{
+}
+#endif /* !CONFIG_TRACE_PAGE_SIZES */
+
 /**
  * Initialize a new cell.
  * @param cell	Cell to be initialized.
@@ -256,8 +644,19 @@ int cell_init(struct cell *cell)
 
 	cell->cpu_set = cpu_set;
 
+	err = cell_index_init(cell);
+	if (err)
+		goto err_index_exit;
+
 	err = mmio_cell_init(cell);
-	if (err && cell->cpu_set != &cell->small_cpu_set)
+	if (err)
+		goto err_index_exit;
+
+	return 0;
+
+err_index_exit:
+	cell_index_exit(cell);
+	if (cell->cpu_set != &cell->small_cpu_set)
 		page_free(&mem_pool, cell->cpu_set, 1);
 
 	return err;
@@ -266,6 +665,7 @@ int cell_init(struct cell *cell)
 static void cell_exit(struct cell *cell)
 {
 	mmio_cell_exit(cell);
+	cell_index_exit(cell);
 
 	if (cell->cpu_set != &cell->small_cpu_set)
 		page_free(&mem_pool, cell->cpu_set, 1);
@@ -296,6 +696,35 @@ static bool address_in_region(unsigned long addr,
 	       addr < (region->phys_start + region->size);
 }
 
+/*
+ * Check if another non-root cell maps a read-only shared region that overlaps
+ * with the given one. If loading is set, only cells that are currently
+ * loadable via that region are considered.
+ */
+static bool shared_region_in_use(const struct cell *cell,
+				 const struct jailhouse_memory *mem,
+				 bool loading)
+{
+	const struct jailhouse_memory *other_mem;
+	u64 end = mem->phys_start + mem->size;
+	struct cell *other;
+	unsigned int n;
+
+	for_each_non_root_cell(other) {
+		if (other == cell || (loading && !other->loadable))
+			continue;
+		for_each_mem_region(other_mem, other->config, n)
+			if (other_mem->flags & JAILHOUSE_MEM_SHARED_RO &&
+			    (!loading ||
+			     other_mem->flags & JAILHOUSE_MEM_LOADABLE) &&
+			    other_mem->phys_start < end &&
+			    mem->phys_start <
+			    other_mem->phys_start + other_mem->size)
+				return true;
+	}
+	return false;
+}
+
 static int unmap_from_root_cell(const struct jailhouse_memory *mem)
 {
 	/*
@@ -315,41 +744,77 @@ static int unmap_from_root_cell(const struct jailhouse_memory *mem)
 	return arch_unmap_memory_region(&root_cell, &tmp);
 }
 
+/*
+ * Map the part of mem that overlaps with root_mem back into the root cell.
+ * Returns 0 if there is no overlap.
+ */
+static int remap_root_overlap(const struct jailhouse_memory *mem,
+			      const struct jailhouse_memory *root_mem)
+{
+	struct jailhouse_memory overlap;
+
+	if (address_in_region(mem->phys_start, root_mem)) {
+		overlap.phys_start = mem->phys_start;
+		overlap.size = root_mem->size -
+			(overlap.phys_start - root_mem->phys_start);
+		if (overlap.size > mem->size)
+			overlap.size = mem->size;
+	} else if (address_in_region(root_mem->phys_start, mem)) {
+		overlap.phys_start = root_mem->phys_start;
+		overlap.size = mem->size -
+			(overlap.phys_start - mem->phys_start);
+		if (overlap.size > root_mem->size)
+			overlap.size = root_mem->size;
+	} else {
+		return 0;
+	}
+
+	overlap.virt_start = root_mem->virt_start +
+		overlap.phys_start - root_mem->phys_start;
+	/* only hand back the pages of a colored region's colors */
+	overlap.flags = (root_mem->flags & ~JAILHOUSE_MEM_COLOR_FLAGS) |
+		(mem->flags & JAILHOUSE_MEM_COLOR_FLAGS);
+
+	if (JAILHOUSE_MEMORY_IS_SUBPAGE(&overlap))
+		return mmio_subpage_register(&root_cell, &overlap);
+	return arch_map_memory_region(&root_cell, &overlap);
+}
+
 static int remap_to_root_cell(const struct jailhouse_memory *mem,
 			      enum failure_mode mode)
 {
 	const struct jailhouse_memory *root_mem;
-	struct jailhouse_memory overlap;
-	unsigned int n;
+	unsigned int n, last;
 	int err = 0;
 
-	for_each_mem_region(root_mem, root_cell.config, n) {
-		if (address_in_region(mem->phys_start, root_mem)) {
-			overlap.phys_start = mem->phys_start;
-			overlap.size = root_mem->size -
-				(overlap.phys_start - root_mem->phys_start);
-			if (overlap.size > mem->size)
-				overlap.size = mem->size;
-		} else if (address_in_region(root_mem->phys_start, mem)) {
-			overlap.phys_start = root_mem->phys_start;
-			overlap.size = mem->size -
-				(overlap.phys_start - mem->phys_start);
-			if (overlap.size > root_mem->size)
-				overlap.size = root_mem->size;
-		} else
+	/*
+	 * The root cell's index is sorted by guest address. For regions that
+	 * are mapped 1:1, this is also the order of their physical addresses,
+	 * so they can be looked up via the index.
+	 */
+	cell_index_lookup(&root_cell, mem->phys_start, mem->size, &n, &last);
+	for (; n < last; n++) {
+		root_mem = root_cell.sorted_mem_regions[n].mem;
+		if (root_mem->virt_start != root_mem->phys_start)
 			continue;
+		err = remap_root_overlap(mem, root_mem);
+		if (err) {
+			if (mode == ABORT_ON_ERROR)
+				return err;
+			printk("WARNING: Failed to re-assign memory region "
+			       "to root cell\n");
+		}
+	}
 
-		overlap.virt_start = root_mem->virt_start +
-			overlap.phys_start - root_mem->phys_start;
-		overlap.flags = root_mem->flags;
-
-		if (JAILHOUSE_MEMORY_IS_SUBPAGE(&overlap))
-			err = mmio_subpage_register(&root_cell, &overlap);
-		else
-			err = arch_map_memory_region(&root_cell, &overlap);
+	/* the remaining ones have to be walked */
+	for_each_mem_region(root_mem, root_cell.config, n) {
+		if (root_mem->virt_start == root_mem->phys_start ||
+		    root_mem->size == 0)
+			continue;
+		err = remap_root_overlap(mem, root_mem);
 		if (err) {
 			if (mode == ABORT_ON_ERROR)
-				break;
+				return err;
 			printk("WARNING: Failed to re-assign memory region "
 			       "to root cell\n");
 		}
@@ -382,9 +847,15 @@ static void cell_destroy_internal(struct cell *cell)
 			 */
 			arch_unmap_memory_region(cell, mem);
 
-		if (!(mem->flags & (JAILHOUSE_MEM_COMM_REGION |
-				    JAILHOUSE_MEM_ROOTSHARED)))
+		if (mem->flags & JAILHOUSE_MEM_SHARED_RO &&
+		    shared_region_in_use(cell, mem, false)) {
+			/* still in use, revoke access granted for loading */
+			if (cell->loadable && mem->flags & JAILHOUSE_MEM_LOADABLE)
+				unmap_from_root_cell(mem);
+		} else if (!(mem->flags & (JAILHOUSE_MEM_COMM_REGION |
+					   JAILHOUSE_MEM_ROOTSHARED))) {
 			remap_to_root_cell(mem, WARN_ON_ERROR);
+		}
 	}
 
 	for_each_unit_reverse(unit)
@@ -517,9 +988,15 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 		 * Unmap exceptions:
 		 *  - the communication region is not backed by root memory
 		 *  - regions that may be shared with the root cell
+		 *  - shared read-only regions the root cell is still loading
+		 *    for another cell, that cell's start revokes the access
+		 * Shared read-only regions may already be unmapped, which is
+		 * harmless.
 		 */
 		if (!(mem->flags & (JAILHOUSE_MEM_COMM_REGION |
-				    JAILHOUSE_MEM_ROOTSHARED))) {
+				    JAILHOUSE_MEM_ROOTSHARED)) &&
+		    !(mem->flags & JAILHOUSE_MEM_SHARED_RO &&
+		      shared_region_in_use(cell, mem, true))) {
 			err = unmap_from_root_cell(mem);
 			if (err)
 				goto err_destroy_cell;
@@ -548,6 +1025,8 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 	printk("Created cell \"%s\"\n", cell->config->name);
 
 	paging_dump_stats("after cell creation");
+	cell_dump_page_sizes(&root_cell);
+	cell_dump_page_sizes(cell);
 
 	cell_resume(&root_cell);
 
@@ -571,8 +1050,8 @@ err_resume:
 
 static bool cell_shutdown_ok(struct cell *cell)
 {
-	return cell_exchange_message(cell, JAILHOUSE_MSG_SHUTDOWN_REQUEST,
-				     MSG_REQUEST);
+	return cells_exchange_message(cell, JAILHOUSE_MSG_SHUTDOWN_REQUEST,
+				      MSG_REQUEST);
 }
 
 static int cell_management_prologue(enum management_task task,
@@ -645,6 +1124,7 @@ static int cell_start(struct per_cpu *cpu_data, unsigned long id)
 	 */
 	comm_region = &cell->comm_page.comm_region;
 	memset(&cell->comm_page, 0, sizeof(cell->comm_page));
+	cell->msg_reply_doorbell = false;
 
 	comm_region->revision = COMM_REGION_ABI_REVISION;
 	memcpy(comm_region->signature, COMM_REGION_MAGIC,
@@ -737,6 +1217,7 @@ static int cell_destroy(struct per_cpu *cpu_data, unsigned long id)
 
 	page_free(&mem_pool, cell, cell->data_pages);
 	paging_dump_stats("after cell destruction");
+	cell_dump_page_sizes(&root_cell);
 
 	cell_reconfig_completed();
 
@@ -825,7 +1306,7 @@ static int hypervisor_disable(struct per_cpu *cpu_data)
 	 * shutdown_lock is here to protect shutdown_state, waiting_cpus and
 	 * do_common_shutdown.
 	 */
-	spin_lock(&shutdown_lock);
+	mcs_spin_lock(&shutdown_lock);
 
 	if (cpu_data->public.shutdown_state == SHUTDOWN_NONE) {
 		state = num_cells == 1 ? SHUTDOWN_STARTED : -EBUSY;
@@ -842,7 +1323,7 @@ static int hypervisor_disable(struct per_cpu *cpu_data)
 		cpu_data->public.shutdown_state = SHUTDOWN_NONE;
 	}
 
-	spin_unlock(&shutdown_lock);
+	mcs_spin_unlock(&shutdown_lock);
 
 	if (ret < 0)
 		return ret;
@@ -856,7 +1337,7 @@ static int hypervisor_disable(struct per_cpu *cpu_data)
 	while (waiting_cpus < hypervisor_header.online_cpus)
 		cpu_relax();
 
-	spin_lock(&shutdown_lock);
+	mcs_spin_lock(&shutdown_lock);
 
 	if (do_common_shutdown) {
 		/*
@@ -868,27 +1349,63 @@ static int hypervisor_disable(struct per_cpu *cpu_data)
 	}
 	printk(" Releasing CPU %d\n", this_cpu);
 
-	spin_unlock(&shutdown_lock);
+	mcs_spin_unlock(&shutdown_lock);
 
 	return 0;
 }
 
 static long hypervisor_get_info(struct per_cpu *cpu_data, unsigned long type)
 {
+	bool high_part = type & JAILHOUSE_INFO_HIGH_PART;
+	u64 value;
+	int err;
+
+	if (high_part)
+		type -= JAILHOUSE_INFO_HIGH_PART;
+
 	switch (type) {
 	case JAILHOUSE_INFO_MEM_POOL_SIZE:
-		return mem_pool.pages;
+		value = mem_pool.pages;
+		break;
 	case JAILHOUSE_INFO_MEM_POOL_USED:
-		return mem_pool.used_pages;
+		value = mem_pool.used_pages;
+		break;
 	case JAILHOUSE_INFO_REMAP_POOL_SIZE:
-		return remap_pool.pages;
+		value = remap_pool.pages;
+		break;
 	case JAILHOUSE_INFO_REMAP_POOL_USED:
-		return remap_pool.used_pages;
+		value = remap_pool.used_pages;
+		break;
 	case JAILHOUSE_INFO_NUM_CELLS:
-		return num_cells;
+		value = num_cells;
+		break;
+	case JAILHOUSE_INFO_TIMESTAMP_KHZ:
+		value = timestamp_khz();
+		break;
+	case JAILHOUSE_INFO_SUSPEND_COUNT:
+		value = suspend_timing.suspend_count;
+		break;
+	case JAILHOUSE_INFO_SUSPEND_SIGNAL_LAST:
+		value = suspend_timing.suspend_signal_last;
+		break;
+	case JAILHOUSE_INFO_SUSPEND_WAIT_LAST:
+		value = suspend_timing.suspend_wait_last;
+		break;
+	case JAILHOUSE_INFO_SUSPEND_MAX:
+		value = suspend_timing.suspend_max;
+		break;
+	case JAILHOUSE_INFO_RESUME_LAST:
+		value = suspend_timing.resume_last;
+		break;
 	default:
-		return -EINVAL;
+		err = lock_stat_get_info(type, &value);
+		if (err)
+			return err;
 	}
+
+	if (high_part)
+		value >>= JAILHOUSE_INFO_PART_BITS;
+	return value & ((1UL << JAILHOUSE_INFO_PART_BITS) - 1);
 }
 
 static int cpu_get_info(struct per_cpu *cpu_data, unsigned long cpu_id,
@@ -917,22 +1434,33 @@ static int cpu_get_info(struct per_cpu *cpu_data, unsigned long cpu_id,
 		return -EINVAL;
 }
 
-/**
- * Handle hypercall invoked by a cell.
- * @param code		Hypercall code.
- * @param arg1		First hypercall argument.
- * @param arg2		Seconds hypercall argument.
- *
- * @return Value that shall be passed to the caller of the hypercall on return.
- *
- * @note If @c arg1 and @c arg2 are valid depends on the hypercall code.
- */
-long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2)
+static int msg_reply(struct per_cpu *cpu_data, unsigned long reply)
 {
-	struct per_cpu *cpu_data = this_cpu_data();
+	struct cell *cell = cpu_data->public.cell;
+	struct jailhouse_comm_region *comm_region = &cell->comm_page.comm_region;
 
-	cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL]++;
+	if (cell == &root_cell)
+		return -EPERM;
+
+	if (reply == JAILHOUSE_MSG_NONE || reply > JAILHOUSE_MSG_RECEIVED)
+		return trace_error(-EINVAL);
+
+	comm_region->msg_to_cell = JAILHOUSE_MSG_NONE;
+	/* ensure message was cleared before sending reply */
+	memory_barrier();
+	comm_region->reply_from_cell = reply;
 
+	cell->msg_reply_doorbell = true;
+	/* publish the reply before ringing */
+	memory_barrier();
+	msg_reply_events++;
+
+	return 0;
+}
+
+static long handle_hypercall(struct per_cpu *cpu_data, unsigned long code,
+			     unsigned long arg1, unsigned long arg2)
+{
 	switch (code) {
 	case JAILHOUSE_HC_DISABLE:
 		return hypervisor_disable(cpu_data);
@@ -956,11 +1484,41 @@ long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2)
 			return trace_error(-EPERM);
 		printk("%c", (char)arg1);
 		return 0;
+	case JAILHOUSE_HC_MSG_REPLY:
+		return msg_reply(cpu_data, arg1);
+	case JAILHOUSE_HC_LOCK_BENCH:
+		if (cpu_data->public.cell != &root_cell)
+			return -EPERM;
+		return lock_bench(arg1, arg2);
 	default:
 		return -ENOSYS;
 	}
 }
 
+/**
+ * Handle hypercall invoked by a cell.
+ * @param code		Hypercall code.
+ * @param arg1		First hypercall argument.
+ * @param arg2		Seconds hypercall argument.
+ *
+ * @return Value that shall be passed to the caller of the hypercall on return.
+ *
+ * @note If @c arg1 and @c arg2 are valid depends on the hypercall code.
+ */
+long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	long result;
+
+	cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL]++;
+
+	trace_event(JAILHOUSE_TRACE_HYPERCALL, code, arg1);
+	result = handle_hypercall(cpu_data, code, arg1, arg2);
+	trace_event(JAILHOUSE_TRACE_HYPERCALL_DONE, code, result);
+
+	return result;
+}
+
 /**
  * Stops the current CPU on panic and prevents any execution on it until the
  * system is rebooted.
@@ -17,10 +17,18 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/pci.h>
 #include <asm/cell.h>
-#include <asm/spinlock.h>
 
 #include <jailhouse/cell-config.h>
 #include <jailhouse/hypercall.h>
+#include <jailhouse/spinlock.h>
+
+/** Entry of the sorted memory region index of a cell. */
+struct sorted_mem_region {
+	/** Memory region of the cell configuration. */
+	const struct jailhouse_memory *mem;
+	/** Highest end address of this and all preceding entries. */
+	u64 max_end;
+};
 
 /** Cell-related states. */
 struct cell {
@@ -46,14 +54,32 @@ struct cell {
 	/** Stores the cell's CPU set if small enough. */
 	struct cpu_set small_cpu_set;
 
+	/** Memory regions of the configuration, sorted by virt_start.
+	 * Built and validated once during cell_init. */
+	struct sorted_mem_region *sorted_mem_regions;
+	/** Number of entries in sorted_mem_regions. */
+	unsigned int num_sorted_mem_regions;
+	/** Number of sub-page memory regions. */
+	unsigned int num_subpage_regions;
+	/** Communication region of the configuration, NULL if none. */
+	const struct jailhouse_memory *comm_region_mem;
+
 	/** True while the cell can be loaded by the root cell. */
 	bool loadable;
+	/** True if the cell replies to messages via JAILHOUSE_HC_MSG_REPLY. */
+	volatile bool msg_reply_doorbell;
+	/** True while a reply to a message is awaited from the cell. */
+	bool msg_pending;
 
 	/** Pointer to next cell in the system. */
 	struct cell *next;
 
 	/** List of PCI devices assigned to this cell. */
 	struct pci_device *pci_devices;
+	/** Open-addressing hash table of pci_devices, indexed by BDF. */
+	struct pci_device **pci_device_hash;
+	/** The hash table has (1 << pci_device_hash_bits) slots. */
+	unsigned int pci_device_hash_bits;
 
 	/** Lock protecting changes to mmio_locations, mmio_handlers, and
 	 * num_mmio_regions. */
@@ -104,6 +104,20 @@ unsigned int next_cpu(unsigned int cpu, struct cpu_set *cpu_set,
 	     (counter) < (config)->num_memory_regions;			\
 	     (mem)++, (counter)++)
 
+/**
+ * Iterate over the non-empty memory regions of a cell in the order of their
+ * guest-physical start addresses, using the cell's sorted region index.
+ * @param mem		Iteration variable holding the reference to the current
+ * 			memory region (const struct jailhouse_memory *).
+ * @param cell		Cell containing the regions.
+ * @param counter	Helper variable (unsigned int).
+ */
+#define for_each_indexed_mem_region(mem, cell, counter)			\
+	for ((counter) = 0;						\
+	     (counter) < (cell)->num_sorted_mem_regions &&		\
+	     ((mem) = (cell)->sorted_mem_regions[(counter)].mem, true);	\
+	     (counter)++)
+
 /**
  * Check if the CPU is assigned to the specified cell.
  * @param cell		Cell the CPU may belong to.
@@ -117,6 +131,17 @@ static inline bool cell_owns_cpu(struct cell *cell, unsigned int cpu_id)
 		test_bit(cpu_id, cell->cpu_set->bitmap));
 }
 
+/**
+ * Check if the cell owns the performance monitoring unit of its CPUs.
+ * @param cell		Cell to check.
+ *
+ * @return True if the cell may program the PMU.
+ */
+static inline bool cell_owns_pmu(struct cell *cell)
+{
+	return !!(cell->config->flags & JAILHOUSE_CELL_PMU);
+}
+
 bool cpu_id_valid(unsigned long cpu_id);
 
 int cell_init(struct cell *cell);
@@ -199,6 +224,15 @@ int arch_map_memory_region(struct cell *cell,
 int arch_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem);
 
+/**
+ * Get the paging structures that translate the guest-physical addresses of a
+ * cell.
+ * @param cell		Cell to query.
+ *
+ * @return Reference to the paging structures.
+ */
+const struct paging_structures *arch_get_cell_paging(struct cell *cell);
+
 /**
  * Performs the architecture-specific steps for invalidating memory caches
  * after memory regions have been unmapped from a cell.
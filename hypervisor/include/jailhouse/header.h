@@ -10,6 +10,9 @@
  * the COPYING file in the top-level directory.
  */
 
+#ifndef _JAILHOUSE_HEADER_H
+#define _JAILHOUSE_HEADER_H
+
 #include <asm/jailhouse_header.h>
 
 #define JAILHOUSE_SIGNATURE	"AOSIMAGE"
@@ -46,6 +49,69 @@ struct jailhouse_virt_console {
 	char content[2048];
 };
 
+/* current implementation requires the number of records to be a power of
+ * two */
+#define JAILHOUSE_TRACE_RECORDS		2048
+
+#define JAILHOUSE_TRACE_VMEXIT		1
+#define JAILHOUSE_TRACE_IRQ_PENDING	2
+#define JAILHOUSE_TRACE_MMIO_READ	3
+#define JAILHOUSE_TRACE_MMIO_WRITE	4
+#define JAILHOUSE_TRACE_HYPERCALL	5
+#define JAILHOUSE_TRACE_HYPERCALL_DONE	6
+#define JAILHOUSE_TRACE_MSG_SEND	7
+#define JAILHOUSE_TRACE_MSG_REPLY	8
+#define JAILHOUSE_TRACE_SUSPEND		9
+#define JAILHOUSE_TRACE_SUSPENDED	10
+#define JAILHOUSE_TRACE_RESUME		11
+
+/** Binary trace event, see Documentation/tracing.md for the arguments. */
+struct jailhouse_trace_record {
+	/** Value of the CPU's timestamp counter. */
+	unsigned long long timestamp;
+	/** Event type (JAILHOUSE_TRACE_*). */
+	unsigned int event;
+	/** ID of the cell owning the CPU when the event was recorded. */
+	unsigned int cell_id;
+	unsigned long long arg0;
+	unsigned long long arg1;
+};
+
+/** Per-CPU trace ring buffer. Only written by the owning CPU. */
+struct jailhouse_trace_buffer {
+	/** Number of records written so far. Record n is stored at
+	 * records[n % JAILHOUSE_TRACE_RECORDS]. */
+	unsigned int head;
+	/** Frequency of the timestamp counter in kHz. */
+	unsigned int timestamp_khz;
+	struct jailhouse_trace_record records[JAILHOUSE_TRACE_RECORDS];
+};
+
+/* current implementation requires the number of samples to be a power of
+ * two */
+#define JAILHOUSE_PROFILE_SAMPLES	4096
+
+/** Profiling sample, taken on overflow of a hypervisor-only PMU counter. */
+struct jailhouse_profile_sample {
+	/** Hypervisor instruction pointer at the time of the overflow. */
+	unsigned long long pc;
+	/** Reason of the VM exit handled at that time (arch-specific). */
+	unsigned int exit_reason;
+	/** ID of the cell owning the CPU. */
+	unsigned int cell_id;
+};
+
+/** Per-CPU profiling ring buffer. Only written by the owning CPU. */
+struct jailhouse_profile_buffer {
+	/** Number of samples taken so far. Sample n is stored at
+	 * samples[n % JAILHOUSE_PROFILE_SAMPLES]. */
+	unsigned int head;
+	/** Number of counted events between two samples, 0 if the CPU does
+	 * not support profiling. */
+	unsigned int period;
+	struct jailhouse_profile_sample samples[JAILHOUSE_PROFILE_SAMPLES];
+};
+
 /**
  * Hypervisor description.
  * Located at the beginning of the hypervisor binary image and loaded by
@@ -73,6 +139,14 @@ struct jailhouse_header {
 	/** Pointer to the first struct gcov_info
 	 * @note Filled at build time */
 	void *gcov_info_head;
+	/** Offset of the trace buffer inside the per-CPU data structure, 0 if
+	 * tracing is disabled.
+	 * @note Filled at build time. */
+	unsigned long trace_offset;
+	/** Offset of the profiling buffer inside the per-CPU data structure,
+	 * 0 if profiling is disabled.
+	 * @note Filled at build time. */
+	unsigned long profile_offset;
 
 	/** Configured maximum logical CPU ID + 1.
 	 * @note Filled by Linux loader driver before entry. */
@@ -94,3 +168,5 @@ struct jailhouse_header {
 };
 
 #endif /* !__ASSEMBLY__ */
+
+#endif /* !_JAILHOUSE_HEADER_H */
@@ -15,8 +15,8 @@
 #define _JAILHOUSE_IVSHMEM_H
 
 #include <jailhouse/pci.h>
+#include <jailhouse/spinlock.h>
 #include <asm/ivshmem.h>
-#include <asm/spinlock.h>
 
 #define IVSHMEM_CFG_MSIX_CAP	0x50
 #define IVSHMEM_CFG_SIZE	(IVSHMEM_CFG_MSIX_CAP + 12)
@@ -37,6 +37,11 @@ struct ivshmem_endpoint {
 	struct pci_device *device;
 	const struct jailhouse_memory *shmem;
 	struct ivshmem_endpoint *remote;
+	/**
+	 * Publisher of a broadcast link only: bitmap of the positions of the
+	 * connected subscribers. Protected by remote_lock, like remote.
+	 */
+	u32 subscribers;
 	spinlock_t remote_lock;
 	struct arch_pci_ivshmem arch;
 	u32 intx_ctrl_reg;
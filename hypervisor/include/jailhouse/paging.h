@@ -240,6 +240,9 @@ unsigned long paging_virt2phys(const struct paging_structures *pg_structs,
  */
 unsigned long arch_paging_gphys2phys(unsigned long gphys, unsigned long flags);
 
+bool paging_has_page_size(const struct paging_structures *pg_structs,
+			  unsigned long size);
+
 int paging_create(const struct paging_structures *pg_structs,
 		  unsigned long phys, unsigned long size, unsigned long virt,
 		  unsigned long flags, enum paging_coherent coherent);
@@ -267,6 +270,10 @@ int paging_init(void);
  */
 void arch_paging_init(void);
 
+void paging_count_pages(const struct paging_structures *pg_structs,
+			unsigned long virt, unsigned long size,
+			unsigned long counts[MAX_PAGE_TABLE_LEVELS]);
+
 void paging_dump_stats(const char *when);
 
 /* --- To be provided by asm/paging.h --- */
@@ -340,6 +347,14 @@ void paging_dump_stats(const char *when);
  * @see arch_paging_flush_cpu_caches
  */
 
+/**
+ * @fn void arch_paging_flush_cell_tlbs(void)
+ * Flush the TLB entries of all cells on all CPUs, including cached walks of
+ * their paging structures.
+ *
+ * @see arch_paging_flush_page_tlbs
+ */
+
 /**
  * @fn void arch_paging_flush_cpu_caches(void *addr, long size)
  * Flush caches related to the specified region.
@@ -129,6 +129,12 @@ struct pci_device {
 	struct cell *cell;
 	/** Shadow BAR */
 	u32 bar[PCI_NUM_BARS];
+	/** Shadow of the read-only identification registers of the header. */
+	u32 cfg_shadow[PCI_CONFIG_HEADER_SIZE / 4];
+	/** Config space range covered by the device's capabilities. */
+	u16 cap_range_start, cap_range_end;
+	/** Capability that matched the last lookup. */
+	const struct jailhouse_pci_capability *last_cap;
 
 	/** Shadow state of MSI config space registers. */
 	union pci_msi_registers msi_registers;
@@ -20,6 +20,7 @@
  */
 
 #include <jailhouse/cell.h>
+#include <jailhouse/header.h>
 #include <asm/percpu.h>
 
 /**
@@ -59,6 +60,27 @@ struct public_per_cpu {
 	 *  host physical <-> guest physical memory mappings. */
 	bool flush_vcpu_caches;
 
+	/** Queue nodes for the MCS locks taken by the CPU, accessed by the
+	 *  neighbors in the lock queues. */
+	struct mcs_node mcs_nodes[MCS_MAX_NESTING];
+	/** Number of MCS locks currently taken by the CPU. */
+	unsigned int mcs_nesting;
+
+#ifdef CONFIG_JAILHOUSE_TRACE
+	/** Binary trace ring buffer, read by the driver. */
+	struct jailhouse_trace_buffer trace;
+#endif
+
+#ifdef CONFIG_JAILHOUSE_PROFILE
+	/** Profiling sample ring buffer, read by the driver. */
+	struct jailhouse_profile_buffer profile;
+#endif
+
+#ifdef CONFIG_JAILHOUSE_LOCK_STAT
+	/** Statistics of the locks taken by the CPU, per lock class. */
+	struct lock_stat lock_stat[JAILHOUSE_NUM_LOCK_CLASSES];
+#endif
+
 	ARCH_PUBLIC_PERCPU_FIELDS;
 } __attribute__((aligned(PAGE_SIZE)));
 
@@ -78,6 +100,12 @@ struct per_cpu {
 	/** Per-CPU paging structures. */
 	struct paging_structures pg_structs;
 
+#ifdef CONFIG_JAILHOUSE_PROFILE
+	/** Reason of the VM exit currently handled, recorded in profiling
+	 *  samples. */
+	unsigned int profile_exit_reason;
+#endif
+
 	ARCH_PERCPU_FIELDS;
 
 	/* Must be last field! */
@@ -13,3 +13,10 @@
 #include <asm/processor.h>
 
 unsigned long phys_processor_id(void);
+
+/**
+ * Return the frequency of the counter read by get_timestamp().
+ *
+ * @return Counter frequency in kHz.
+ */
+unsigned long timestamp_khz(void);
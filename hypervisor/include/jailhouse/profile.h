@@ -0,0 +1,83 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_PROFILE_H
+#define _JAILHOUSE_PROFILE_H
+
+#include <jailhouse/percpu.h>
+#include <jailhouse/processor.h>
+
+/** Number of events counted between two profiling samples. */
+#ifndef CONFIG_JAILHOUSE_PROFILE_PERIOD
+#define CONFIG_JAILHOUSE_PROFILE_PERIOD	100000
+#endif
+
+#ifdef CONFIG_JAILHOUSE_PROFILE
+
+/** Offset of the profiling buffer in struct per_cpu, reported to the driver. */
+#define PROFILE_OFFSET	__builtin_offsetof(struct per_cpu, public.profile)
+
+/**
+ * Check if the calling CPU takes profiling samples.
+ *
+ * @return True if sampling is active.
+ */
+static inline bool profile_active(void)
+{
+	return this_cpu_public()->profile.period != 0;
+}
+
+/**
+ * Remember the reason of the VM exit that is about to be handled.
+ * @param reason	Arch-specific exit reason.
+ */
+static inline void profile_set_exit_reason(unsigned int reason)
+{
+	this_cpu_data()->profile_exit_reason = reason;
+}
+
+/**
+ * Record a profiling sample in the buffer of the calling CPU.
+ * @param pc		Interrupted hypervisor instruction pointer.
+ *
+ * The oldest sample is overwritten when the buffer is full. Readers detect
+ * this by sampling the head before and after copying the samples.
+ *
+ * @note This function is called from NMI context.
+ */
+static inline void profile_sample(unsigned long pc)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct jailhouse_profile_buffer *profile = &cpu_data->public.profile;
+	struct jailhouse_profile_sample *sample =
+		&profile->samples[profile->head &
+				  (JAILHOUSE_PROFILE_SAMPLES - 1)];
+
+	sample->pc = pc;
+	sample->exit_reason = cpu_data->profile_exit_reason;
+	sample->cell_id = cpu_data->public.cell->config->id;
+
+	/* publish the sample before advancing the head */
+	memory_barrier();
+	profile->head++;
+}
+
+#else /* !CONFIG_JAILHOUSE_PROFILE */
+
+#define PROFILE_OFFSET	0
+
+static inline bool profile_active(void)
+{
+	return false;
+}
+
+static inline void profile_set_exit_reason(unsigned int reason) {}
+static inline void profile_sample(unsigned long pc) {}
+
+#endif /* !CONFIG_JAILHOUSE_PROFILE */
+
+#endif /* !_JAILHOUSE_PROFILE_H */
@@ -0,0 +1,158 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_SPINLOCK_H
+#define _JAILHOUSE_SPINLOCK_H
+
+#include <jailhouse/entry.h>
+#include <jailhouse/hypercall.h>
+#include <asm/processor.h>
+#include <asm/spinlock.h>
+
+/**
+ * Ticket spinlock. The arch part implements the lock itself, its
+ * arch_spin_lock() reports if the lock was held by another CPU.
+ */
+typedef struct {
+	arch_spinlock_t arch;
+#ifdef CONFIG_JAILHOUSE_LOCK_STAT
+	/** Lock class (JAILHOUSE_LOCK_*) the statistics are accounted to. */
+	unsigned int class;
+#endif
+} spinlock_t;
+
+/**
+ * MCS queue spinlock. Waiting CPUs enqueue themselves and spin on their own
+ * queue node, which keeps the lock handoff local to the next waiter.
+ */
+typedef struct {
+	/** Queue node of the last waiter or holder, 0 if the lock is free. */
+	u32 tail;
+#ifdef CONFIG_JAILHOUSE_LOCK_STAT
+	/** Lock class (JAILHOUSE_LOCK_*) the statistics are accounted to. */
+	unsigned int class;
+#endif
+} mcs_spinlock_t;
+
+/** Maximum nesting depth of MCS locks on a CPU. */
+#define MCS_MAX_NESTING		4
+
+/** Queue node of a CPU waiting for or holding an MCS lock. */
+struct mcs_node {
+	/** Queue node of the next waiter, 0 if there is none. */
+	u32 next;
+	/** Set by the previous holder when passing the lock on. */
+	bool locked;
+};
+
+/** Statistics of all locks of a class, taken by a single CPU. */
+struct lock_stat {
+	/** Number of acquisitions. */
+	u32 acquired;
+	/** Number of acquisitions that had to wait for another CPU. */
+	u32 contended;
+	/** Longest wait for the lock, in timestamp ticks. */
+	u64 wait_max;
+	/** Accumulated wait for the lock, in timestamp ticks. */
+	u64 wait_total;
+};
+
+#define DEFINE_SPINLOCK(name)		spinlock_t (name)
+#define DEFINE_MCS_SPINLOCK(name)	mcs_spinlock_t (name)
+
+#ifdef CONFIG_JAILHOUSE_LOCK_STAT
+
+#define DEFINE_SPINLOCK_CLASS(name, lock_class) \
+	spinlock_t (name) = { .class = (lock_class) }
+#define DEFINE_MCS_SPINLOCK_CLASS(name, lock_class) \
+	mcs_spinlock_t (name) = { .class = (lock_class) }
+
+/**
+ * Account the statistics of a lock to the given class.
+ * @param lock		Lock to be classified.
+ * @param class		Lock class (JAILHOUSE_LOCK_*).
+ *
+ * Locks that are not classified are accounted to JAILHOUSE_LOCK_OTHER.
+ */
+static inline void spin_lock_set_class(spinlock_t *lock, unsigned int class)
+{
+	lock->class = class;
+}
+
+extern bool lock_stat_enabled;
+
+/**
+ * Start recording lock statistics. Called when all CPUs are able to access
+ * their per-CPU data.
+ */
+static inline void lock_stat_enable(void)
+{
+	lock_stat_enabled = true;
+}
+
+void lock_stat_record(unsigned int class, bool contended, u64 wait);
+int lock_stat_get_info(unsigned long type, u64 *value);
+
+static inline void spin_lock(spinlock_t *lock)
+{
+	u64 start = get_timestamp();
+	bool contended = arch_spin_lock(&lock->arch);
+
+	if (lock_stat_enabled)
+		lock_stat_record(lock->class, contended,
+				 contended ? get_timestamp() - start : 0);
+}
+
+#else /* !CONFIG_JAILHOUSE_LOCK_STAT */
+
+#define DEFINE_SPINLOCK_CLASS(name, lock_class)	DEFINE_SPINLOCK(name)
+#define DEFINE_MCS_SPINLOCK_CLASS(name, lock_class) \
+	DEFINE_MCS_SPINLOCK(name)
+
+static inline void spin_lock_set_class(spinlock_t *lock, unsigned int class)
+{
+}
+
+static inline void lock_stat_enable(void)
+{
+}
+
+static inline int lock_stat_get_info(unsigned long type, u64 *value)
+{
+	return -EINVAL;
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+	arch_spin_lock(&lock->arch);
+}
+
+#endif /* !CONFIG_JAILHOUSE_LOCK_STAT */
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+	arch_spin_unlock(&lock->arch);
+}
+
+/*
+ * MCS locks use per-CPU queue nodes. They must not be taken before the
+ * per-CPU data of the calling CPU is set up, and nested MCS locks have to be
+ * released in reverse order.
+ */
+void mcs_spin_lock(mcs_spinlock_t *lock);
+void mcs_spin_unlock(mcs_spinlock_t *lock);
+
+#ifdef CONFIG_JAILHOUSE_LOCK_BENCH
+long lock_bench(unsigned long type, unsigned long iterations);
+#else
+static inline long lock_bench(unsigned long type, unsigned long iterations)
+{
+	return -ENOSYS;
+}
+#endif
+
+#endif /* !_JAILHOUSE_SPINLOCK_H */
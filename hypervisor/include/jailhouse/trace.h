@@ -0,0 +1,65 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_TRACE_H
+#define _JAILHOUSE_TRACE_H
+
+#include <jailhouse/percpu.h>
+#include <jailhouse/processor.h>
+
+#ifdef CONFIG_JAILHOUSE_TRACE
+
+/** Offset of the trace buffer in struct per_cpu, reported to the driver. */
+#define TRACE_OFFSET	__builtin_offsetof(struct per_cpu, public.trace)
+
+static inline void trace_cpu_init(struct public_per_cpu *cpu_public)
+{
+	cpu_public->trace.timestamp_khz = timestamp_khz();
+}
+
+/**
+ * Record an event in the trace buffer of the calling CPU.
+ * @param event		Event type (JAILHOUSE_TRACE_*).
+ * @param arg0		First event-specific argument.
+ * @param arg1		Second event-specific argument.
+ *
+ * The oldest record is overwritten when the buffer is full. Readers detect
+ * this by sampling the head before and after copying the records.
+ *
+ * @note This function must not be called before the CPU has been assigned to
+ * the root cell.
+ */
+static inline void trace_event(unsigned int event, u64 arg0, u64 arg1)
+{
+	struct public_per_cpu *cpu_public = this_cpu_public();
+	struct jailhouse_trace_buffer *trace = &cpu_public->trace;
+	struct jailhouse_trace_record *record =
+		&trace->records[trace->head & (JAILHOUSE_TRACE_RECORDS - 1)];
+
+	record->timestamp = get_timestamp();
+	record->event = event;
+	record->cell_id = cpu_public->cell->config->id;
+	record->arg0 = arg0;
+	record->arg1 = arg1;
+
+	/* publish the record before advancing the head */
+	memory_barrier();
+	trace->head++;
+}
+
+#else /* !CONFIG_JAILHOUSE_TRACE */
+
+#define TRACE_OFFSET	0
+
+static inline void trace_cpu_init(struct public_per_cpu *cpu_public) {}
+
+/* Trace points do not evaluate their arguments when tracing is disabled. */
+#define trace_event(event, arg0, arg1)	do { } while (0)
+
+#endif /* !CONFIG_JAILHOUSE_TRACE */
+
+#endif /* !_JAILHOUSE_TRACE_H */
@@ -18,10 +18,20 @@
  * The implementation in Jailhouse provides a shared memory device between
  * exactly 2 cells. The link between the two PCI devices is established by
  * choosing the same BDF, memory location, and memory size.
+ *
+ * A broadcast link (jailhouse_pci_device.shmem_peers != 0) connects one
+ * publisher, the only peer with a writable region, with multiple subscribers
+ * that map the region read-only. The publisher has position 0, subscribers
+ * take the next free position. A doorbell or LSTATE write of the publisher
+ * interrupts all connected subscribers, one of a subscriber interrupts the
+ * publisher. Reading RSTATE at the publisher returns a bitmap of the
+ * subscriber positions with a non-zero LSTATE.
  */
 
+#include <jailhouse/control.h>
 #include <jailhouse/ivshmem.h>
 #include <jailhouse/mmio.h>
+#include <jailhouse/paging.h>
 #include <jailhouse/pci.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
@@ -53,8 +63,9 @@
  */
 #define IVSHMEM_BAR4_SIZE	(0x10 * IVSHMEM_MSIX_VECTORS * 2)
 
+/* fits into a single page, even with JAILHOUSE_SHMEM_MAX_PEERS endpoints */
 struct ivshmem_data {
-	struct ivshmem_endpoint eps[2];
+	struct ivshmem_endpoint eps[JAILHOUSE_SHMEM_MAX_PEERS];
 	u16 bdf;
 	struct ivshmem_data *next;
 };
@@ -74,8 +85,31 @@ static const u32 default_cspace[IVSHMEM_CFG_SIZE / sizeof(u32)] = {
 	[(IVSHMEM_CFG_MSIX_CAP + 0x8)/4] = 0x10 * IVSHMEM_MSIX_VECTORS | 4,
 };
 
+/*
+ * Peers have to use the same protocol, except for virtio where a front-end is
+ * paired with the back-end of the same device type.
+ */
+static bool ivshmem_protocols_match(u16 protocol, u16 peer_protocol)
+{
+	u16 device = protocol & 0xff;
+
+	switch (protocol & ~0xff) {
+	case JAILHOUSE_SHMEM_PROTO_VIRTIO_FRONT:
+		return peer_protocol ==
+			(JAILHOUSE_SHMEM_PROTO_VIRTIO_BACK | device);
+	case JAILHOUSE_SHMEM_PROTO_VIRTIO_BACK:
+		return peer_protocol ==
+			(JAILHOUSE_SHMEM_PROTO_VIRTIO_FRONT | device);
+	default:
+		return peer_protocol == protocol;
+	}
+}
+
 static void ivshmem_remote_interrupt(struct ivshmem_endpoint *ive)
 {
+	unsigned long subscribers;
+	unsigned int pos;
+
 	/*
 	 * Hold the remote lock while sending the interrupt so that
 	 * ivshmem_exit can synchronize on the completion of the delivery.
@@ -83,7 +117,30 @@ static void ivshmem_remote_interrupt(struct ivshmem_endpoint *ive)
 	spin_lock(&ive->remote_lock);
 	if (ive->remote)
 		arch_ivshmem_trigger_interrupt(ive->remote);
+
+	/* a publisher is eps[0], so its subscribers follow in the array */
+	for (subscribers = ive->subscribers; subscribers;
+	     subscribers &= subscribers - 1) {
+		pos = ffsl(subscribers);
+		arch_ivshmem_trigger_interrupt(ive + pos);
+	}
+	spin_unlock(&ive->remote_lock);
+}
+
+static u32 ivshmem_remote_state(struct ivshmem_endpoint *ive)
+{
+	u32 state = 0;
+	unsigned int pos;
+
+	spin_lock(&ive->remote_lock);
+	if (ive->remote)
+		state = ive->remote->state;
+	for (pos = 1; pos < JAILHOUSE_SHMEM_MAX_PEERS; pos++)
+		if (ive->subscribers & (1 << pos) && ive[pos].state != 0)
+			state |= 1 << pos;
 	spin_unlock(&ive->remote_lock);
+
+	return state;
 }
 
 static enum mmio_result ivshmem_register_mmio(void *arg,
@@ -126,9 +183,7 @@ static enum mmio_result ivshmem_register_mmio(void *arg,
 	}
 
 	if (mmio->address == IVSHMEM_REG_RSTATE && !mmio->is_write) {
-		spin_lock(&ive->remote_lock);
-		mmio->value = ive->remote ? ive->remote->state : 0;
-		spin_unlock(&ive->remote_lock);
+		mmio->value = ivshmem_remote_state(ive);
 		return MMIO_HANDLED;
 	}
 
@@ -307,6 +362,69 @@ enum pci_access ivshmem_pci_cfg_read(struct pci_device *device, u16 address,
 	return PCI_ACCESS_DONE;
 }
 
+static int ivshmem_check_region(struct cell *cell,
+				const struct jailhouse_memory *mem)
+{
+	u64 share = mem->flags & JAILHOUSE_MEM_SHARE_MASK;
+	u64 type = mem->flags & JAILHOUSE_MEM_TYPE_MASK;
+	u64 leaf_size = jailhouse_mem_leaf_size(mem);
+
+	if (type > JAILHOUSE_MEM_TYPE_WC || share > JAILHOUSE_MEM_SHARE_OUTER ||
+	    leaf_size == ~0ULL)
+		return trace_error(-EINVAL);
+	if (leaf_size == 0)
+		return 0;
+
+	/* colored regions are mapped page-wise and cannot use large leaves */
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		return trace_error(-EINVAL);
+
+	/* the region can only be mapped with leaves of leaf_size if aligned */
+	if ((mem->phys_start | mem->virt_start | mem->size) & (leaf_size - 1))
+		return trace_error(-EINVAL);
+	if (!paging_has_page_size(arch_get_cell_paging(cell), leaf_size))
+		return trace_error(-ENOSYS);
+
+	return 0;
+}
+
+static void ivshmem_connect(struct ivshmem_endpoint *ive,
+			    struct ivshmem_endpoint *remote)
+{
+	if (remote->device) {
+		ive->remote = remote;
+		remote->remote = ive;
+	}
+}
+
+static void ivshmem_connect_broadcast(struct ivshmem_endpoint *ive,
+				      unsigned int peers)
+{
+	struct ivshmem_endpoint *publisher = ive - ive->ivpos;
+	struct ivshmem_endpoint *subscriber;
+	unsigned int pos;
+
+	if (ive == publisher) {
+		for (pos = 1; pos < peers; pos++) {
+			subscriber = &publisher[pos];
+			if (!subscriber->device)
+				continue;
+			spin_lock(&subscriber->remote_lock);
+			subscriber->remote = publisher;
+			spin_unlock(&subscriber->remote_lock);
+			publisher->subscribers |= 1 << pos;
+		}
+	} else {
+		/* drop a publisher that left while we were away */
+		ive->remote = publisher->device ? publisher : NULL;
+		if (ive->remote) {
+			spin_lock(&publisher->remote_lock);
+			publisher->subscribers |= 1 << ive->ivpos;
+			spin_unlock(&publisher->remote_lock);
+		}
+	}
+}
+
 /**
  * Register a new ivshmem device.
  * @param cell		The cell the device should be attached to.
@@ -318,42 +436,49 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 {
 	const struct jailhouse_pci_device *dev_info = device->info;
 	const struct jailhouse_memory *mem, *peer_mem;
-	struct ivshmem_endpoint *ive, *remote;
-	struct pci_device *peer_dev;
+	unsigned int id = 0, peers = dev_info->shmem_peers;
+	struct pci_device *peer_dev = NULL;
+	struct ivshmem_endpoint *ive;
 	struct ivshmem_data *iv;
-	unsigned int id = 0;
+	int err;
 
 	printk("Adding virtual PCI device %02x:%02x.%x to cell \"%s\"\n",
 	       PCI_BDF_PARAMS(dev_info->bdf), cell->config->name);
 
-	if (dev_info->shmem_region >= cell->config->num_memory_regions)
+	if (dev_info->shmem_region >= cell->config->num_memory_regions ||
+	    peers == 1 || peers > JAILHOUSE_SHMEM_MAX_PEERS)
 		return trace_error(-EINVAL);
 
 	mem = jailhouse_cell_mem_regions(cell->config) + dev_info->shmem_region;
+	err = ivshmem_check_region(cell, mem);
+	if (err)
+		return err;
 
 	for (iv = ivshmem_list; iv; iv = iv->next)
 		if (iv->bdf == dev_info->bdf)
 			break;
 
 	if (iv) {
-		id = iv->eps[0].device ? 1 : 0;
-		if (iv->eps[id].device)
-			return trace_error(-EBUSY);
+		for (id = 0; id < JAILHOUSE_SHMEM_MAX_PEERS && !peer_dev; id++)
+			peer_dev = iv->eps[id].device;
 
-		peer_dev = iv->eps[id ^ 1].device;
 		peer_mem = jailhouse_cell_mem_regions(peer_dev->cell->config) +
 			peer_dev->info->shmem_region;
 
-		/* check that the regions and protocols of both peers match */
+		/*
+		 * Check that the regions and protocols of both peers match.
+		 * Mismatching memory types would break coherency.
+		 */
 		if (peer_mem->phys_start != mem->phys_start ||
 		    peer_mem->size != mem->size ||
-		    peer_dev->info->shmem_protocol != dev_info->shmem_protocol)
+		    (peer_mem->flags & JAILHOUSE_MEM_TYPE_MASK) !=
+		    (mem->flags & JAILHOUSE_MEM_TYPE_MASK) ||
+		    peer_dev->info->shmem_peers != peers ||
+		    !ivshmem_protocols_match(dev_info->shmem_protocol,
+					     peer_dev->info->shmem_protocol))
 			return trace_error(-EINVAL);
-
-		printk("Shared memory connection established: "
-		       "\"%s\" <--> \"%s\"\n",
-		       cell->config->name, peer_dev->cell->config->name);
 	} else {
+		BUILD_BUG_ON(sizeof(struct ivshmem_data) > PAGE_SIZE);
 		iv = page_alloc(&mem_pool, 1);
 		if (!iv)
 			return -ENOMEM;
@@ -363,17 +488,33 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 		ivshmem_list = iv;
 	}
 
+	if (peers == 0) {
+		id = iv->eps[0].device ? 1 : 0;
+	} else if (mem->flags & JAILHOUSE_MEM_WRITE) {
+		id = 0;
+	} else {
+		for (id = 1; id < peers - 1 && iv->eps[id].device; id++)
+			;
+	}
+	if (iv->eps[id].device)
+		return trace_error(-EBUSY);
+
 	ive = &iv->eps[id];
-	remote = &iv->eps[id ^ 1];
 
+	spin_lock_set_class(&ive->remote_lock, JAILHOUSE_LOCK_IVSHMEM_REMOTE);
 	ive->device = device;
 	ive->shmem = mem;
 	ive->ivpos = id;
 	device->ivshmem_endpoint = ive;
-	if (remote->device) {
-		ive->remote = remote;
-		remote->remote = ive;
-	}
+	if (peers == 0)
+		ivshmem_connect(ive, &iv->eps[id ^ 1]);
+	else
+		ivshmem_connect_broadcast(ive, peers);
+
+	if (peer_dev)
+		printk("Shared memory connection established: "
+		       "\"%s\" <--> \"%s\"\n",
+		       cell->config->name, peer_dev->cell->config->name);
 
 	device->cell = cell;
 	pci_reset_device(device);
@@ -423,11 +564,69 @@ void ivshmem_reset(struct pci_device *device)
  * @param device	The device to be stopped.
  *
  */
+static void ivshmem_release_link(struct ivshmem_endpoint *ive)
+{
+	struct ivshmem_data **ivp, *iv;
+
+	for (ivp = &ivshmem_list; *ivp; ivp = &(*ivp)->next) {
+		iv = *ivp;
+		if (&iv->eps[ive->ivpos] == ive) {
+			*ivp = iv->next;
+			page_free(&mem_pool, iv, 1);
+			break;
+		}
+	}
+}
+
+static void ivshmem_exit_broadcast(struct ivshmem_endpoint *ive,
+				   unsigned int peers)
+{
+	struct ivshmem_endpoint *publisher = ive - ive->ivpos;
+	struct ivshmem_endpoint *subscriber;
+	unsigned int pos;
+
+	if (ive == publisher) {
+		for (pos = 1; pos < peers; pos++) {
+			if (!(publisher->subscribers & (1 << pos)))
+				continue;
+			subscriber = &publisher[pos];
+			spin_lock(&subscriber->remote_lock);
+			subscriber->remote = NULL;
+			spin_unlock(&subscriber->remote_lock);
+		}
+
+		/* report the disconnection to the subscribers */
+		ivshmem_remote_interrupt(ive);
+
+		spin_lock(&publisher->remote_lock);
+		publisher->subscribers = 0;
+		spin_unlock(&publisher->remote_lock);
+	} else if (ive->remote) {
+		spin_lock(&publisher->remote_lock);
+		publisher->subscribers &= ~(1 << ive->ivpos);
+		spin_unlock(&publisher->remote_lock);
+
+		ivshmem_remote_interrupt(ive);
+
+		ive->remote = NULL;
+	}
+
+	ive->device = NULL;
+	for (pos = 0; pos < peers; pos++)
+		if (publisher[pos].device)
+			return;
+	ivshmem_release_link(ive);
+}
+
 void ivshmem_exit(struct pci_device *device)
 {
 	struct ivshmem_endpoint *ive = device->ivshmem_endpoint;
 	struct ivshmem_endpoint *remote = ive->remote;
-	struct ivshmem_data **ivp, *iv;
+
+	if (device->info->shmem_peers) {
+		ivshmem_exit_broadcast(ive, device->info->shmem_peers);
+		return;
+	}
 
 	if (remote) {
 		/*
@@ -443,13 +642,6 @@ void ivshmem_exit(struct pci_device *device)
 
 		ive->device = NULL;
 	} else {
-		for (ivp = &ivshmem_list; *ivp; ivp = &(*ivp)->next) {
-			iv = *ivp;
-			if (&iv->eps[ive->ivpos] == ive) {
-				*ivp = iv->next;
-				page_free(&mem_pool, iv, 1);
-				break;
-			}
-		}
+		ivshmem_release_link(ive);
 	}
 }
@@ -0,0 +1,182 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/percpu.h>
+#include <jailhouse/processor.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/spinlock.h>
+
+#define LOCK_BENCH_MAX_ITERATIONS	100000
+/* the result has to stay positive in a 32-bit hypercall return value */
+#define LOCK_BENCH_MAX_TOTAL		0x7fffffff
+/* time to wait for the second CPU, in milliseconds */
+#define LOCK_BENCH_JOIN_TIMEOUT		1000
+/* lets the waiter reach its spin loop before the lock is released */
+#define LOCK_BENCH_RELEASE_DELAY	100
+
+#define NO_WAITER			2
+
+/* protects the setup and teardown of a benchmark run */
+static DEFINE_SPINLOCK(bench_lock);
+
+/* the locks under test */
+static DEFINE_SPINLOCK(bench_ticket_lock);
+static DEFINE_MCS_SPINLOCK(bench_mcs_lock);
+
+static struct {
+	/** Cell running the benchmark, NULL if none. */
+	struct cell *cell;
+	unsigned long type;
+	unsigned long iterations;
+	/** Number of CPUs that joined the run. */
+	volatile unsigned int joined;
+	/** Number of CPUs that finished the run. */
+	volatile unsigned int finished;
+	/** CPU (0 or 1) waiting for the lock, NO_WAITER if none. */
+	volatile unsigned int waiter;
+	/** Timestamp of the last release of the lock. */
+	volatile u64 release_time;
+	/** Accumulated handoff latencies, per receiving CPU. */
+	u64 handoff_total[2];
+} bench;
+
+static void bench_acquire(void)
+{
+	if (bench.type == JAILHOUSE_LOCK_BENCH_MCS)
+		mcs_spin_lock(&bench_mcs_lock);
+	else
+		spin_lock(&bench_ticket_lock);
+}
+
+static void bench_release(void)
+{
+	if (bench.type == JAILHOUSE_LOCK_BENCH_MCS)
+		mcs_spin_unlock(&bench_mcs_lock);
+	else
+		spin_unlock(&bench_ticket_lock);
+}
+
+/*
+ * The lock is passed back and forth between both CPUs. Handoff n is released
+ * by CPU n % 2 while the other CPU is already spinning for the lock. Initially,
+ * CPU 0 holds the lock.
+ */
+static void bench_run(unsigned int rank)
+{
+	unsigned int peer = rank ^ 1;
+	unsigned long n;
+	unsigned int i;
+
+	for (n = 0; n < bench.iterations; n++) {
+		if (n % 2 == rank) {
+			while (bench.waiter != peer)
+				cpu_relax();
+			for (i = 0; i < LOCK_BENCH_RELEASE_DELAY; i++)
+				cpu_relax();
+
+			bench.release_time = get_timestamp();
+			bench_release();
+		} else {
+			bench.waiter = rank;
+			bench_acquire();
+			bench.handoff_total[rank] +=
+				get_timestamp() - bench.release_time;
+		}
+	}
+
+	/* the receiver of the last handoff holds the lock */
+	if (bench.iterations % 2 == rank)
+		bench_release();
+}
+
+static bool bench_join_timed_out(u64 start)
+{
+	bool timed_out;
+
+	if (get_timestamp() - start <
+	    (u64)LOCK_BENCH_JOIN_TIMEOUT * timestamp_khz())
+		return false;
+
+	spin_lock(&bench_lock);
+	timed_out = bench.joined < 2;
+	if (timed_out) {
+		bench_release();
+		bench.cell = NULL;
+	}
+	spin_unlock(&bench_lock);
+
+	return timed_out;
+}
+
+/**
+ * Measure the latency of passing a lock from one CPU to another.
+ * @param type		Lock type (JAILHOUSE_LOCK_BENCH_*).
+ * @param iterations	Number of handoffs.
+ *
+ * Two CPUs of the root cell have to invoke this concurrently with the same
+ * arguments. Both return the accumulated latency of all handoffs in timestamp
+ * ticks, saturated to 31 bits so that it cannot be mistaken for an error code.
+ *
+ * @return Accumulated latency (>=0) or negative error code.
+ */
+long lock_bench(unsigned long type, unsigned long iterations)
+{
+	struct cell *cell = this_cell();
+	unsigned int rank;
+	u64 start, total;
+
+	if (type > JAILHOUSE_LOCK_BENCH_MCS || iterations == 0 ||
+	    iterations > LOCK_BENCH_MAX_ITERATIONS)
+		return trace_error(-EINVAL);
+
+	spin_lock(&bench_lock);
+	if (!bench.cell) {
+		bench.cell = cell;
+		bench.type = type;
+		bench.iterations = iterations;
+		bench.joined = 1;
+		bench.finished = 0;
+		bench.waiter = NO_WAITER;
+		bench.handoff_total[0] = bench.handoff_total[1] = 0;
+		bench_acquire();
+		rank = 0;
+	} else if (bench.cell == cell && bench.joined == 1 &&
+		   bench.finished == 0 && bench.type == type &&
+		   bench.iterations == iterations) {
+		bench.joined = 2;
+		rank = 1;
+	} else {
+		spin_unlock(&bench_lock);
+		return -EBUSY;
+	}
+	spin_unlock(&bench_lock);
+
+	start = get_timestamp();
+	while (bench.joined < 2) {
+		if (bench_join_timed_out(start))
+			return -ETIMEDOUT;
+		cpu_relax();
+	}
+
+	bench_run(rank);
+
+	spin_lock(&bench_lock);
+	bench.finished++;
+	spin_unlock(&bench_lock);
+	while (bench.finished < 2)
+		cpu_relax();
+
+	total = bench.handoff_total[0] + bench.handoff_total[1];
+
+	spin_lock(&bench_lock);
+	/* the last CPU to leave frees the benchmark for the next run */
+	if (--bench.joined == 0)
+		bench.cell = NULL;
+	spin_unlock(&bench_lock);
+
+	return total < LOCK_BENCH_MAX_TOTAL ? total : LOCK_BENCH_MAX_TOTAL;
+}
@@ -0,0 +1,77 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/entry.h>
+#include <jailhouse/percpu.h>
+#include <jailhouse/spinlock.h>
+
+/** True if lock acquisitions are recorded. */
+bool lock_stat_enabled;
+
+/**
+ * Account a lock acquisition of the calling CPU.
+ * @param class		Class of the lock (JAILHOUSE_LOCK_*).
+ * @param contended	True if the lock was held by another CPU.
+ * @param wait		Waiting time in timestamp ticks.
+ *
+ * @note The statistics are per CPU, thus no synchronization is required.
+ */
+void lock_stat_record(unsigned int class, bool contended, u64 wait)
+{
+	struct lock_stat *stat = &this_cpu_public()->lock_stat[class];
+
+	stat->acquired++;
+	if (contended) {
+		stat->contended++;
+		stat->wait_total += wait;
+		if (wait > stat->wait_max)
+			stat->wait_max = wait;
+	}
+}
+
+/**
+ * Report a lock statistic, accumulated over all CPUs.
+ * @param type		Information type from JAILHOUSE_INFO_LOCK_STAT_BASE on.
+ * @param value		Buffer for the statistic value.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int lock_stat_get_info(unsigned long type, u64 *value)
+{
+	unsigned int class, cpu;
+	struct lock_stat *stat;
+
+	if (type < JAILHOUSE_INFO_LOCK_STAT_BASE)
+		return -EINVAL;
+	type -= JAILHOUSE_INFO_LOCK_STAT_BASE;
+	class = type / JAILHOUSE_NUM_LOCK_STATS;
+	if (class >= JAILHOUSE_NUM_LOCK_CLASSES)
+		return -EINVAL;
+
+	*value = 0;
+	for (cpu = 0; cpu < hypervisor_header.max_cpus; cpu++) {
+		stat = &public_per_cpu(cpu)->lock_stat[class];
+
+		switch (type % JAILHOUSE_NUM_LOCK_STATS) {
+		case JAILHOUSE_LOCK_STAT_ACQUIRED:
+			*value += stat->acquired;
+			break;
+		case JAILHOUSE_LOCK_STAT_CONTENDED:
+			*value += stat->contended;
+			break;
+		case JAILHOUSE_LOCK_STAT_WAIT_MAX:
+			if (stat->wait_max > *value)
+				*value = stat->wait_max;
+			break;
+		case JAILHOUSE_LOCK_STAT_WAIT_TOTAL:
+			*value += stat->wait_total;
+			break;
+		}
+	}
+
+	return 0;
+}
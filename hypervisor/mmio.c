@@ -15,6 +15,7 @@
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/unit.h>
 #include <jailhouse/percpu.h>
 
@@ -28,18 +29,17 @@
  */
 int mmio_cell_init(struct cell *cell)
 {
-	const struct jailhouse_memory *mem;
 	const struct unit *unit;
-	unsigned int n;
 	void *pages;
 
 	/* cell is zero-initialized */;
+	spin_lock_set_class(&cell->mmio_region_lock,
+			    JAILHOUSE_LOCK_MMIO_REGION);
+
 	for_each_unit(unit)
 		cell->max_mmio_regions += unit->mmio_count_regions(cell);
 
-	for_each_mem_region(mem, cell->config, n)
-		if (JAILHOUSE_MEMORY_IS_SUBPAGE(mem))
-			cell->max_mmio_regions++;
+	cell->max_mmio_regions += cell->num_subpage_regions;
 
 	pages = page_alloc(&mem_pool,
 			   PAGES(cell->max_mmio_regions *
@@ -241,13 +241,20 @@ enum mmio_result mmio_handle_access(struct mmio_access *mmio)
 {
 	struct mmio_region_handler handler;
 	unsigned long region_base;
+	enum mmio_result result;
 
 	if (find_region(this_cell(), mmio->address, mmio->size, &region_base,
 			&handler) < 0)
 		return MMIO_UNHANDLED;
 
 	mmio->address -= region_base;
-	return handler.function(handler.arg, mmio);
+	result = handler.function(handler.arg, mmio);
+
+	trace_event(mmio->is_write ? JAILHOUSE_TRACE_MMIO_WRITE :
+				     JAILHOUSE_TRACE_MMIO_READ,
+		    region_base + mmio->address, mmio->value);
+
+	return result;
 }
 
 /**
@@ -230,6 +230,28 @@ unsigned long paging_virt2phys(const struct paging_structures *pg_structs,
 	}
 }
 
+/**
+ * Check if a paging structure can map leaf entries of the given size.
+ * @param pg_structs	Paging structures to check.
+ * @param size		Page size in bytes.
+ *
+ * @return True if some level of the paging structures maps pages of that
+ * 	   size, false otherwise.
+ */
+bool paging_has_page_size(const struct paging_structures *pg_structs,
+			  unsigned long size)
+{
+	const struct paging *paging = pg_structs->root_paging;
+
+	while (1) {
+		if (paging->page_size == size)
+			return true;
+		if (paging->page_size == PAGE_SIZE)
+			return false;
+		paging++;
+	}
+}
+
 static void flush_pt_entry(pt_entry_t pte, enum paging_coherent coherent)
 {
 	if (coherent == PAGING_COHERENT)
@@ -265,6 +287,83 @@ static int split_hugepage(bool hv_paging, const struct paging *paging,
 			     flags, coherent);
 }
 
+/*
+ * Check if a page table maps a physically contiguous range with uniform
+ * access flags, i.e. could be replaced by a single terminal entry of the
+ * parent level. Returns the physical start address of that range or
+ * INVALID_PHYS_ADDR.
+ */
+static unsigned long page_table_merge_phys(const struct paging *paging,
+					   page_table_t pt, unsigned long virt,
+					   unsigned long table_size)
+{
+	unsigned long phys, flags, offs;
+	pt_entry_t pte;
+
+	pte = paging->get_entry(pt, virt);
+	if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
+		return INVALID_PHYS_ADDR;
+	phys = paging->get_phys(pte, virt);
+	if (phys == INVALID_PHYS_ADDR || (phys & (table_size - 1)) != 0)
+		return INVALID_PHYS_ADDR;
+	flags = paging->get_flags(pte);
+
+	for (offs = paging->page_size; offs < table_size;
+	     offs += paging->page_size) {
+		pte = paging->get_entry(pt, virt + offs);
+		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS) ||
+		    paging->get_phys(pte, virt + offs) != phys + offs ||
+		    paging->get_flags(pte) != flags)
+			return INVALID_PHYS_ADDR;
+	}
+	return phys;
+}
+
+/*
+ * Replace completely populated page tables by hugepages of the parent level,
+ * walking up from level n as long as this succeeds. This undoes
+ * split_hugepage once the holes it was needed for have been closed again.
+ *
+ * The caller has just written a terminal entry with the given flags for virt
+ * at level n. As all merged entries have to match that one, the flags are
+ * valid for the parent level as well.
+ */
+static void merge_page_tables(const struct paging *paging,
+			      page_table_t pt[], int n, unsigned long virt,
+			      unsigned long flags, enum paging_coherent coherent)
+{
+	const struct paging *parent;
+	unsigned long table_size, phys;
+	pt_entry_t pte;
+
+	for (; n > 0; n--, paging--) {
+		parent = paging - 1;
+		table_size = parent->page_size;
+		if (table_size == 0)
+			break;
+
+		phys = page_table_merge_phys(paging, pt[n],
+					     virt & ~(table_size - 1),
+					     table_size);
+		if (phys == INVALID_PHYS_ADDR)
+			break;
+
+		/*
+		 * Break before make: no walker may see the table and the
+		 * hugepage at the same time or still follow the table once it
+		 * is freed.
+		 */
+		pte = parent->get_entry(pt[n - 1], virt);
+		parent->clear_entry(pte);
+		flush_pt_entry(pte, coherent);
+		arch_paging_flush_cell_tlbs();
+
+		parent->set_terminal(pte, phys, flags);
+		flush_pt_entry(pte, coherent);
+		page_free(&mem_pool, pt[n], 1);
+	}
+}
+
 /**
  * Create or modify a page map.
  * @param pg_structs	Descriptor of paging structures to be used.
@@ -278,7 +377,9 @@ static int split_hugepage(bool hv_paging, const struct paging *paging,
  * @return 0 on success, negative error code otherwise.
  *
  * @note The function aims at using the largest possible page size for the
- * mapping but does not consolidate with neighboring mappings.
+ * mapping. For cells, it also consolidates page tables that became
+ * completely populated with neighboring mappings of the same kind into
+ * hugepages again.
  *
  * @see paging_destroy
  * @see paging_get_guest_pages
@@ -293,13 +394,16 @@ int paging_create(const struct paging_structures *pg_structs,
 
 	while (size > 0) {
 		const struct paging *paging = pg_structs->root_paging;
-		page_table_t pt = pg_structs->root_table;
+		page_table_t pt[MAX_PAGE_TABLE_LEVELS];
 		struct paging_structures sub_structs;
+		unsigned long table_size;
 		pt_entry_t pte;
+		int n = 0;
 		int err;
 
+		pt[0] = pg_structs->root_table;
 		while (1) {
-			pte = paging->get_entry(pt, virt);
+			pte = paging->get_entry(pt[n], virt);
 			if (paging->page_size > 0 &&
 			    paging->page_size <= size &&
 			    ((phys | virt) & (paging->page_size - 1)) == 0) {
@@ -311,7 +415,7 @@ int paging_create(const struct paging_structures *pg_structs,
 				 */
 				if (paging->page_size > PAGE_SIZE) {
 					sub_structs.root_paging = paging;
-					sub_structs.root_table = pt;
+					sub_structs.root_table = pt[n];
 					sub_structs.hv_paging =
 						pg_structs->hv_paging;
 					paging_destroy(&sub_structs, virt,
@@ -328,14 +432,14 @@ int paging_create(const struct paging_structures *pg_structs,
 						     coherent);
 				if (err)
 					return err;
-				pt = paging_phys2hvirt(
+				pt[++n] = paging_phys2hvirt(
 						paging->get_next_pt(pte));
 			} else {
-				pt = page_alloc(&mem_pool, 1);
-				if (!pt)
+				pt[++n] = page_alloc(&mem_pool, 1);
+				if (!pt[n])
 					return -ENOMEM;
 				paging->set_next_pt(pte,
-						    paging_hvirt2phys(pt));
+						    paging_hvirt2phys(pt[n]));
 				flush_pt_entry(pte, coherent);
 			}
 			paging++;
@@ -343,6 +447,19 @@ int paging_create(const struct paging_structures *pg_structs,
 		if (pg_structs->hv_paging)
 			arch_paging_flush_page_tlbs(virt);
 
+		/*
+		 * Try to merge when the last entry of a table or of the
+		 * requested range was written. The hypervisor's own page
+		 * tables are left alone as they may be linked into other
+		 * paging structures.
+		 */
+		table_size = n > 0 ? (paging - 1)->page_size : 0;
+		if (!pg_structs->hv_paging && table_size > 0 &&
+		    (size == paging->page_size ||
+		     ((virt + paging->page_size) & (table_size - 1)) == 0))
+			merge_page_tables(paging, pt, n, virt, flags,
+					  coherent);
+
 		phys += paging->page_size;
 		virt += paging->page_size;
 		size -= paging->page_size;
@@ -689,6 +806,50 @@ int paging_init(void)
 	return 0;
 }
 
+/**
+ * Count the terminal entries of a page map that back a virtual address range.
+ * @param pg_structs	Descriptor of paging structures to be used.
+ * @param virt		Start of the virtual address range.
+ * @param size		Size of the range.
+ * @param counts	Per-level counters, indexed by paging level starting at
+ * 			the root level. Found entries are added to them.
+ *
+ * Entries that are only partially covered by the range are counted as well.
+ */
+void paging_count_pages(const struct paging_structures *pg_structs,
+			unsigned long virt, unsigned long size,
+			unsigned long counts[MAX_PAGE_TABLE_LEVELS])
+{
+	while (size > 0) {
+		const struct paging *paging = pg_structs->root_paging;
+		page_table_t pt = pg_structs->root_table;
+		unsigned long page_size;
+		unsigned int level = 0;
+		pt_entry_t pte;
+
+		while (1) {
+			pte = paging->get_entry(pt, virt);
+			if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
+				break;
+			if (paging->get_phys(pte, virt) != INVALID_PHYS_ADDR) {
+				counts[level]++;
+				break;
+			}
+			pt = paging_phys2hvirt(paging->get_next_pt(pte));
+			paging++;
+			level++;
+		}
+
+		/* continue after the entry found at this level */
+		page_size = paging->page_size ? paging->page_size : PAGE_SIZE;
+		page_size -= virt & (page_size - 1);
+		if (page_size >= size)
+			break;
+		virt += page_size;
+		size -= page_size;
+	}
+}
+
 /**
  * Dump usage statistic of the page pools.
  * @param when String that characterizes the associated event.
@@ -22,6 +22,16 @@
 
 #define MSIX_VECTOR_CTRL_DWORD		3
 
+/*
+ * Read-only header registers that are served from the device shadow:
+ * revision/class code, subsystem IDs (endpoints only) and the capability
+ * pointer. Vendor and device ID are not shadowed: drivers read them to detect
+ * devices that are in reset or were removed, which then return all ones.
+ */
+#define PCI_CFG_SHADOW_ENDPOINT		((1 << (0x08/4)) | (1 << (0x2c/4)) | \
+					 (1 << (0x34/4)))
+#define PCI_CFG_SHADOW_BRIDGE		((1 << (0x08/4)) | (1 << (0x34/4)))
+
 #define for_each_configured_pci_device(dev, cell)			\
 	for ((dev) = (cell)->pci_devices;				\
 	     (dev) - (cell)->pci_devices < (cell)->config->num_pci_devices; \
@@ -142,6 +152,28 @@ void pci_write_config(u16 bdf, u16 address, u32 value, unsigned int size)
 		mmio_write32(mmcfg_addr, value);
 }
 
+static unsigned int pci_bdf_hash(const struct cell *cell, u16 bdf)
+{
+	return ((u32)bdf * 0x9e3779b1) >> (32 - cell->pci_device_hash_bits);
+}
+
+static void pci_hash_device(struct cell *cell, struct pci_device *device)
+{
+	unsigned int mask = (1 << cell->pci_device_hash_bits) - 1;
+	unsigned int n;
+
+	/*
+	 * Keep the first device in case of duplicate BDFs, like the linear
+	 * lookup over the configuration did.
+	 */
+	for (n = pci_bdf_hash(cell, device->info->bdf);
+	     cell->pci_device_hash[n]; n = (n + 1) & mask)
+		if (cell->pci_device_hash[n]->info->bdf == device->info->bdf)
+			return;
+
+	cell->pci_device_hash[n] = device;
+}
+
 /**
  * Look up device owned by a cell.
  * @param[in] cell	Owning cell.
@@ -151,16 +183,20 @@ void pci_write_config(u16 bdf, u16 address, u32 value, unsigned int size)
  */
 struct pci_device *pci_get_assigned_device(const struct cell *cell, u16 bdf)
 {
-	const struct jailhouse_pci_device *dev_info =
-		jailhouse_cell_pci_devices(cell->config);
-	u32 n;
+	unsigned int mask = (1 << cell->pci_device_hash_bits) - 1;
+	struct pci_device *device;
+	unsigned int n;
 
-	/* We iterate over the static device information to increase cache
-	 * locality. */
-	for (n = 0; n < cell->config->num_pci_devices; n++)
-		if (dev_info[n].bdf == bdf)
-			return cell->pci_devices[n].cell ?
-				&cell->pci_devices[n] : NULL;
+	if (!cell->pci_device_hash)
+		return NULL;
+
+	/* The table is at most half full, so there is always a free slot. */
+	for (n = pci_bdf_hash(cell, bdf); cell->pci_device_hash[n];
+	     n = (n + 1) & mask) {
+		device = cell->pci_device_hash[n];
+		if (device->info->bdf == bdf)
+			return device->cell ? device : NULL;
+	}
 
 	return NULL;
 }
@@ -177,18 +213,38 @@ struct pci_device *pci_get_assigned_device(const struct cell *cell, u16 bdf)
 static const struct jailhouse_pci_capability *
 pci_find_capability(struct pci_device *device, u16 address)
 {
-	const struct jailhouse_pci_capability *cap =
-		jailhouse_cell_pci_caps(device->cell->config) +
-		device->info->caps_start;
+	const struct jailhouse_pci_capability *cap = device->last_cap;
 	u32 n;
 
+	/* Drivers tend to poll the same capability, e.g. for link status. */
+	if (cap && cap->start <= address && cap->start + cap->len > address)
+		return cap;
+
+	if (address < device->cap_range_start ||
+	    address >= device->cap_range_end)
+		return NULL;
+
+	cap = jailhouse_cell_pci_caps(device->cell->config) +
+		device->info->caps_start;
 	for (n = 0; n < device->info->num_caps; n++, cap++)
-		if (cap->start <= address && cap->start + cap->len > address)
+		if (cap->start <= address && cap->start + cap->len > address) {
+			device->last_cap = cap;
 			return cap;
+		}
 
 	return NULL;
 }
 
+static bool pci_cfg_shadowed(struct pci_device *device, u16 address)
+{
+	unsigned int shadow_mask =
+		device->info->type == JAILHOUSE_PCI_TYPE_BRIDGE ?
+		PCI_CFG_SHADOW_BRIDGE : PCI_CFG_SHADOW_ENDPOINT;
+
+	return address < PCI_CONFIG_HEADER_SIZE &&
+		shadow_mask & (1 << (address / 4));
+}
+
 /**
  * Moderate config space read access.
  * @param device	The device to be accessed. If NULL, access will be
@@ -232,6 +288,12 @@ enum pci_access pci_cfg_read_moderate(struct pci_device *device, u16 address,
 	if (device->info->type == JAILHOUSE_PCI_TYPE_IVSHMEM)
 		return ivshmem_pci_cfg_read(device, address, value);
 
+	if (pci_cfg_shadowed(device, address)) {
+		*value = device->cfg_shadow[address / 4] >>
+			((address % 4) * 8);
+		return PCI_ACCESS_DONE;
+	}
+
 	if (address < PCI_CONFIG_HEADER_SIZE)
 		return PCI_ACCESS_PERFORM;
 
@@ -573,6 +635,25 @@ void pci_reset_device(struct pci_device *device)
 			 PCI_CMD_INTX_OFF, 2);
 }
 
+static void pci_init_cap_range(struct cell *cell, struct pci_device *device)
+{
+	const struct jailhouse_pci_capability *cap =
+		jailhouse_cell_pci_caps(cell->config) +
+		device->info->caps_start;
+	unsigned int n;
+
+	device->cap_range_start = 0xffff;
+	device->cap_range_end = 0;
+	device->last_cap = NULL;
+
+	for (n = 0; n < device->info->num_caps; n++, cap++) {
+		if (cap->start < device->cap_range_start)
+			device->cap_range_start = cap->start;
+		if (cap->start + cap->len > device->cap_range_end)
+			device->cap_range_end = cap->start + cap->len;
+	}
+}
+
 static int pci_add_physical_device(struct cell *cell, struct pci_device *device)
 {
 	unsigned int n, pages, size = device->info->msix_region_size;
@@ -585,6 +666,13 @@ static int pci_add_physical_device(struct cell *cell, struct pci_device *device)
 		device->bar[n] = pci_read_config(device->info->bdf,
 						 PCI_CFG_BAR + n * 4, 4);
 
+	for (n = 0; n < PCI_CONFIG_HEADER_SIZE; n += 4)
+		if (pci_cfg_shadowed(device, n))
+			device->cfg_shadow[n / 4] =
+				pci_read_config(device->info->bdf, n, 4);
+
+	pci_init_cap_range(cell, device);
+
 	err = arch_pci_add_physical_device(cell, device);
 	if (err)
 		return err;
@@ -669,7 +757,7 @@ static int pci_cell_init(struct cell *cell)
 		jailhouse_cell_pci_devices(cell->config);
 	const struct jailhouse_pci_capability *cap;
 	struct pci_device *device, *root_device;
-	unsigned int ndev, ncap;
+	unsigned int ndev, ncap, hash_pages;
 	int err;
 
 	if (mmcfg_start != 0)
@@ -683,6 +771,18 @@ static int pci_cell_init(struct cell *cell)
 	if (!cell->pci_devices)
 		return -ENOMEM;
 
+	cell->pci_device_hash_bits = 1;
+	while ((1U << cell->pci_device_hash_bits) <
+	       cell->config->num_pci_devices * 2)
+		cell->pci_device_hash_bits++;
+	hash_pages = PAGES(sizeof(struct pci_device *) <<
+			   cell->pci_device_hash_bits);
+	cell->pci_device_hash = page_alloc(&mem_pool, hash_pages);
+	if (!cell->pci_device_hash) {
+		page_free(&mem_pool, cell->pci_devices, devlist_pages);
+		return -ENOMEM;
+	}
+
 	/*
 	 * We order device states in the same way as the static information
 	 * so that we can use the index of the latter to find the former. For
@@ -693,6 +793,7 @@ static int pci_cell_init(struct cell *cell)
 		device = &cell->pci_devices[ndev];
 		device->info = &dev_infos[ndev];
 		device->msix_vectors = device->msix_vector_array;
+		pci_hash_device(cell, device);
 
 		if (device->info->type == JAILHOUSE_PCI_TYPE_IVSHMEM) {
 			err = ivshmem_init(cell, device);
@@ -780,6 +881,9 @@ static void pci_cell_exit(struct cell *cell)
 			}
 		}
 
+	page_free(&mem_pool, cell->pci_device_hash,
+		  PAGES(sizeof(struct pci_device *) <<
+			cell->pci_device_hash_bits));
 	page_free(&mem_pool, cell->pci_devices, devlist_pages);
 }
 
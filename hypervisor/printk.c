@@ -14,15 +14,15 @@
 #include <jailhouse/control.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/processor.h>
+#include <jailhouse/spinlock.h>
 #include <jailhouse/string.h>
 #include <asm/bitops.h>
-#include <asm/spinlock.h>
 
 bool virtual_console = false;
 volatile struct jailhouse_virt_console console
 	__attribute__((section(".console")));
 
-static DEFINE_SPINLOCK(printk_lock);
+static DEFINE_SPINLOCK_CLASS(printk_lock, JAILHOUSE_LOCK_PRINTK);
 
 static void console_write(const char *msg)
 {
@@ -14,13 +14,15 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/entry.h>
 #include <jailhouse/gcov.h>
+#include <jailhouse/profile.h>
+#include <jailhouse/spinlock.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/control.h>
 #include <jailhouse/string.h>
 #include <jailhouse/unit.h>
 #include <generated/version.h>
-#include <asm/spinlock.h>
 
 extern u8 __text_start[], __page_pool[];
 
@@ -107,6 +109,8 @@ static void cpu_init(struct per_cpu *cpu_data)
 		goto failed;
 
 	cpu_data->public.cell = &root_cell;
+	spin_lock_set_class(&cpu_data->public.control_lock,
+			    JAILHOUSE_LOCK_CPU_CONTROL);
 
 	/* set up per-CPU page table */
 	cpu_data->pg_structs.hv_paging = true;
@@ -136,6 +140,8 @@ static void cpu_init(struct per_cpu *cpu_data)
 	if (err)
 		goto failed;
 
+	trace_cpu_init(&cpu_data->public);
+
 	/* Make sure any remappings to the temporary regions can be performed
 	 * without allocations of page table pages. */
 	err = paging_create(&cpu_data->pg_structs, 0,
@@ -241,6 +247,7 @@ int entry(unsigned int cpu_id, struct per_cpu *cpu_data)
 	if (!error && master) {
 		init_late();
 		if (!error) {
+			lock_stat_enable();
 			/*
 			 * Make sure everything was committed before we signal
 			 * the other CPUs that they can continue.
@@ -275,4 +282,6 @@ hypervisor_header = {
 	.percpu_size = sizeof(struct per_cpu),
 	.entry = arch_entry - JAILHOUSE_BASE,
 	.console_page = (unsigned long)&console - JAILHOUSE_BASE,
+	.trace_offset = TRACE_OFFSET,
+	.profile_offset = PROFILE_OFFSET,
 };
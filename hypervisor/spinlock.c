@@ -0,0 +1,97 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/percpu.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/spinlock.h>
+
+/*
+ * A queue node is referred to by the ID of its CPU plus one, so that 0 means
+ * no node, and its index in the per-CPU array.
+ */
+#define MCS_NODE_ID(cpu, idx)	((((cpu) + 1) << 2) | (idx))
+#define MCS_NODE_CPU(id)	(((id) >> 2) - 1)
+#define MCS_NODE_IDX(id)	((id) & 3)
+
+static struct mcs_node *mcs_node(u32 id)
+{
+	return &public_per_cpu(MCS_NODE_CPU(id))->mcs_nodes[MCS_NODE_IDX(id)];
+}
+
+/**
+ * Acquire an MCS lock.
+ * @param lock		Lock to be acquired.
+ *
+ * Waiting CPUs are served in FIFO order. Each one spins on its own queue
+ * node, so only the next waiter is disturbed when the lock is passed on.
+ */
+void mcs_spin_lock(mcs_spinlock_t *lock)
+{
+	struct public_per_cpu *cpu_public = this_cpu_public();
+	unsigned int idx = cpu_public->mcs_nesting;
+	struct mcs_node *node;
+	u32 id, prev;
+#ifdef CONFIG_JAILHOUSE_LOCK_STAT
+	u64 start = get_timestamp();
+#endif
+
+	if (idx >= MCS_MAX_NESTING) {
+		panic_printk("FATAL: MCS lock nesting too deep\n");
+		panic_stop();
+	}
+	cpu_public->mcs_nesting++;
+
+	node = &cpu_public->mcs_nodes[idx];
+	node->next = 0;
+	node->locked = false;
+	id = MCS_NODE_ID(cpu_public->cpu_id, idx);
+
+	/* the node has to be initialized before it becomes visible */
+	prev = __atomic_exchange_n(&lock->tail, id, __ATOMIC_ACQ_REL);
+	if (prev) {
+		__atomic_store_n(&mcs_node(prev)->next, id, __ATOMIC_RELEASE);
+		while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+			cpu_relax();
+	}
+
+#ifdef CONFIG_JAILHOUSE_LOCK_STAT
+	if (lock_stat_enabled)
+		lock_stat_record(lock->class, prev != 0,
+				 prev ? get_timestamp() - start : 0);
+#endif
+}
+
+/**
+ * Release an MCS lock.
+ * @param lock		Lock to be released.
+ *
+ * @note MCS locks have to be released in reverse order of their acquisition.
+ */
+void mcs_spin_unlock(mcs_spinlock_t *lock)
+{
+	struct public_per_cpu *cpu_public = this_cpu_public();
+	unsigned int idx = --cpu_public->mcs_nesting;
+	struct mcs_node *node = &cpu_public->mcs_nodes[idx];
+	u32 id = MCS_NODE_ID(cpu_public->cpu_id, idx);
+	u32 next;
+
+	next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+	if (!next) {
+		/* no waiter, try to leave the lock free */
+		if (__atomic_compare_exchange_n(&lock->tail, &id, 0, false,
+						__ATOMIC_RELEASE,
+						__ATOMIC_RELAXED))
+			return;
+
+		/* a new waiter is about to link itself */
+		while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+			cpu_relax();
+	}
+
+	__atomic_store_n(&mcs_node(next)->locked, true, __ATOMIC_RELEASE);
+}
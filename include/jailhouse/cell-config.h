@@ -45,13 +45,19 @@
  * Incremented on any layout or semantic change of system or cell config.
  * Also update HEADER_REVISION in tools.
  */
-#define JAILHOUSE_CONFIG_REVISION	10
+#define JAILHOUSE_CONFIG_REVISION	12
 
 #define JAILHOUSE_CELL_NAME_MAXLEN	31
 
 #define JAILHOUSE_CELL_PASSIVE_COMMREG	0x00000001
 #define JAILHOUSE_CELL_TEST_DEVICE	0x00000002
 
+/*
+ * The flag JAILHOUSE_CELL_PMU hands the performance monitoring unit of the
+ * cell's CPUs over to the cell. Without it, the PMU is hidden from the cell.
+ */
+#define JAILHOUSE_CELL_PMU		0x00000004
+
 /*
  * The flag JAILHOUSE_CELL_VIRTUAL_CONSOLE_PERMITTED allows inmates to invoke
  * the dbg putc hypercall.
@@ -94,6 +100,7 @@ struct jailhouse_cell_desc {
 	__u32 vpci_irq_base;
 
 	__u64 cpu_reset_address;
+	/** Timeout for message replies in microseconds, 0 to wait forever. */
 	__u64 msg_reply_timeout;
 
 	struct jailhouse_console console;
@@ -108,11 +115,33 @@ struct jailhouse_cell_desc {
 #define JAILHOUSE_MEM_LOADABLE		0x0040
 #define JAILHOUSE_MEM_ROOTSHARED	0x0080
 #define JAILHOUSE_MEM_IO_UNALIGNED	0x0100
+#define JAILHOUSE_MEM_COLORED		0x0200
+#define JAILHOUSE_MEM_SHARED_RO		0x0400
 #define JAILHOUSE_MEM_IO_WIDTH_SHIFT	16 /* uses bits 16..19 */
 #define JAILHOUSE_MEM_IO_8		(1 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
 #define JAILHOUSE_MEM_IO_16		(2 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
 #define JAILHOUSE_MEM_IO_32		(4 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
 #define JAILHOUSE_MEM_IO_64		(8 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
+#define JAILHOUSE_MEM_TYPE_SHIFT	20 /* uses bits 20..21 */
+#define JAILHOUSE_MEM_TYPE_MASK		(3 << JAILHOUSE_MEM_TYPE_SHIFT)
+#define JAILHOUSE_MEM_TYPE_WB		(0 << JAILHOUSE_MEM_TYPE_SHIFT)
+#define JAILHOUSE_MEM_TYPE_NC		(1 << JAILHOUSE_MEM_TYPE_SHIFT)
+#define JAILHOUSE_MEM_TYPE_WC		(2 << JAILHOUSE_MEM_TYPE_SHIFT)
+#define JAILHOUSE_MEM_SHARE_SHIFT	22 /* uses bits 22..23 */
+#define JAILHOUSE_MEM_SHARE_MASK	(3 << JAILHOUSE_MEM_SHARE_SHIFT)
+#define JAILHOUSE_MEM_SHARE_GUEST	(0 << JAILHOUSE_MEM_SHARE_SHIFT)
+#define JAILHOUSE_MEM_SHARE_INNER	(1 << JAILHOUSE_MEM_SHARE_SHIFT)
+#define JAILHOUSE_MEM_SHARE_OUTER	(2 << JAILHOUSE_MEM_SHARE_SHIFT)
+#define JAILHOUSE_MEM_LEAF_SHIFT	24 /* uses bits 24..25 */
+#define JAILHOUSE_MEM_LEAF_MASK		(3 << JAILHOUSE_MEM_LEAF_SHIFT)
+#define JAILHOUSE_MEM_LEAF_ANY		(0 << JAILHOUSE_MEM_LEAF_SHIFT)
+#define JAILHOUSE_MEM_LEAF_2M		(1 << JAILHOUSE_MEM_LEAF_SHIFT)
+#define JAILHOUSE_MEM_LEAF_1G		(2 << JAILHOUSE_MEM_LEAF_SHIFT)
+#define JAILHOUSE_MEM_COLORS_SHIFT	32 /* uses bits 32..63 */
+#define JAILHOUSE_MEM_COLORS(colors)	\
+	((__u64)(colors) << JAILHOUSE_MEM_COLORS_SHIFT)
+#define JAILHOUSE_MEM_COLOR_FLAGS	\
+	(JAILHOUSE_MEM_COLORED | JAILHOUSE_MEM_COLORS(0xffffffff))
 
 struct jailhouse_memory {
 	__u64 phys_start;
@@ -124,6 +153,41 @@ struct jailhouse_memory {
 #define JAILHOUSE_MEMORY_IS_SUBPAGE(mem)	\
 	((mem)->virt_start & ~PAGE_MASK || (mem)->size & ~PAGE_MASK)
 
+/*
+ * A read-only region (JAILHOUSE_MEM_SHARED_RO) may be mapped by several
+ * non-root cells using identical phys_start and size. It is taken from the
+ * root cell when the first of those cells is created and handed back when the
+ * last one is destroyed. Images are loaded into it via a cell that also marks
+ * it JAILHOUSE_MEM_LOADABLE.
+ */
+
+/*
+ * The memory type (JAILHOUSE_MEM_TYPE_*) of a RAM region defaults to
+ * write-back. Uncached (NC) and write-combining (WC) mappings are meant for
+ * shared memory that is exchanged with non-coherent agents or mostly streamed
+ * in one direction. On ARM, both result in Normal Non-cacheable memory, and
+ * JAILHOUSE_MEM_SHARE_* can force the shareability domain that is otherwise
+ * left to the guest. x86 ignores the shareability.
+ *
+ * JAILHOUSE_MEM_LEAF_2M and JAILHOUSE_MEM_LEAF_1G request that the region is
+ * mapped with leaf entries of that size. This is currently enforced for
+ * ivshmem regions only: phys_start, virt_start and size have to be aligned
+ * accordingly, the CPU has to support that page size for the cell, and the
+ * region must not be colored.
+ */
+
+/*
+ * Cache coloring works on 4K pages. The color of a page is its page frame
+ * number modulo the number of colors (LLC way size / 4K). A colored memory
+ * region (JAILHOUSE_MEM_COLORED) describes a physical window of phys_start and
+ * size, both aligned to the way size. The cell only receives those pages of
+ * the window that match the colors given via JAILHOUSE_MEM_COLORS(), mapped
+ * contiguously at virt_start.
+ */
+#define JAILHOUSE_COLOR_PAGE_SHIFT	12
+#define JAILHOUSE_COLOR_PAGE_SIZE	(1UL << JAILHOUSE_COLOR_PAGE_SHIFT)
+#define JAILHOUSE_MAX_COLORS		32
+
 #define JAILHOUSE_CACHE_L3_CODE		0x01
 #define JAILHOUSE_CACHE_L3_DATA		0x02
 #define JAILHOUSE_CACHE_L3		(JAILHOUSE_CACHE_L3_CODE | \
@@ -152,8 +216,22 @@ struct jailhouse_irqchip {
 
 #define JAILHOUSE_SHMEM_PROTO_UNDEFINED	0x0000
 #define JAILHOUSE_SHMEM_PROTO_VETH	0x0100
+/*
+ * virtio over ivshmem, see Documentation/ivshmem-virtio.md. The lower byte
+ * holds the virtio device ID. A front-end only connects to a back-end of the
+ * same device type.
+ */
+#define JAILHOUSE_SHMEM_PROTO_VIRTIO_FRONT	0x0200	/* 0x02xx */
+#define JAILHOUSE_SHMEM_PROTO_VIRTIO_BACK	0x0300	/* 0x03xx */
 #define JAILHOUSE_SHMEM_PROTO_CUSTOM	0x8000	/* 0x80xx..0xffxx */
 
+/*
+ * A broadcast ivshmem link (shmem_peers != 0) connects one publisher with up
+ * to shmem_peers - 1 subscribers. The publisher is the only peer whose shared
+ * memory region is writable, all subscribers map it read-only.
+ */
+#define JAILHOUSE_SHMEM_MAX_PEERS	16
+
 struct jailhouse_pci_device {
 	__u8 type;
 	__u8 iommu;
@@ -171,7 +249,12 @@ struct jailhouse_pci_device {
 	__u32 shmem_region;
 	/** PCI subclass and interface ID of virtual shared memory device. */
 	__u16 shmem_protocol;
-	__u8 padding[2];
+	/**
+	 * Maximum number of peers of a broadcast shared memory link, publisher
+	 * included, or 0 for a link between two peers.
+	 */
+	__u8 shmem_peers;
+	__u8 padding;
 } __attribute__((packed));
 
 #define JAILHOUSE_PCI_EXT_CAP		0x8000
@@ -246,6 +329,9 @@ struct jailhouse_system {
 				u64 gich_base;
 				u64 gicv_base;
 				u64 gicr_base;
+				/** Way size of the shared last-level cache,
+				 * 0 if cache coloring is not used. */
+				u32 llc_way_size;
 			} __attribute__((packed)) arm;
 		} __attribute__((packed));
 	} __attribute__((packed)) platform_info;
@@ -325,4 +411,101 @@ jailhouse_cell_pci_caps(const struct jailhouse_cell_desc *cell)
 		 cell->num_pci_devices * sizeof(struct jailhouse_pci_device));
 }
 
+static inline unsigned int jailhouse_num_colors(__u32 llc_way_size)
+{
+	return llc_way_size >> JAILHOUSE_COLOR_PAGE_SHIFT;
+}
+
+static inline __u32 jailhouse_mem_colors(const struct jailhouse_memory *mem,
+					 __u32 llc_way_size)
+{
+	unsigned int num_colors = jailhouse_num_colors(llc_way_size);
+	__u32 colors = mem->flags >> JAILHOUSE_MEM_COLORS_SHIFT;
+
+	if (num_colors < JAILHOUSE_MAX_COLORS)
+		colors &= (1U << num_colors) - 1;
+	return colors;
+}
+
+/**
+ * Returns the leaf size requested via JAILHOUSE_MEM_LEAF_*, 0 if the region
+ * may be mapped with any page size and ~0 for invalid requests.
+ */
+static inline __u64 jailhouse_mem_leaf_size(const struct jailhouse_memory *mem)
+{
+	switch (mem->flags & JAILHOUSE_MEM_LEAF_MASK) {
+	case JAILHOUSE_MEM_LEAF_ANY:
+		return 0;
+	case JAILHOUSE_MEM_LEAF_2M:
+		return 2ULL << 20;
+	case JAILHOUSE_MEM_LEAF_1G:
+		return 1ULL << 30;
+	default:
+		return ~0ULL;
+	}
+}
+
+static inline unsigned int jailhouse_colors_weight(__u32 colors)
+{
+	unsigned int weight = 0;
+
+	for (; colors; colors &= colors - 1)
+		weight++;
+	return weight;
+}
+
+/**
+ * Returns the size of the address range a memory region occupies in the
+ * cell's address space. For colored regions, this is only the fraction of the
+ * physical window that matches the region's colors.
+ */
+static inline __u64
+jailhouse_mem_virt_size(const struct jailhouse_memory *mem,
+			__u32 llc_way_size)
+{
+	unsigned int num_colors = jailhouse_num_colors(llc_way_size);
+	unsigned long ways;
+
+	if (!(mem->flags & JAILHOUSE_MEM_COLORED))
+		return mem->size;
+	if (num_colors == 0)
+		return 0;
+
+	ways = (unsigned long)(mem->size >> JAILHOUSE_COLOR_PAGE_SHIFT) /
+		num_colors;
+	return (__u64)ways *
+		jailhouse_colors_weight(jailhouse_mem_colors(mem,
+							     llc_way_size)) <<
+		JAILHOUSE_COLOR_PAGE_SHIFT;
+}
+
+/**
+ * Translates an offset into the cell's view of a colored memory region into
+ * the physical address backing it.
+ */
+static inline __u64
+jailhouse_colored_phys(const struct jailhouse_memory *mem, __u32 llc_way_size,
+		       __u64 offset)
+{
+	unsigned int num_colors = jailhouse_num_colors(llc_way_size);
+	__u32 colors = jailhouse_mem_colors(mem, llc_way_size);
+	unsigned long page = (unsigned long)
+		(offset >> JAILHOUSE_COLOR_PAGE_SHIFT);
+	unsigned int weight = jailhouse_colors_weight(colors);
+	unsigned int color, skip = page % weight;
+	unsigned long way = page / weight;
+
+	for (color = 0; color < num_colors; color++)
+		if (colors & (1U << color)) {
+			if (skip == 0)
+				break;
+			skip--;
+		}
+
+	return mem->phys_start +
+		(((__u64)way * num_colors + color) <<
+		 JAILHOUSE_COLOR_PAGE_SHIFT) +
+		(offset & (JAILHOUSE_COLOR_PAGE_SIZE - 1));
+}
+
 #endif /* !_JAILHOUSE_CELL_CONFIG_H */
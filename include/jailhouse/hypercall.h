@@ -50,17 +50,64 @@
 #define JAILHOUSE_HC_CELL_GET_STATE		6
 #define JAILHOUSE_HC_CPU_GET_INFO		7
 #define JAILHOUSE_HC_DEBUG_CONSOLE_PUTC		8
+#define JAILHOUSE_HC_MSG_REPLY			9
+#define JAILHOUSE_HC_LOCK_BENCH			10
 
 #define ARCEOS_HC_AXVM_CREATE_CFG		0x101
 #define ARCEOS_HC_AXVM_LOAD_IMG			0x102
 #define ARCEOS_HC_AXVM_BOOT             0x103
 
-/* Hypervisor information type */
+/*
+ * Hypervisor information type. A type returns bits 0..30 of the requested
+ * value, the same type ORed with JAILHOUSE_INFO_HIGH_PART returns bits
+ * 31..61. This keeps 64-bit values distinguishable from error codes on
+ * architectures with 32-bit hypercall return values.
+ */
+#define JAILHOUSE_INFO_HIGH_PART		0x80000000
+#define JAILHOUSE_INFO_PART_BITS		31
+
 #define JAILHOUSE_INFO_MEM_POOL_SIZE		0
 #define JAILHOUSE_INFO_MEM_POOL_USED		1
 #define JAILHOUSE_INFO_REMAP_POOL_SIZE		2
 #define JAILHOUSE_INFO_REMAP_POOL_USED		3
 #define JAILHOUSE_INFO_NUM_CELLS		4
+#define JAILHOUSE_INFO_TIMESTAMP_KHZ		5
+/* durations are reported in timestamp counter ticks */
+#define JAILHOUSE_INFO_SUSPEND_COUNT		6
+#define JAILHOUSE_INFO_SUSPEND_SIGNAL_LAST	7
+#define JAILHOUSE_INFO_SUSPEND_WAIT_LAST	8
+#define JAILHOUSE_INFO_SUSPEND_MAX		9
+#define JAILHOUSE_INFO_RESUME_LAST		10
+/*
+ * Lock statistics (CONFIG_JAILHOUSE_LOCK_STAT), one type per lock class and
+ * statistic: JAILHOUSE_INFO_LOCK_STAT_BASE +
+ *            class * JAILHOUSE_NUM_LOCK_STATS + statistic
+ */
+#define JAILHOUSE_INFO_LOCK_STAT_BASE		1000
+
+/* Hypervisor lock classes */
+#define JAILHOUSE_LOCK_OTHER			0
+#define JAILHOUSE_LOCK_PRINTK			1
+#define JAILHOUSE_LOCK_SHUTDOWN			2
+#define JAILHOUSE_LOCK_CPU_CONTROL		3
+#define JAILHOUSE_LOCK_MMIO_REGION		4
+#define JAILHOUSE_LOCK_IVSHMEM_REMOTE		5
+#define JAILHOUSE_LOCK_IOAPIC			6
+#define JAILHOUSE_LOCK_VTD_INV_QUEUE		7
+#define JAILHOUSE_LOCK_PCI			8
+#define JAILHOUSE_LOCK_GIC_DIST			9
+#define JAILHOUSE_NUM_LOCK_CLASSES		10
+
+/* Lock statistics, waiting times are reported in timestamp counter ticks */
+#define JAILHOUSE_LOCK_STAT_ACQUIRED		0
+#define JAILHOUSE_LOCK_STAT_CONTENDED		1
+#define JAILHOUSE_LOCK_STAT_WAIT_MAX		2
+#define JAILHOUSE_LOCK_STAT_WAIT_TOTAL		3
+#define JAILHOUSE_NUM_LOCK_STATS		4
+
+/* Lock types of the lock benchmark */
+#define JAILHOUSE_LOCK_BENCH_TICKET		0
+#define JAILHOUSE_LOCK_BENCH_MCS		1
 
 /* Hypervisor information type */
 #define JAILHOUSE_CPU_INFO_STATE		0
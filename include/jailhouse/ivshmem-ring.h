@@ -0,0 +1,440 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Lock-free message ring for ivshmem shared memory, see
+ * Documentation/ivshmem-ring.md
+ *
+ * A ring consists of fixed-size slots and is written by one or, with
+ * IVSHMEM_RING_MP, several producers and read by a single consumer. Producer
+ * and consumer indices live on separate cache lines. Slots can be filled and
+ * consumed in place, see ivshmem_ring_reserve() and ivshmem_ring_peek().
+ *
+ * The header is self-contained so that both inmates and Linux user space can
+ * use it. The includer has to provide __u8 and __u32, e.g. via linux/types.h.
+ */
+
+#ifndef _JAILHOUSE_IVSHMEM_RING_H
+#define _JAILHOUSE_IVSHMEM_RING_H
+
+#define IVSHMEM_RING_MAGIC		0x474e5249	/* "IRNG" */
+#define IVSHMEM_RING_CACHELINE		64
+
+/* ring flags */
+#define IVSHMEM_RING_MP			0x0001	/* multiple producers */
+
+/* may be overridden, e.g. by sched_yield() for preemptible producers */
+#ifndef ivshmem_ring_cpu_relax
+#if defined(__x86_64__) || defined(__i386__)
+#define ivshmem_ring_cpu_relax()	asm volatile("pause" : : : "memory")
+#elif defined(__aarch64__) || defined(__arm__)
+#define ivshmem_ring_cpu_relax()	asm volatile("yield" : : : "memory")
+#else
+#define ivshmem_ring_cpu_relax()	__atomic_signal_fence(__ATOMIC_SEQ_CST)
+#endif
+#endif
+
+/** Ring state in shared memory, followed by the slots. */
+struct ivshmem_ring_shared {
+	/* set by ivshmem_ring_init(), constant afterwards */
+	__u32 magic;
+	__u32 num_slots;
+	__u32 slot_size;
+	__u32 flags;
+	__u8 __pad0[IVSHMEM_RING_CACHELINE - 16];
+
+	/* written by the producers */
+	/** Next index to be reserved. */
+	__u32 prod_head;
+	/** All slots before this index are published. */
+	__u32 prod_tail;
+	/** Notify the producers when cons_tail moves past this index. */
+	__u32 cons_event;
+	__u8 __pad1[IVSHMEM_RING_CACHELINE - 12];
+
+	/* written by the consumer */
+	/** All slots before this index are consumed. */
+	__u32 cons_tail;
+	/** Notify the consumer when prod_tail moves past this index. */
+	__u32 prod_event;
+	__u8 __pad2[IVSHMEM_RING_CACHELINE - 8];
+} __attribute__((aligned(IVSHMEM_RING_CACHELINE)));
+
+/**
+ * Local handle of a ring. The parameters are validated once and then kept
+ * out of reach of the peer.
+ */
+struct ivshmem_ring {
+	struct ivshmem_ring_shared *shared;
+	__u8 *slots;
+	__u32 mask;
+	__u32 slot_size;
+	__u32 flags;
+};
+
+/**
+ * Return the memory required for a ring.
+ * @param num_slots	Number of slots, a power of 2.
+ * @param slot_size	Size of a slot in bytes.
+ *
+ * @return Size in bytes.
+ */
+static inline unsigned long long ivshmem_ring_mem_size(__u32 num_slots,
+						       __u32 slot_size)
+{
+	return sizeof(struct ivshmem_ring_shared) +
+		(unsigned long long)num_slots * slot_size;
+}
+
+static inline int ivshmem_ring_setup(struct ivshmem_ring *ring, void *mem,
+				     unsigned long long size, __u32 num_slots,
+				     __u32 slot_size, __u32 flags)
+{
+	if ((unsigned long)mem % IVSHMEM_RING_CACHELINE || num_slots == 0 ||
+	    (num_slots & (num_slots - 1)) || slot_size == 0 ||
+	    slot_size % sizeof(__u32) ||
+	    ivshmem_ring_mem_size(num_slots, slot_size) > size)
+		return -1;
+
+	ring->shared = (struct ivshmem_ring_shared *)mem;
+	ring->slots = (__u8 *)mem + sizeof(struct ivshmem_ring_shared);
+	ring->mask = num_slots - 1;
+	ring->slot_size = slot_size;
+	ring->flags = flags;
+	return 0;
+}
+
+/**
+ * Format a ring in shared memory. Called on the side that owns the ring.
+ * @param ring		Handle to initialize.
+ * @param mem		Ring memory, aligned to IVSHMEM_RING_CACHELINE.
+ * @param size		Size of the ring memory.
+ * @param num_slots	Number of slots, a power of 2.
+ * @param slot_size	Size of a slot in bytes, a multiple of 4.
+ * @param flags		Ring flags (IVSHMEM_RING_*).
+ *
+ * @return 0 on success, -1 on invalid parameters.
+ */
+static inline int ivshmem_ring_init(struct ivshmem_ring *ring, void *mem,
+				    unsigned long long size, __u32 num_slots,
+				    __u32 slot_size, __u32 flags)
+{
+	struct ivshmem_ring_shared *shared;
+
+	if (ivshmem_ring_setup(ring, mem, size, num_slots, slot_size, flags))
+		return -1;
+
+	shared = ring->shared;
+	__atomic_store_n(&shared->magic, 0, __ATOMIC_RELAXED);
+	shared->num_slots = num_slots;
+	shared->slot_size = slot_size;
+	shared->flags = flags;
+	shared->prod_head = shared->prod_tail = 0;
+	shared->cons_tail = 0;
+	/* the consumer is notified about the first message */
+	shared->prod_event = 0;
+	/* no producer waits for free slots */
+	shared->cons_event = ~0U;
+	__atomic_store_n(&shared->magic, IVSHMEM_RING_MAGIC, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ * Attach to a ring formatted by ivshmem_ring_init().
+ * @param ring		Handle to initialize.
+ * @param mem		Ring memory.
+ * @param size		Size of the ring memory.
+ *
+ * @return 0 on success, -1 if the ring is not (yet) valid.
+ */
+static inline int ivshmem_ring_attach(struct ivshmem_ring *ring, void *mem,
+				      unsigned long long size)
+{
+	struct ivshmem_ring_shared *shared = (struct ivshmem_ring_shared *)mem;
+
+	if (__atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE) !=
+	    IVSHMEM_RING_MAGIC)
+		return -1;
+	return ivshmem_ring_setup(ring, mem, size, shared->num_slots,
+				  shared->slot_size, shared->flags);
+}
+
+/**
+ * Return a slot of the ring.
+ * @param ring		Ring handle.
+ * @param idx		Free-running slot index.
+ *
+ * @return Pointer to the slot.
+ */
+static inline void *ivshmem_ring_slot(struct ivshmem_ring *ring, __u32 idx)
+{
+	return ring->slots +
+		(unsigned long)(idx & ring->mask) * ring->slot_size;
+}
+
+/* Check if moving an index from old to new_idx passes event. */
+static inline int ivshmem_ring_need_event(__u32 event, __u32 new_idx,
+					  __u32 old)
+{
+	return (__u32)(new_idx - event - 1) < (__u32)(new_idx - old);
+}
+
+/**
+ * Reserve slots for writing them in place.
+ * @param ring		Ring handle.
+ * @param n		Number of slots wanted.
+ * @param idx		Returns the index of the first reserved slot.
+ *
+ * Reserved slots have to be published with ivshmem_ring_commit().
+ *
+ * @return Number of reserved slots, up to n, 0 if the ring is full.
+ */
+static inline __u32 ivshmem_ring_reserve(struct ivshmem_ring *ring, __u32 n,
+					 __u32 *idx)
+{
+	struct ivshmem_ring_shared *shared = ring->shared;
+	__u32 head, used, num;
+
+	head = __atomic_load_n(&shared->prod_head, __ATOMIC_RELAXED);
+	do {
+		/* slots are only reused after the consumer is done with them */
+		used = head - __atomic_load_n(&shared->cons_tail,
+					      __ATOMIC_ACQUIRE);
+		/* a corrupted consumer index leaves no free slot */
+		num = used > ring->mask + 1 ? 0 : ring->mask + 1 - used;
+		if (num > n)
+			num = n;
+		if (num == 0)
+			return 0;
+
+		if (!(ring->flags & IVSHMEM_RING_MP)) {
+			__atomic_store_n(&shared->prod_head, head + num,
+					 __ATOMIC_RELAXED);
+			break;
+		}
+	} while (!__atomic_compare_exchange_n(&shared->prod_head, &head,
+					      head + num, 1, __ATOMIC_RELAXED,
+					      __ATOMIC_RELAXED));
+
+	*idx = head;
+	return num;
+}
+
+/**
+ * Publish reserved slots.
+ * @param ring		Ring handle.
+ * @param idx		Index of the first slot, as returned by
+ * 			ivshmem_ring_reserve().
+ * @param n		Number of slots.
+ *
+ * With multiple producers, slots are published in the order of their
+ * reservation, so a producer may wait for the others here.
+ *
+ * @return Non-zero if the consumer has to be notified.
+ */
+static inline int ivshmem_ring_commit(struct ivshmem_ring *ring, __u32 idx,
+				      __u32 n)
+{
+	struct ivshmem_ring_shared *shared = ring->shared;
+
+	if (ring->flags & IVSHMEM_RING_MP)
+		while (__atomic_load_n(&shared->prod_tail, __ATOMIC_ACQUIRE) !=
+		       idx)
+			ivshmem_ring_cpu_relax();
+
+	__atomic_store_n(&shared->prod_tail, idx + n, __ATOMIC_RELEASE);
+	/* the consumer may arm its event concurrently */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return ivshmem_ring_need_event(__atomic_load_n(&shared->prod_event,
+						       __ATOMIC_RELAXED),
+				       idx + n, idx);
+}
+
+/**
+ * Look at published slots for reading them in place.
+ * @param ring		Ring handle.
+ * @param n		Maximum number of slots.
+ * @param idx		Returns the index of the first slot.
+ *
+ * The slots have to be handed back with ivshmem_ring_release().
+ *
+ * @return Number of available slots, up to n.
+ */
+static inline __u32 ivshmem_ring_peek(struct ivshmem_ring *ring, __u32 n,
+				      __u32 *idx)
+{
+	struct ivshmem_ring_shared *shared = ring->shared;
+	__u32 tail, avail;
+
+	tail = __atomic_load_n(&shared->cons_tail, __ATOMIC_RELAXED);
+	avail = __atomic_load_n(&shared->prod_tail, __ATOMIC_ACQUIRE) - tail;
+	/* a corrupted producer index publishes nothing */
+	if (avail > ring->mask + 1)
+		avail = 0;
+
+	*idx = tail;
+	return avail < n ? avail : n;
+}
+
+/**
+ * Hand consumed slots back to the producers.
+ * @param ring		Ring handle.
+ * @param n		Number of slots, at most as many as peeked.
+ *
+ * @return Non-zero if a producer has to be notified.
+ */
+static inline int ivshmem_ring_release(struct ivshmem_ring *ring, __u32 n)
+{
+	struct ivshmem_ring_shared *shared = ring->shared;
+	__u32 tail = __atomic_load_n(&shared->cons_tail, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&shared->cons_tail, tail + n, __ATOMIC_RELEASE);
+	/* a producer may arm its event concurrently */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return ivshmem_ring_need_event(__atomic_load_n(&shared->cons_event,
+						       __ATOMIC_RELAXED),
+				       tail + n, tail);
+}
+
+/**
+ * Ask for a notification when the next slot is published.
+ * @param ring		Ring handle.
+ *
+ * Notifications are suppressed while the consumer is busy. The consumer arms
+ * them before it goes to sleep.
+ *
+ * @return Non-zero if slots were published meanwhile, i.e. the consumer must
+ * not sleep.
+ */
+static inline int ivshmem_ring_consumer_arm(struct ivshmem_ring *ring)
+{
+	struct ivshmem_ring_shared *shared = ring->shared;
+	__u32 tail = __atomic_load_n(&shared->cons_tail, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&shared->prod_event, tail, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return __atomic_load_n(&shared->prod_tail, __ATOMIC_ACQUIRE) != tail;
+}
+
+/**
+ * Ask for a notification when n slots are free.
+ * @param ring		Ring handle.
+ * @param n		Number of slots the producer waits for.
+ *
+ * @return Non-zero if the slots became free meanwhile.
+ */
+static inline int ivshmem_ring_producer_arm(struct ivshmem_ring *ring,
+					    __u32 n)
+{
+	struct ivshmem_ring_shared *shared = ring->shared;
+	__u32 head = __atomic_load_n(&shared->prod_head, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&shared->cons_event, head - (ring->mask + 1) + n - 1,
+			 __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return head - __atomic_load_n(&shared->cons_tail, __ATOMIC_ACQUIRE) <=
+		ring->mask + 1 - n;
+}
+
+/**
+ * Copy messages into the ring.
+ * @param ring		Ring handle.
+ * @param msgs		Array of messages of the ring's slot size.
+ * @param n		Number of messages.
+ * @param notify	Set to non-zero if the consumer has to be notified.
+ *
+ * @return Number of enqueued messages, less than n if the ring is full.
+ */
+static inline __u32 ivshmem_ring_enqueue_burst(struct ivshmem_ring *ring,
+					       const void *msgs, __u32 n,
+					       int *notify)
+{
+	__u32 idx, num, first;
+
+	num = ivshmem_ring_reserve(ring, n, &idx);
+	if (num == 0)
+		return 0;
+
+	/* at most two copies, split where the ring wraps */
+	first = ring->mask + 1 - (idx & ring->mask);
+	if (first > num)
+		first = num;
+	__builtin_memcpy(ivshmem_ring_slot(ring, idx), msgs,
+			 (unsigned long)first * ring->slot_size);
+	__builtin_memcpy(ring->slots,
+			 (const __u8 *)msgs + first * ring->slot_size,
+			 (unsigned long)(num - first) * ring->slot_size);
+
+	if (ivshmem_ring_commit(ring, idx, num))
+		*notify = 1;
+	return num;
+}
+
+/**
+ * Copy messages out of the ring.
+ * @param ring		Ring handle.
+ * @param msgs		Array for messages of the ring's slot size.
+ * @param n		Maximum number of messages.
+ * @param notify	Set to non-zero if a producer has to be notified.
+ *
+ * @return Number of dequeued messages.
+ */
+static inline __u32 ivshmem_ring_dequeue_burst(struct ivshmem_ring *ring,
+					       void *msgs, __u32 n,
+					       int *notify)
+{
+	__u32 idx, num, first;
+
+	num = ivshmem_ring_peek(ring, n, &idx);
+	if (num == 0)
+		return 0;
+
+	first = ring->mask + 1 - (idx & ring->mask);
+	if (first > num)
+		first = num;
+	__builtin_memcpy(msgs, ivshmem_ring_slot(ring, idx),
+			 (unsigned long)first * ring->slot_size);
+	__builtin_memcpy((__u8 *)msgs + first * ring->slot_size, ring->slots,
+			 (unsigned long)(num - first) * ring->slot_size);
+
+	if (ivshmem_ring_release(ring, num))
+		*notify = 1;
+	return num;
+}
+
+#endif /* !_JAILHOUSE_IVSHMEM_RING_H */
@@ -0,0 +1,217 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * virtio transport over an ivshmem device, see Documentation/ivshmem-virtio.md
+ *
+ * The shared memory starts with struct virtio_ivshmem_header, initialized by
+ * the back-end. The front-end places its virtqueues and all buffers behind
+ * the header. Addresses in virtqueues are offsets into the shared memory.
+ */
+
+#ifndef _JAILHOUSE_VIRTIO_IVSHMEM_H
+#define _JAILHOUSE_VIRTIO_IVSHMEM_H
+
+#define VIRTIO_IVSHMEM_MAGIC		0x53564956	/* "VIVS" */
+#define VIRTIO_IVSHMEM_REVISION		1
+
+#define VIRTIO_IVSHMEM_MAX_QUEUES	2
+#define VIRTIO_IVSHMEM_CONFIG_SIZE	256
+/* start of the front-end area */
+#define VIRTIO_IVSHMEM_HEADER_SIZE	0x1000
+
+/*
+ * ivshmem LSTATE values. The back-end reports READY only while it has no
+ * active session, i.e. after it acknowledged a front-end reset.
+ */
+#define VIRTIO_IVSHMEM_STATE_RESET	0
+#define VIRTIO_IVSHMEM_STATE_READY	1
+#define VIRTIO_IVSHMEM_STATE_ACTIVE	2	/* back-end only */
+
+/* virtio device IDs */
+#define VIRTIO_ID_NET			1
+#define VIRTIO_ID_BLOCK			2
+
+/* device status, written by the front-end */
+#define VIRTIO_CONFIG_S_ACKNOWLEDGE	0x01
+#define VIRTIO_CONFIG_S_DRIVER		0x02
+#define VIRTIO_CONFIG_S_DRIVER_OK	0x04
+#define VIRTIO_CONFIG_S_FEATURES_OK	0x08
+#define VIRTIO_CONFIG_S_NEEDS_RESET	0x40
+#define VIRTIO_CONFIG_S_FAILED		0x80
+
+/* feature bits */
+#define VIRTIO_BLK_F_RO			5
+#define VIRTIO_BLK_F_FLUSH		9
+#define VIRTIO_NET_F_MAC		5
+#define VIRTIO_NET_F_STATUS		16
+#define VIRTIO_RING_F_EVENT_IDX		29
+#define VIRTIO_F_VERSION_1		32
+
+struct virtio_ivshmem_queue {
+	/** Number of descriptors, a power of 2, set by the front-end. */
+	__u16 size;
+	/** Set to 1 by the front-end when the rings are set up. */
+	__u16 ready;
+	__u32 padding;
+	/** Offsets of the rings in the shared memory. */
+	__u64 desc;
+	__u64 avail;
+	__u64 used;
+};
+
+struct virtio_ivshmem_header {
+	/** VIRTIO_IVSHMEM_MAGIC, set by the back-end. */
+	__u32 magic;
+	__u32 revision;
+	/** VIRTIO_ID_*, set by the back-end. */
+	__u32 device_id;
+	/** VIRTIO_CONFIG_S_*, set by the front-end. */
+	__u32 device_status;
+	/** Features offered by the back-end. */
+	__u64 device_features;
+	/** Features accepted by the front-end. */
+	__u64 driver_features;
+	__u16 num_queues;
+	__u16 queue_size_max;
+	/** Incremented by the back-end on changes of the device config. */
+	__u32 config_generation;
+	struct virtio_ivshmem_queue queues[VIRTIO_IVSHMEM_MAX_QUEUES];
+	/** Device-specific configuration, e.g. struct virtio_blk_config. */
+	__u8 config[VIRTIO_IVSHMEM_CONFIG_SIZE];
+};
+
+/* split virtqueue */
+#define VRING_DESC_F_NEXT		1
+#define VRING_DESC_F_WRITE		2
+
+#define VRING_AVAIL_F_NO_INTERRUPT	1
+#define VRING_USED_F_NO_NOTIFY		1
+
+struct vring_desc {
+	__u64 addr;
+	__u32 len;
+	__u16 flags;
+	__u16 next;
+};
+
+struct vring_avail {
+	__u16 flags;
+	__u16 idx;
+	/* followed by used_event with VIRTIO_RING_F_EVENT_IDX */
+	__u16 ring[];
+};
+
+struct vring_used_elem {
+	__u32 id;
+	__u32 len;
+};
+
+struct vring_used {
+	__u16 flags;
+	__u16 idx;
+	/* followed by avail_event with VIRTIO_RING_F_EVENT_IDX */
+	struct vring_used_elem ring[];
+};
+
+#define VRING_DESC_SIZE(num)	(16 * (num))
+#define VRING_AVAIL_SIZE(num)	(6 + 2 * (num))
+#define VRING_USED_SIZE(num)	(6 + 8 * (num))
+
+static inline volatile __u16 *
+vring_used_event(volatile struct vring_avail *avail, unsigned int num)
+{
+	return &avail->ring[num];
+}
+
+static inline volatile __u16 *
+vring_avail_event(volatile struct vring_used *used, unsigned int num)
+{
+	return (volatile __u16 *)&used->ring[num];
+}
+
+/*
+ * Check if the other side asked for a notification when the index moved from
+ * old to new_idx.
+ */
+static inline int vring_need_event(__u16 event_idx, __u16 new_idx, __u16 old)
+{
+	return (__u16)(new_idx - event_idx - 1) < (__u16)(new_idx - old);
+}
+
+/* virtio block device */
+#define VIRTIO_BLK_SECTOR_SIZE		512
+
+#define VIRTIO_BLK_T_IN			0
+#define VIRTIO_BLK_T_OUT		1
+#define VIRTIO_BLK_T_FLUSH		4
+
+#define VIRTIO_BLK_S_OK			0
+#define VIRTIO_BLK_S_IOERR		1
+#define VIRTIO_BLK_S_UNSUPP		2
+
+struct virtio_blk_config {
+	/** Capacity in sectors of VIRTIO_BLK_SECTOR_SIZE. */
+	__u64 capacity;
+};
+
+/* request header, followed by the data and a status byte */
+struct virtio_blk_req_hdr {
+	__u32 type;
+	__u32 ioprio;
+	__u64 sector;
+};
+
+/* virtio network device */
+#define VIRTIO_NET_QUEUE_RX		0
+#define VIRTIO_NET_QUEUE_TX		1
+
+#define VIRTIO_NET_S_LINK_UP		1
+
+struct virtio_net_config {
+	__u8 mac[6];
+	__u16 status;
+};
+
+/* precedes each packet */
+struct virtio_net_hdr {
+	__u8 flags;
+	__u8 gso_type;
+	__u16 hdr_len;
+	__u16 gso_size;
+	__u16 csum_start;
+	__u16 csum_offset;
+	__u16 num_buffers;
+};
+
+#endif /* !_JAILHOUSE_VIRTIO_IVSHMEM_H */
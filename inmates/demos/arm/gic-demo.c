@@ -50,8 +50,8 @@ static void handle_IRQ(unsigned int irqn)
 	if (led_reg)
 		mmio_write32(led_reg, mmio_read32(led_reg) ^ (1 << led_pin));
 
-	expected_ticks = timer_get_ticks() + ticks_per_beat;
-	timer_start(ticks_per_beat);
+	expected_ticks += ticks_per_beat;
+	timer_start_at(expected_ticks);
 }
 
 void inmate_main(void)
@@ -63,7 +63,7 @@ void inmate_main(void)
 	printk("Initializing the timer...\n");
 	ticks_per_beat = timer_get_frequency() / BEATS_PER_SEC;
 	expected_ticks = timer_get_ticks() + ticks_per_beat;
-	timer_start(ticks_per_beat);
+	timer_start_at(expected_ticks);
 
 	led_reg = (void *)(unsigned long)cmdline_parse_int("led-reg", 0);
 	led_pin = cmdline_parse_int("led-pin", 0);
@@ -141,7 +141,8 @@ void inmate_main(void)
 			if (!allow_terminate) {
 				printk("Rejecting first shutdown request - "
 				       "try again!\n");
-				jailhouse_send_reply_from_cell(comm_region,
+				/* reply via hypercall, no polling needed */
+				jailhouse_call_arg1(JAILHOUSE_HC_MSG_REPLY,
 						JAILHOUSE_MSG_REQUEST_DENIED);
 				allow_terminate = true;
 			} else
@@ -0,0 +1,142 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Publishes telemetry samples over a broadcast ivshmem link, or subscribes
+ * to them, see Documentation/inter-cell-communication.txt. The cell with the
+ * writable shared memory region is the publisher. It updates a sample every
+ * "interval_ms" (default 1000) milliseconds and notifies all subscribers with
+ * a single doorbell write. Subscribers wait for that doorbell and print the
+ * latest sample. Samples carry the raw TSC value, which is a common time base
+ * for all cells, unlike the per-cell result of tsc_read().
+ */
+
+#include <inmate.h>
+#include <ivshmem.h>
+#include <jailhouse/cell-config.h>
+
+#define IRQ_VECTOR		32
+
+#define DEFAULT_INTERVAL_MS	1000
+
+/* written by the publisher only, protected by a sequence count */
+struct sample {
+	u32 seq;
+	u32 publisher_cpu;
+	u64 count;
+	u64 tsc;
+};
+
+static volatile unsigned int doorbells;
+static unsigned long tsc_freq;
+
+static inline u64 read_tsc(void)
+{
+	u32 lo, hi;
+
+	asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return (u64)lo | ((u64)hi << 32);
+}
+
+static void irq_handler(void)
+{
+	doorbells++;
+}
+
+static void publish(struct ivshmem_device *dev)
+{
+	volatile struct sample *sample = dev->shmem;
+	unsigned long interval = cmdline_parse_int("interval_ms",
+						   DEFAULT_INTERVAL_MS);
+	u32 subscribers = 0, ready;
+	u64 count = 0;
+
+	printk("Publishing every %lu ms\n", interval);
+	ivshmem_set_state(dev, 1);
+
+	while (true) {
+		/* odd sequence counts mark an update in progress */
+		sample->seq++;
+		memory_barrier();
+		sample->publisher_cpu = cpu_id();
+		sample->count = ++count;
+		sample->tsc = read_tsc();
+		memory_barrier();
+		sample->seq++;
+
+		/* a single write notifies all subscribers */
+		ivshmem_notify(dev);
+
+		ready = ivshmem_remote_state(dev);
+		if (ready != subscribers) {
+			printk("Ready subscribers: 0x%x\n", ready);
+			subscribers = ready;
+		}
+
+		delay_us(interval * 1000);
+	}
+}
+
+static void subscribe(struct ivshmem_device *dev)
+{
+	volatile struct sample *sample = dev->shmem;
+	unsigned int handled = 0;
+	u64 count, tsc, now;
+	u32 seq;
+
+	printk("Subscribed at position %u\n", dev->id);
+	ivshmem_set_state(dev, 1);
+
+	while (true) {
+		asm volatile("cli" : : : "memory");
+		if (doorbells == handled)
+			asm volatile("sti; hlt" : : : "memory");
+		else
+			asm volatile("sti" : : : "memory");
+		handled = doorbells;
+
+		if (ivshmem_remote_state(dev) == 0) {
+			printk("Waiting for publisher\n");
+			continue;
+		}
+
+		do {
+			seq = sample->seq;
+			memory_barrier();
+			count = sample->count;
+			tsc = sample->tsc;
+			memory_barrier();
+		} while ((seq & 1) || seq != sample->seq);
+
+		now = read_tsc();
+		printk("Sample #%llu, published %llu ns ago\n", count,
+		       now > tsc ?
+		       (now - tsc) * 1000 / (tsc_freq / 1000000) : 0);
+	}
+}
+
+void inmate_main(void)
+{
+	struct ivshmem_device dev;
+	int bdf;
+
+	tsc_freq = tsc_init();
+	int_init();
+	int_set_handler(IRQ_VECTOR, irq_handler);
+
+	bdf = ivshmem_find_device(JAILHOUSE_SHMEM_PROTO_UNDEFINED, 0);
+	if (bdf < 0 || !ivshmem_setup(&dev, bdf, IRQ_VECTOR) ||
+	    dev.shmem_size < sizeof(struct sample)) {
+		printk("No usable ivshmem device found\n");
+		stop();
+	}
+	printk("Found device %02x:%02x.%x\n", bdf >> 8, (bdf >> 3) & 0x1f,
+	       bdf & 0x7);
+
+	if (dev.id == 0)
+		publish(&dev);
+	else
+		subscribe(&dev);
+}
@@ -0,0 +1,140 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Drives a virtio block or network device that is served over ivshmem by
+ * jailhouse-virtio-backend in the root cell.
+ *
+ * block: dumps the start of the first sector and, unless the device is
+ *        read-only, writes and verifies a pattern in the last sector.
+ * net:   broadcasts a frame once per second and reports received frames.
+ */
+
+#include <inmate.h>
+#include <virtio.h>
+
+#define QUEUE_SIZE		64
+#define TEST_PATTERN		0x5a
+
+static u8 buffer[VIRTIO_NET_MAX_FRAME] __attribute__((aligned(8)));
+
+static void run_block(struct virtio_device *vdev)
+{
+	u64 last = virtio_blk_capacity(vdev) - 1;
+	unsigned int n;
+
+	if (!virtio_blk_init(vdev)) {
+		printk("Block device setup failed\n");
+		return;
+	}
+	printk("Block device: %llu sectors%s\n", last + 1,
+	       virtio_has_feature(vdev, VIRTIO_BLK_F_RO) ? ", read-only" : "");
+
+	if (virtio_blk_read(vdev, 0, buffer, 1)) {
+		printk("Reading sector 0 failed\n");
+		return;
+	}
+	printk("Sector 0:");
+	for (n = 0; n < 16; n++)
+		printk(" %02x", buffer[n]);
+	printk("\n");
+
+	if (virtio_has_feature(vdev, VIRTIO_BLK_F_RO))
+		return;
+
+	memset(buffer, TEST_PATTERN, VIRTIO_BLK_SECTOR_SIZE);
+	if (virtio_blk_write(vdev, last, buffer, 1) ||
+	    virtio_blk_flush(vdev)) {
+		printk("Writing sector %llu failed\n", last);
+		return;
+	}
+	memset(buffer, 0, VIRTIO_BLK_SECTOR_SIZE);
+	if (virtio_blk_read(vdev, last, buffer, 1)) {
+		printk("Reading sector %llu failed\n", last);
+		return;
+	}
+	for (n = 0; n < VIRTIO_BLK_SECTOR_SIZE; n++)
+		if (buffer[n] != TEST_PATTERN) {
+			printk("Verification of sector %llu failed\n", last);
+			return;
+		}
+	printk("Sector %llu written and verified\n", last);
+}
+
+static void run_net(struct virtio_device *vdev)
+{
+	unsigned long next_send = 0;
+	unsigned int received = 0;
+	u8 mac[6];
+	int len;
+
+	if (!virtio_net_init(vdev)) {
+		printk("Network device setup failed\n");
+		return;
+	}
+	virtio_net_get_mac(vdev, mac);
+	printk("Network device: MAC %02x:%02x:%02x:%02x:%02x:%02x\n",
+	       mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+	while (true) {
+		if (tsc_read() >= next_send) {
+			/* broadcast frame with local experimental ethertype */
+			memset(buffer, 0xff, 6);
+			memcpy(buffer + 6, mac, 6);
+			buffer[12] = 0x88;
+			buffer[13] = 0xb5;
+			memset(buffer + 14, 0, 46);
+			if (virtio_net_send(vdev, buffer, 60) == 0)
+				virtio_net_flush(vdev);
+			next_send = tsc_read() + NS_PER_SEC;
+		}
+
+		len = virtio_net_receive(vdev, buffer, sizeof(buffer));
+		if (len >= 14) {
+			received++;
+			printk("Received frame %u: %d bytes from "
+			       "%02x:%02x:%02x:%02x:%02x:%02x\n", received, len,
+			       buffer[6], buffer[7], buffer[8], buffer[9],
+			       buffer[10], buffer[11]);
+		} else {
+			cpu_relax();
+		}
+	}
+}
+
+void inmate_main(void)
+{
+	struct virtio_device vdev;
+	u64 features;
+	int bdf;
+
+	tsc_init();
+
+	bdf = virtio_find_device(VIRTIO_ID_BLOCK, 0);
+	features = (1ULL << VIRTIO_BLK_F_RO) | (1ULL << VIRTIO_BLK_F_FLUSH);
+	if (bdf < 0) {
+		bdf = virtio_find_device(VIRTIO_ID_NET, 0);
+		features = (1ULL << VIRTIO_NET_F_MAC) |
+			(1ULL << VIRTIO_NET_F_STATUS);
+	}
+	if (bdf < 0) {
+		printk("No virtio device found\n");
+		stop();
+	}
+
+	printk("Waiting for virtio back-end of device %02x:%02x.%x\n",
+	       bdf >> 8, (bdf >> 3) & 0x1f, bdf & 0x7);
+	if (!virtio_init(&vdev, bdf, features, QUEUE_SIZE, 0)) {
+		printk("virtio setup failed\n");
+		stop();
+	}
+
+	if (vdev.device_id == VIRTIO_ID_BLOCK)
+		run_block(&vdev);
+	else
+		run_net(&vdev);
+
+	stop();
+}
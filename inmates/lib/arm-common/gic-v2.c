@@ -44,6 +44,8 @@
 #define GICC_EOIR		0x0010
 #define GICD_CTLR		0x0000
 #define  GICD_CTLR_ENABLE	(1 << 0)
+#define GICD_SGIR		0x0f00
+#define  GICD_SGIR_TARGET_SELF	(2 << 24)
 
 #define GICC_CTLR_GRPEN1	(1 << 0)
 
@@ -83,9 +85,15 @@ static u32 gic_v2_read_ack(void)
 	return mmio_read32(gicc_v2_base + GICC_IAR) & 0x3ff;
 }
 
+static void gic_v2_send_sgi_self(unsigned int irqn)
+{
+	mmio_write32(gicd_v2_base + GICD_SGIR, GICD_SGIR_TARGET_SELF | irqn);
+}
+
 const struct gic gic_v2 = {
 	.init = gic_v2_init,
 	.enable = gic_v2_enable,
 	.write_eoi = gic_v2_write_eoi,
 	.read_ack = gic_v2_read_ack,
+	.send_sgi_self = gic_v2_send_sgi_self,
 };
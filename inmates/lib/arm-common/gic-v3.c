@@ -41,6 +41,7 @@
 
 static void *gicd_v3_base;
 static void *gicr_v3_base;
+static u64 sgi_self_target;
 
 #define GICR_TYPER              0x0008
 #define GICR_TYPER_Last         (1 << 4)
@@ -101,6 +102,11 @@ static int gic_v3_init(void)
 
 	gicr_v3_base = gicr;
 
+	sgi_self_target = (u64)MPIDR_AFFINITY_LEVEL(mpidr, 3) << 48 |
+		(u64)MPIDR_AFFINITY_LEVEL(mpidr, 2) << 32 |
+		MPIDR_AFFINITY_LEVEL(mpidr, 1) << 16 |
+		1 << MPIDR_AFFINITY_LEVEL(mpidr, 0);
+
 	arm_write_sysreg(ICC_CTLR_EL1, 0);
 	arm_write_sysreg(ICC_PMR_EL1, 0xf0);
 	arm_write_sysreg(ICC_IGRPEN1_EL1, ICC_IGRPEN1_EN);
@@ -121,9 +127,15 @@ static u32 gic_v3_read_ack(void)
 	return val & 0xffffff;
 }
 
+static void gic_v3_send_sgi_self(unsigned int irqn)
+{
+	arm_write_sysreg(ICC_SGI1R_EL1, sgi_self_target | (u64)irqn << 24);
+}
+
 const struct gic gic_v3 = {
 	.init = gic_v3_init,
 	.enable = gic_v3_enable,
 	.write_eoi = gic_v3_write_eoi,
 	.read_ack = gic_v3_read_ack,
+	.send_sgi_self = gic_v3_send_sgi_self,
 };
@@ -78,3 +78,9 @@ void gic_enable_irq(unsigned int irq)
 {
 	gic->enable(irq);
 }
+
+/* Raises the given SGI on the calling CPU. */
+void gic_send_sgi_self(unsigned int irq)
+{
+	gic->send_sgi_self(irq);
+}
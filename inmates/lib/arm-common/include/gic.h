@@ -55,6 +55,7 @@ struct gic {
 	void (*enable)(unsigned int irqn);
 	void (*write_eoi)(u32 irqn);
 	u32 (*read_ack)(void);
+	void (*send_sgi_self)(unsigned int irqn);
 };
 
 #endif /* !__ASSEMBLY__ */
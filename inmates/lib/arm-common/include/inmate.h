@@ -98,11 +98,14 @@ static inline void __attribute__((noreturn)) halt(void)
 typedef void (*irq_handler_t)(unsigned int);
 void gic_setup(irq_handler_t handler);
 void gic_enable_irq(unsigned int irq);
+void gic_send_sgi_self(unsigned int irq);
 
 unsigned long timer_get_frequency(void);
 u64 timer_get_ticks(void);
 u64 timer_ticks_to_ns(u64 ticks);
 void timer_start(u64 timeout);
+void timer_start_at(u64 deadline);
+void timer_stop(void);
 
 void arch_mmu_enable(void);
 
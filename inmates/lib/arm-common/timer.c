@@ -49,12 +49,16 @@ unsigned long timer_get_frequency(void)
 	return freq;
 }
 
+/*
+ * Returns the count the virtual timer compares against. It equals the
+ * physical count as the hypervisor clears the virtual offset.
+ */
 u64 timer_get_ticks(void)
 {
-	u64 pct64;
+	u64 vct64;
 
-	arm_read_sysreg(CNTPCT_EL0, pct64);
-	return pct64;
+	arm_read_sysreg(CNTVCT_EL0, vct64);
+	return vct64;
 }
 
 static unsigned long emul_division(u64 val, u64 div)
@@ -79,3 +83,20 @@ void timer_start(u64 timeout)
 	arm_write_sysreg(CNTV_TVAL_EL0, timeout);
 	arm_write_sysreg(CNTV_CTL_EL0, 1);
 }
+
+/*
+ * Programs an absolute deadline in timer_get_ticks() units. Periodic loops
+ * should advance the previous deadline instead of calling timer_start from
+ * the handler so that the handler latency does not accumulate.
+ */
+void timer_start_at(u64 deadline)
+{
+	arm_write_sysreg(CNTV_CVAL_EL0, deadline);
+	arm_write_sysreg(CNTV_CTL_EL0, 1);
+}
+
+/* Disables the timer, e.g. while idling without pending deadlines. */
+void timer_stop(void)
+{
+	arm_write_sysreg(CNTV_CTL_EL0, 0);
+}
@@ -43,7 +43,11 @@
 #define CNTFRQ_EL0	SYSREG_32(0, c14, c0, 0)
 #define CNTV_TVAL_EL0	SYSREG_32(0, c14, c3, 0)
 #define CNTV_CTL_EL0	SYSREG_32(0, c14, c3, 1)
+#define CNTV_CVAL_EL0	SYSREG_64(3, c14)
 #define CNTPCT_EL0	SYSREG_64(0, c14)
+#define CNTVCT_EL0	SYSREG_64(1, c14)
+
+#define ICC_SGI1R_EL1	SYSREG_64(0, c12)
 
 #define SCTLR		SYSREG_32(0, c1, c0, 0)
 #define  SCTLR_RR	(1 << 14)
@@ -108,6 +112,9 @@ asm(".arch_extension virt\n");
 #define arm_read_sysreg_64(op1, crm, val) \
 	asm volatile ("mrrc	p15, "#op1", %Q0, %R0, "#crm"\n" \
 			: "=r"((u64)(val)))
+#define arm_write_sysreg_64(op1, crm, val) \
+	asm volatile ("mcrr	p15, "#op1", %Q0, %R0, "#crm"\n" \
+			: : "r"((u64)(val)))
 
 #else /* __ASSEMBLY__ */
 
@@ -88,6 +88,8 @@
 
 #define SYSREG_32(op1, crn, crm, op2)	s3_##op1 ##_##crn ##_##crm ##_##op2
 
+#define ICC_SGI1R_EL1		SYSREG_32(0, c12, c11, 5)
+
 #define arm_write_sysreg(sysreg, val) \
 	asm volatile ("msr	"__stringify(sysreg)", %0\n" : : "r"((u64)(val)))
 
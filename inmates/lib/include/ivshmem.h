@@ -0,0 +1,91 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _IVSHMEM_H
+#define _IVSHMEM_H
+
+#include <jailhouse/ivshmem-ring.h>
+
+#define IVSHMEM_REG_IVPOS	8
+#define IVSHMEM_REG_DBELL	12
+#define IVSHMEM_REG_LSTATE	16
+#define IVSHMEM_REG_RSTATE	20
+
+struct ivshmem_device {
+	u16 bdf;
+	/**
+	 * Position of this peer, 0 or 1. On broadcast links, the publisher has
+	 * position 0 and the subscribers start at 1.
+	 */
+	u32 id;
+	void *registers;
+	void *shmem;
+	u64 shmem_size;
+};
+
+/**
+ * Bidirectional message channel over an ivshmem device. Each peer owns the
+ * ring in its half of the shared memory and sends through it.
+ */
+struct ivshmem_channel {
+	struct ivshmem_device dev;
+	struct ivshmem_ring tx;
+	struct ivshmem_ring rx;
+};
+
+int ivshmem_find_device(u16 protocol, u16 start_bdf);
+bool ivshmem_setup(struct ivshmem_device *dev, u16 bdf, unsigned int vector);
+
+bool ivshmem_channel_init(struct ivshmem_channel *chan, u16 bdf,
+			  unsigned int vector, u32 slot_size, u32 flags);
+unsigned int ivshmem_channel_send(struct ivshmem_channel *chan,
+				  const void *msgs, unsigned int num);
+unsigned int ivshmem_channel_receive(struct ivshmem_channel *chan,
+				     void *msgs, unsigned int num);
+
+static inline void ivshmem_notify(struct ivshmem_device *dev)
+{
+	mmio_write32(dev->registers + IVSHMEM_REG_DBELL, 1);
+}
+
+static inline void ivshmem_set_state(struct ivshmem_device *dev, u32 state)
+{
+	mmio_write32(dev->registers + IVSHMEM_REG_LSTATE, state);
+}
+
+static inline u32 ivshmem_remote_state(struct ivshmem_device *dev)
+{
+	return mmio_read32(dev->registers + IVSHMEM_REG_RSTATE);
+}
+
+#endif /* !_IVSHMEM_H */
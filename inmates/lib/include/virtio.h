@@ -0,0 +1,113 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _VIRTIO_H
+#define _VIRTIO_H
+
+#include <ivshmem.h>
+#include <jailhouse/virtio-ivshmem.h>
+
+/* largest Ethernet frame without FCS, including a VLAN tag */
+#define VIRTIO_NET_MAX_FRAME	1518
+
+struct virtqueue {
+	u16 size;
+	u16 num_free;
+	u16 free_head;
+	/** Next index to publish in the available ring. */
+	u16 avail_idx;
+	/** Available index at the last notification of the back-end. */
+	u16 kicked_idx;
+	/** Next entry of the used ring to consume. */
+	u16 last_used_idx;
+	struct vring_desc *desc;
+	struct vring_avail *avail;
+	struct vring_used *used;
+};
+
+struct virtio_buffer {
+	void *addr;
+	u32 len;
+	/** True if the back-end writes into the buffer. */
+	bool writable;
+};
+
+struct virtio_device {
+	struct ivshmem_device ivshmem;
+	struct virtio_ivshmem_header *header;
+	u32 device_id;
+	/** Negotiated features. */
+	u64 features;
+	/** Offset of the next free byte in the shared memory. */
+	unsigned long shmem_pos;
+	unsigned int num_queues;
+	struct virtqueue queues[VIRTIO_IVSHMEM_MAX_QUEUES];
+	/** Per-device buffers of the block and network helpers. */
+	void *priv;
+};
+
+int virtio_find_device(u32 device_id, u16 start_bdf);
+bool virtio_init(struct virtio_device *vdev, u16 bdf, u64 features,
+		 unsigned int queue_size, unsigned int vector);
+void *virtio_alloc(struct virtio_device *vdev, unsigned long size,
+		   unsigned long align);
+
+static inline bool virtio_has_feature(struct virtio_device *vdev,
+				      unsigned int feature)
+{
+	return !!(vdev->features & (1ULL << feature));
+}
+
+int virtqueue_add(struct virtqueue *vq, struct virtio_device *vdev,
+		  const struct virtio_buffer *bufs, unsigned int num);
+void virtqueue_kick(struct virtqueue *vq, struct virtio_device *vdev);
+int virtqueue_get_used(struct virtqueue *vq, struct virtio_device *vdev,
+		       u32 *len);
+
+bool virtio_blk_init(struct virtio_device *vdev);
+u64 virtio_blk_capacity(struct virtio_device *vdev);
+int virtio_blk_read(struct virtio_device *vdev, u64 sector, void *buf,
+		    unsigned int sectors);
+int virtio_blk_write(struct virtio_device *vdev, u64 sector, const void *buf,
+		     unsigned int sectors);
+int virtio_blk_flush(struct virtio_device *vdev);
+
+bool virtio_net_init(struct virtio_device *vdev);
+void virtio_net_get_mac(struct virtio_device *vdev, u8 mac[6]);
+int virtio_net_send(struct virtio_device *vdev, const void *frame,
+		    unsigned int len);
+void virtio_net_flush(struct virtio_device *vdev);
+int virtio_net_receive(struct virtio_device *vdev, void *frame,
+		       unsigned int size);
+
+#endif /* !_VIRTIO_H */
@@ -0,0 +1,200 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <inmate.h>
+#include <ivshmem.h>
+
+#define IVSHMEM_VENDOR_ID	0x1af4
+#define IVSHMEM_DEVICE_ID	0x1110
+
+#define IVSHMEM_CFG_SHMEM_PTR	0x40
+#define IVSHMEM_CFG_SHMEM_SZ	0x48
+
+#define PCI_CFG_CLASS_REV	0x08
+
+static u64 pci_cfg_read64(u16 bdf, unsigned int addr)
+{
+	return ((u64)pci_read_config(bdf, addr + 4, 4) << 32) |
+		pci_read_config(bdf, addr, 4);
+}
+
+static void pci_cfg_write64(u16 bdf, unsigned int addr, u64 val)
+{
+	pci_write_config(bdf, addr + 4, (u32)(val >> 32), 4);
+	pci_write_config(bdf, addr, (u32)val, 4);
+}
+
+/**
+ * Look up an ivshmem device.
+ * @param protocol	Shared memory protocol (JAILHOUSE_SHMEM_PROTO_*).
+ * @param start_bdf	First BDF to consider.
+ *
+ * @return BDF of the device or -1 if none was found.
+ */
+int ivshmem_find_device(u16 protocol, u16 start_bdf)
+{
+	int bdf = start_bdf;
+
+	while ((bdf = pci_find_device(IVSHMEM_VENDOR_ID, IVSHMEM_DEVICE_ID,
+				      bdf)) >= 0) {
+		if (((pci_read_config(bdf, PCI_CFG_CLASS_REV, 4) >> 8) &
+		     0xffff) == protocol)
+			return bdf;
+		bdf++;
+	}
+	return -1;
+}
+
+/**
+ * Map the shared memory and the registers of an ivshmem device.
+ * @param dev		Device structure to fill.
+ * @param bdf		BDF of the device.
+ * @param vector	Interrupt vector for doorbells of the peer, 0 for none.
+ *
+ * The shared memory is mapped cached. The registers are placed behind it,
+ * starting at the next huge page so that they can be mapped uncached.
+ *
+ * @return True on success.
+ */
+bool ivshmem_setup(struct ivshmem_device *dev, u16 bdf, unsigned int vector)
+{
+	if (pci_find_cap(bdf, PCI_CAP_MSIX) < 0)
+		return false;
+
+	dev->bdf = bdf;
+	dev->shmem = (void *)pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_PTR);
+	dev->shmem_size = pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_SZ);
+	map_range(dev->shmem, dev->shmem_size, MAP_CACHED);
+
+	dev->registers = (void *)(((unsigned long)dev->shmem +
+				   dev->shmem_size + HUGE_PAGE_SIZE - 1) &
+				  HUGE_PAGE_MASK);
+	pci_cfg_write64(bdf, PCI_CFG_BAR, (unsigned long)dev->registers);
+	pci_cfg_write64(bdf, PCI_CFG_BAR + 16,
+			(unsigned long)dev->registers + PAGE_SIZE);
+	pci_write_config(bdf, PCI_CFG_COMMAND, PCI_CMD_MEM | PCI_CMD_MASTER,
+			 2);
+	map_range(dev->registers, 2 * PAGE_SIZE, MAP_UNCACHED);
+
+	if (vector)
+		pci_msix_set_vector(bdf, vector, 0);
+
+	dev->id = mmio_read32(dev->registers + IVSHMEM_REG_IVPOS);
+
+	return true;
+}
+
+/**
+ * Set up a message channel to the peer of an ivshmem device.
+ * @param chan		Channel structure to fill.
+ * @param bdf		BDF of the device.
+ * @param vector	Interrupt vector for doorbells of the peer, 0 for none.
+ * @param slot_size	Message size, a multiple of 4 bytes.
+ * @param flags		Flags of the sending ring (IVSHMEM_RING_*).
+ *
+ * Each peer formats the ring in its half of the shared memory, using as many
+ * slots as fit, and then waits for the other peer to do the same.
+ *
+ * @return True on success.
+ */
+bool ivshmem_channel_init(struct ivshmem_channel *chan, u16 bdf,
+			  unsigned int vector, u32 slot_size, u32 flags)
+{
+	struct ivshmem_device *dev = &chan->dev;
+	unsigned long half;
+	u32 num_slots = 1;
+
+	if (!ivshmem_setup(dev, bdf, vector) || dev->id > 1)
+		return false;
+
+	half = (dev->shmem_size / 2) & ~(IVSHMEM_RING_CACHELINE - 1UL);
+	if (ivshmem_ring_mem_size(1, slot_size) > half)
+		return false;
+	while (ivshmem_ring_mem_size(num_slots * 2, slot_size) <= half)
+		num_slots *= 2;
+
+	ivshmem_set_state(dev, 0);
+	if (ivshmem_ring_init(&chan->tx, dev->shmem + dev->id * half, half,
+			      num_slots, slot_size, flags))
+		return false;
+	/* also notifies the peer */
+	ivshmem_set_state(dev, 1);
+
+	while (ivshmem_remote_state(dev) != 1)
+		cpu_relax();
+	while (ivshmem_ring_attach(&chan->rx, dev->shmem + (1 - dev->id) * half,
+				   half))
+		cpu_relax();
+
+	return true;
+}
+
+/**
+ * Send messages to the peer.
+ * @param chan		Channel.
+ * @param msgs		Array of messages of the channel's slot size.
+ * @param num		Number of messages.
+ *
+ * The peer is only interrupted if it armed its receive notification.
+ *
+ * @return Number of messages sent, less than num if the ring is full.
+ */
+unsigned int ivshmem_channel_send(struct ivshmem_channel *chan,
+				  const void *msgs, unsigned int num)
+{
+	int notify = 0;
+
+	num = ivshmem_ring_enqueue_burst(&chan->tx, msgs, num, &notify);
+	if (notify)
+		ivshmem_notify(&chan->dev);
+	return num;
+}
+
+/**
+ * Receive messages from the peer.
+ * @param chan		Channel.
+ * @param msgs		Array for messages of the peer's slot size.
+ * @param num		Maximum number of messages.
+ *
+ * @return Number of messages received.
+ */
+unsigned int ivshmem_channel_receive(struct ivshmem_channel *chan,
+				     void *msgs, unsigned int num)
+{
+	int notify = 0;
+
+	num = ivshmem_ring_dequeue_burst(&chan->rx, msgs, num, &notify);
+	if (notify)
+		ivshmem_notify(&chan->dev);
+	return num;
+}
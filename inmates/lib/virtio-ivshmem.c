@@ -0,0 +1,598 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <inmate.h>
+#include <virtio.h>
+#include <jailhouse/cell-config.h>
+
+/* keeps the rings written by either side on separate cache lines */
+#define VRING_ALIGN		64
+
+#define VIRTIO_BLK_BOUNCE_SIZE	0x10000
+
+#define VIRTIO_NET_BUF_SIZE \
+	(sizeof(struct virtio_net_hdr) + VIRTIO_NET_MAX_FRAME)
+
+struct virtio_blk {
+	struct virtio_blk_req_hdr *hdr;
+	volatile u8 *status;
+	u8 *bounce;
+};
+
+struct virtio_net {
+	u8 *rx_bufs;
+	u8 *tx_bufs;
+};
+
+static u64 shmem_offset(struct virtio_device *vdev, const void *addr)
+{
+	return (unsigned long)addr - (unsigned long)vdev->ivshmem.shmem;
+}
+
+/**
+ * Look up the ivshmem device of a virtio front-end.
+ * @param device_id	virtio device type (VIRTIO_ID_*).
+ * @param start_bdf	First BDF to consider.
+ *
+ * @return BDF of the device or -1 if none was found.
+ */
+int virtio_find_device(u32 device_id, u16 start_bdf)
+{
+	return ivshmem_find_device(JAILHOUSE_SHMEM_PROTO_VIRTIO_FRONT |
+				   device_id, start_bdf);
+}
+
+/**
+ * Allocate memory that the back-end can access.
+ * @param vdev		virtio device.
+ * @param size		Size of the allocation.
+ * @param align		Alignment, a power of 2.
+ *
+ * @return Pointer into the shared memory or NULL if it is exhausted.
+ */
+void *virtio_alloc(struct virtio_device *vdev, unsigned long size,
+		   unsigned long align)
+{
+	unsigned long pos = (vdev->shmem_pos + align - 1) & ~(align - 1);
+
+	if (pos + size > vdev->ivshmem.shmem_size)
+		return NULL;
+
+	vdev->shmem_pos = pos + size;
+	return vdev->ivshmem.shmem + pos;
+}
+
+static bool virtqueue_init(struct virtio_device *vdev, unsigned int index,
+			   unsigned int size)
+{
+	struct virtio_ivshmem_queue *q = &vdev->header->queues[index];
+	struct virtqueue *vq = &vdev->queues[index];
+	unsigned int n;
+
+	vq->desc = virtio_alloc(vdev, VRING_DESC_SIZE(size), VRING_ALIGN);
+	/* including the event index fields */
+	vq->avail = virtio_alloc(vdev, VRING_AVAIL_SIZE(size) + 2,
+				 VRING_ALIGN);
+	vq->used = virtio_alloc(vdev, VRING_USED_SIZE(size) + 2, VRING_ALIGN);
+	if (!vq->desc || !vq->avail || !vq->used)
+		return false;
+
+	memset(vq->avail, 0, VRING_AVAIL_SIZE(size) + 2);
+	memset(vq->used, 0, VRING_USED_SIZE(size) + 2);
+	for (n = 0; n < size; n++)
+		vq->desc[n].next = n + 1;
+
+	vq->size = size;
+	vq->num_free = size;
+	vq->free_head = 0;
+	vq->avail_idx = vq->kicked_idx = vq->last_used_idx = 0;
+
+	q->size = size;
+	q->desc = shmem_offset(vdev, vq->desc);
+	q->avail = shmem_offset(vdev, vq->avail);
+	q->used = shmem_offset(vdev, vq->used);
+	memory_barrier();
+	q->ready = 1;
+
+	return true;
+}
+
+/**
+ * Initialize a virtio front-end and wait for its back-end.
+ * @param vdev		Device structure to fill.
+ * @param bdf		BDF of the ivshmem device.
+ * @param features	Features to accept if offered, besides
+ *			VIRTIO_F_VERSION_1 and VIRTIO_RING_F_EVENT_IDX.
+ * @param queue_size	Maximum number of descriptors per queue.
+ * @param vector	Interrupt vector for notifications of the back-end, 0
+ *			to only poll.
+ *
+ * @return True on success.
+ */
+bool virtio_init(struct virtio_device *vdev, u16 bdf, u64 features,
+		 unsigned int queue_size, unsigned int vector)
+{
+	struct virtio_ivshmem_header *header;
+	unsigned int n;
+
+	if (!ivshmem_setup(&vdev->ivshmem, bdf, vector) ||
+	    vdev->ivshmem.shmem_size <= VIRTIO_IVSHMEM_HEADER_SIZE)
+		return false;
+
+	header = vdev->header = vdev->ivshmem.shmem;
+	vdev->shmem_pos = VIRTIO_IVSHMEM_HEADER_SIZE;
+
+	ivshmem_set_state(&vdev->ivshmem, VIRTIO_IVSHMEM_STATE_RESET);
+	/* an active back-end has to acknowledge the reset first */
+	while (ivshmem_remote_state(&vdev->ivshmem) !=
+	       VIRTIO_IVSHMEM_STATE_READY)
+		cpu_relax();
+	memory_barrier();
+
+	if (header->magic != VIRTIO_IVSHMEM_MAGIC ||
+	    header->revision != VIRTIO_IVSHMEM_REVISION ||
+	    header->num_queues > VIRTIO_IVSHMEM_MAX_QUEUES)
+		return false;
+
+	header->device_status = VIRTIO_CONFIG_S_ACKNOWLEDGE |
+		VIRTIO_CONFIG_S_DRIVER;
+
+	features |= (1ULL << VIRTIO_F_VERSION_1) |
+		(1ULL << VIRTIO_RING_F_EVENT_IDX);
+	vdev->features = header->device_features & features;
+	if (!virtio_has_feature(vdev, VIRTIO_F_VERSION_1)) {
+		header->device_status |= VIRTIO_CONFIG_S_FAILED;
+		return false;
+	}
+	header->driver_features = vdev->features;
+	header->device_status |= VIRTIO_CONFIG_S_FEATURES_OK;
+
+	vdev->device_id = header->device_id;
+	vdev->num_queues = header->num_queues;
+	if (queue_size > header->queue_size_max)
+		queue_size = header->queue_size_max;
+	/* round down to a power of 2 */
+	while (queue_size & (queue_size - 1))
+		queue_size &= queue_size - 1;
+
+	for (n = 0; n < vdev->num_queues; n++)
+		if (!virtqueue_init(vdev, n, queue_size)) {
+			header->device_status |= VIRTIO_CONFIG_S_FAILED;
+			return false;
+		}
+
+	memory_barrier();
+	header->device_status |= VIRTIO_CONFIG_S_DRIVER_OK;
+	/* also notifies the back-end */
+	ivshmem_set_state(&vdev->ivshmem, VIRTIO_IVSHMEM_STATE_READY);
+
+	return true;
+}
+
+/**
+ * Make a chain of buffers available to the back-end.
+ * @param vq		Queue to use.
+ * @param vdev		virtio device.
+ * @param bufs		Buffers, located in the shared memory.
+ * @param num		Number of buffers.
+ *
+ * The back-end is not notified until virtqueue_kick() is called, so that
+ * several chains can be passed with a single notification.
+ *
+ * @return Descriptor ID of the chain or -1 if the queue is full.
+ */
+int virtqueue_add(struct virtqueue *vq, struct virtio_device *vdev,
+		  const struct virtio_buffer *bufs, unsigned int num)
+{
+	unsigned int head = vq->free_head, idx = head, n;
+	struct vring_desc *desc;
+
+	if (num == 0 || num > vq->num_free)
+		return -1;
+
+	for (n = 0; n < num; n++) {
+		desc = &vq->desc[idx];
+		desc->addr = shmem_offset(vdev, bufs[n].addr);
+		desc->len = bufs[n].len;
+		desc->flags = bufs[n].writable ? VRING_DESC_F_WRITE : 0;
+		if (n < num - 1)
+			desc->flags |= VRING_DESC_F_NEXT;
+		idx = desc->next;
+	}
+	vq->free_head = idx;
+	vq->num_free -= num;
+
+	vq->avail->ring[vq->avail_idx % vq->size] = head;
+	/* publish the descriptors before the index */
+	memory_barrier();
+	vq->avail->idx = ++vq->avail_idx;
+
+	return head;
+}
+
+/**
+ * Notify the back-end about new buffers, unless it does not need that.
+ * @param vq		Queue with new buffers.
+ * @param vdev		virtio device.
+ */
+void virtqueue_kick(struct virtqueue *vq, struct virtio_device *vdev)
+{
+	bool notify;
+
+	/* the index has to be visible before checking for suppression */
+	memory_barrier();
+
+	if (virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX))
+		notify = vring_need_event(*vring_avail_event(vq->used,
+							     vq->size),
+					  vq->avail_idx, vq->kicked_idx);
+	else
+		notify = !(vq->used->flags & VRING_USED_F_NO_NOTIFY);
+	vq->kicked_idx = vq->avail_idx;
+
+	if (notify)
+		ivshmem_notify(&vdev->ivshmem);
+}
+
+/**
+ * Take the next chain the back-end is done with.
+ * @param vq		Queue to check.
+ * @param vdev		virtio device.
+ * @param len		Returns the number of bytes the back-end wrote.
+ *
+ * @return Descriptor ID of the chain or -1 if there is none.
+ */
+int virtqueue_get_used(struct virtqueue *vq, struct virtio_device *vdev,
+		       u32 *len)
+{
+	volatile struct vring_used *used = vq->used;
+	unsigned int id, idx, num = 1;
+
+	if (used->idx == vq->last_used_idx)
+		return -1;
+	/* read the entry only after the index */
+	memory_barrier();
+
+	id = used->ring[vq->last_used_idx % vq->size].id;
+	*len = used->ring[vq->last_used_idx % vq->size].len;
+	vq->last_used_idx++;
+	if (virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX))
+		*vring_used_event(vq->avail, vq->size) = vq->last_used_idx;
+
+	if (id >= vq->size)
+		return -1;
+
+	/* return the chain to the free list */
+	for (idx = id; vq->desc[idx].flags & VRING_DESC_F_NEXT;
+	     idx = vq->desc[idx].next)
+		num++;
+	vq->desc[idx].next = vq->free_head;
+	vq->free_head = id;
+	vq->num_free += num;
+
+	return id;
+}
+
+static int virtqueue_wait_used(struct virtqueue *vq,
+			       struct virtio_device *vdev, u32 *len)
+{
+	int id;
+
+	while ((id = virtqueue_get_used(vq, vdev, len)) < 0)
+		cpu_relax();
+	return id;
+}
+
+/**
+ * Prepare a block device for virtio_blk_read() and virtio_blk_write().
+ * @param vdev		Initialized virtio device of type VIRTIO_ID_BLOCK.
+ *
+ * @return True on success.
+ */
+bool virtio_blk_init(struct virtio_device *vdev)
+{
+	struct virtio_blk *blk;
+
+	if (vdev->device_id != VIRTIO_ID_BLOCK || vdev->num_queues < 1)
+		return false;
+
+	blk = alloc(sizeof(*blk), sizeof(long));
+	blk->hdr = virtio_alloc(vdev, sizeof(*blk->hdr), VRING_ALIGN);
+	blk->status = virtio_alloc(vdev, 1, 1);
+	blk->bounce = virtio_alloc(vdev, VIRTIO_BLK_BOUNCE_SIZE, PAGE_SIZE);
+	if (!blk->hdr || !blk->status || !blk->bounce)
+		return false;
+
+	vdev->priv = blk;
+	return true;
+}
+
+/**
+ * Report the capacity of a block device.
+ * @param vdev		Block device.
+ *
+ * @return Capacity in sectors of VIRTIO_BLK_SECTOR_SIZE.
+ */
+u64 virtio_blk_capacity(struct virtio_device *vdev)
+{
+	return ((struct virtio_blk_config *)vdev->header->config)->capacity;
+}
+
+static int virtio_blk_request(struct virtio_device *vdev, u32 type,
+			      u64 sector, unsigned int len)
+{
+	struct virtqueue *vq = &vdev->queues[0];
+	struct virtio_blk *blk = vdev->priv;
+	struct virtio_buffer bufs[3];
+	unsigned int num = 0;
+	u32 written;
+
+	blk->hdr->type = type;
+	blk->hdr->ioprio = 0;
+	blk->hdr->sector = sector;
+	*blk->status = 0xff;
+
+	bufs[num++] = (struct virtio_buffer){ blk->hdr, sizeof(*blk->hdr),
+					      false };
+	if (len > 0)
+		bufs[num++] = (struct virtio_buffer){
+			blk->bounce, len, type == VIRTIO_BLK_T_IN };
+	bufs[num++] = (struct virtio_buffer){ (void *)blk->status, 1, true };
+
+	if (virtqueue_add(vq, vdev, bufs, num) < 0)
+		return -1;
+	virtqueue_kick(vq, vdev);
+	virtqueue_wait_used(vq, vdev, &written);
+
+	return *blk->status == VIRTIO_BLK_S_OK ? 0 : -1;
+}
+
+/**
+ * Read from a block device.
+ * @param vdev		Block device.
+ * @param sector	First sector to read.
+ * @param buf		Destination buffer.
+ * @param sectors	Number of sectors to read.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+int virtio_blk_read(struct virtio_device *vdev, u64 sector, void *buf,
+		    unsigned int sectors)
+{
+	struct virtio_blk *blk = vdev->priv;
+	unsigned int len;
+
+	while (sectors > 0) {
+		len = sectors * VIRTIO_BLK_SECTOR_SIZE;
+		if (len > VIRTIO_BLK_BOUNCE_SIZE)
+			len = VIRTIO_BLK_BOUNCE_SIZE;
+
+		if (virtio_blk_request(vdev, VIRTIO_BLK_T_IN, sector, len))
+			return -1;
+		memcpy(buf, blk->bounce, len);
+
+		buf += len;
+		sector += len / VIRTIO_BLK_SECTOR_SIZE;
+		sectors -= len / VIRTIO_BLK_SECTOR_SIZE;
+	}
+	return 0;
+}
+
+/**
+ * Write to a block device.
+ * @param vdev		Block device.
+ * @param sector	First sector to write.
+ * @param buf		Source buffer.
+ * @param sectors	Number of sectors to write.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+int virtio_blk_write(struct virtio_device *vdev, u64 sector, const void *buf,
+		     unsigned int sectors)
+{
+	struct virtio_blk *blk = vdev->priv;
+	unsigned int len;
+
+	while (sectors > 0) {
+		len = sectors * VIRTIO_BLK_SECTOR_SIZE;
+		if (len > VIRTIO_BLK_BOUNCE_SIZE)
+			len = VIRTIO_BLK_BOUNCE_SIZE;
+
+		memcpy(blk->bounce, buf, len);
+		if (virtio_blk_request(vdev, VIRTIO_BLK_T_OUT, sector, len))
+			return -1;
+
+		buf += len;
+		sector += len / VIRTIO_BLK_SECTOR_SIZE;
+		sectors -= len / VIRTIO_BLK_SECTOR_SIZE;
+	}
+	return 0;
+}
+
+/**
+ * Flush the write cache of a block device.
+ * @param vdev		Block device.
+ *
+ * @return 0 on success, -1 on errors or if flushing is not supported.
+ */
+int virtio_blk_flush(struct virtio_device *vdev)
+{
+	if (!virtio_has_feature(vdev, VIRTIO_BLK_F_FLUSH))
+		return -1;
+	return virtio_blk_request(vdev, VIRTIO_BLK_T_FLUSH, 0, 0);
+}
+
+static void virtio_net_post_rx(struct virtio_device *vdev, unsigned int id)
+{
+	struct virtio_net *net = vdev->priv;
+	struct virtio_buffer buf = {
+		.addr = net->rx_bufs + id * VIRTIO_NET_BUF_SIZE,
+		.len = VIRTIO_NET_BUF_SIZE,
+		.writable = true,
+	};
+
+	virtqueue_add(&vdev->queues[VIRTIO_NET_QUEUE_RX], vdev, &buf, 1);
+}
+
+/**
+ * Prepare a network device and fill its receive queue.
+ * @param vdev		Initialized virtio device of type VIRTIO_ID_NET.
+ *
+ * @return True on success.
+ */
+bool virtio_net_init(struct virtio_device *vdev)
+{
+	struct virtqueue *rx = &vdev->queues[VIRTIO_NET_QUEUE_RX];
+	struct virtqueue *tx = &vdev->queues[VIRTIO_NET_QUEUE_TX];
+	struct virtio_net *net;
+	unsigned int n;
+
+	if (vdev->device_id != VIRTIO_ID_NET || vdev->num_queues < 2)
+		return false;
+
+	net = alloc(sizeof(*net), sizeof(long));
+	net->rx_bufs = virtio_alloc(vdev, rx->size * VIRTIO_NET_BUF_SIZE,
+				    VRING_ALIGN);
+	net->tx_bufs = virtio_alloc(vdev, tx->size * VIRTIO_NET_BUF_SIZE,
+				    VRING_ALIGN);
+	if (!net->rx_bufs || !net->tx_bufs)
+		return false;
+	vdev->priv = net;
+
+	/* single-descriptor chains, thus the buffer index is the chain ID */
+	for (n = 0; n < rx->size; n++)
+		virtio_net_post_rx(vdev, n);
+	virtqueue_kick(rx, vdev);
+
+	return true;
+}
+
+/**
+ * Report the MAC address of a network device.
+ * @param vdev		Network device.
+ * @param mac		Returns the address, all zero if the back-end does
+ *			not provide one.
+ */
+void virtio_net_get_mac(struct virtio_device *vdev, u8 mac[6])
+{
+	struct virtio_net_config *config =
+		(struct virtio_net_config *)vdev->header->config;
+
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_MAC))
+		memcpy(mac, config->mac, 6);
+	else
+		memset(mac, 0, 6);
+}
+
+/**
+ * Queue an Ethernet frame for transmission.
+ * @param vdev		Network device.
+ * @param frame		Frame without FCS.
+ * @param len		Length of the frame.
+ *
+ * The frame is copied. The back-end is notified by virtio_net_flush(), so
+ * that several frames can be sent with a single notification.
+ *
+ * @return 0 on success, -1 if the frame is too large or the queue is full.
+ */
+int virtio_net_send(struct virtio_device *vdev, const void *frame,
+		    unsigned int len)
+{
+	struct virtqueue *tx = &vdev->queues[VIRTIO_NET_QUEUE_TX];
+	struct virtio_net *net = vdev->priv;
+	struct virtio_buffer buf;
+	u32 written;
+	u8 *data;
+
+	if (len > VIRTIO_NET_MAX_FRAME)
+		return -1;
+
+	/* reclaim the buffers of frames already sent */
+	while (virtqueue_get_used(tx, vdev, &written) >= 0)
+		;
+	if (tx->num_free == 0)
+		return -1;
+
+	/* the next chain will start with this descriptor */
+	data = net->tx_bufs + tx->free_head * VIRTIO_NET_BUF_SIZE;
+	memset(data, 0, sizeof(struct virtio_net_hdr));
+	memcpy(data + sizeof(struct virtio_net_hdr), frame, len);
+
+	buf.addr = data;
+	buf.len = sizeof(struct virtio_net_hdr) + len;
+	buf.writable = false;
+	return virtqueue_add(tx, vdev, &buf, 1) < 0 ? -1 : 0;
+}
+
+/**
+ * Notify the back-end about all frames queued by virtio_net_send().
+ * @param vdev		Network device.
+ */
+void virtio_net_flush(struct virtio_device *vdev)
+{
+	virtqueue_kick(&vdev->queues[VIRTIO_NET_QUEUE_TX], vdev);
+}
+
+/**
+ * Receive an Ethernet frame, if available.
+ * @param vdev		Network device.
+ * @param frame		Buffer for the frame.
+ * @param size		Size of the buffer, larger frames are truncated.
+ *
+ * @return Length of the received frame or -1 if there is none.
+ */
+int virtio_net_receive(struct virtio_device *vdev, void *frame,
+		       unsigned int size)
+{
+	struct virtqueue *rx = &vdev->queues[VIRTIO_NET_QUEUE_RX];
+	struct virtio_net *net = vdev->priv;
+	u32 len;
+	int id;
+
+	id = virtqueue_get_used(rx, vdev, &len);
+	if (id < 0)
+		return -1;
+
+	if (len < sizeof(struct virtio_net_hdr) || len > VIRTIO_NET_BUF_SIZE)
+		len = sizeof(struct virtio_net_hdr);
+	len -= sizeof(struct virtio_net_hdr);
+	if (len > size)
+		len = size;
+	memcpy(frame, net->rx_bufs + id * VIRTIO_NET_BUF_SIZE +
+	       sizeof(struct virtio_net_hdr), len);
+
+	virtio_net_post_rx(vdev, id);
+	virtqueue_kick(rx, vdev);
+
+	return len;
+}
@@ -110,6 +110,11 @@ static inline void cpu_relax(void)
 	asm volatile("rep; nop" : : : "memory");
 }
 
+static inline void memory_barrier(void)
+{
+	asm volatile("mfence" : : : "memory");
+}
+
 static inline void __attribute__((noreturn)) halt(void)
 {
 	while (1)
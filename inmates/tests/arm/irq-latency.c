@@ -0,0 +1,127 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Measures the latency from the expiry of a periodic virtual timer deadline
+ * to the entry of its handler and collects it in a histogram with
+ * power-of-two buckets. The histogram is dumped every "dump-samples" samples
+ * and on shutdown:
+ *
+ *   HIST-START,<arch>,<samples>,<min ns>,<max ns>
+ *   HIST,<from ns>,<to ns>,<count>	(one line per non-empty bucket)
+ *   HIST-END
+ *
+ * Buckets are formed in timer ticks and converted to ns for the output. Run
+ * load in the root cell meanwhile to measure its influence.
+ */
+
+#include <inmate.h>
+#include <gic.h>
+
+#ifdef __aarch64__
+#define HIST_ARCH		"arm64"
+#else
+#define HIST_ARCH		"arm"
+#endif
+
+#define NUM_BUCKETS		32
+
+static u64 period_ticks;
+static volatile u64 deadline;
+static unsigned long histogram[NUM_BUCKETS];
+static volatile unsigned long samples;
+static u64 min = ~0ULL, max;
+
+static unsigned int latency_bucket(u64 latency)
+{
+	if (latency > 0xffffffff)
+		return NUM_BUCKETS - 1;
+	if (latency < 2)
+		return 0;
+	return 31 - __builtin_clz((u32)latency);
+}
+
+static void handle_IRQ(unsigned int irqn)
+{
+	u64 now = timer_get_ticks();
+	u64 latency = 0;
+
+	if (irqn != TIMER_IRQ)
+		return;
+
+	if (now > deadline)
+		latency = now - deadline;
+
+	histogram[latency_bucket(latency)]++;
+	if (latency < min)
+		min = latency;
+	if (latency > max)
+		max = latency;
+	samples++;
+
+	do
+		deadline += period_ticks;
+	while (deadline <= now);
+	timer_start_at(deadline);
+}
+
+static void dump_histogram(void)
+{
+	unsigned int n;
+
+	printk("HIST-START,%s,%lu,%llu,%llu\n", HIST_ARCH, samples,
+	       samples ? timer_ticks_to_ns(min) : 0, timer_ticks_to_ns(max));
+	for (n = 0; n < NUM_BUCKETS; n++)
+		if (histogram[n])
+			printk("HIST,%llu,%llu,%lu\n",
+			       n ? timer_ticks_to_ns(1ULL << n) : 0,
+			       timer_ticks_to_ns(2ULL << n), histogram[n]);
+	printk("HIST-END\n");
+}
+
+void inmate_main(void)
+{
+	unsigned long dump_samples, next_dump, period_us;
+	bool terminate = false;
+
+	comm_region->cell_state = JAILHOUSE_CELL_RUNNING_LOCKED;
+
+	period_us = cmdline_parse_int("period-us", 1000);
+	period_ticks = timer_get_frequency() / 1000 * period_us / 1000;
+	dump_samples = cmdline_parse_int("dump-samples", 10000);
+	next_dump = dump_samples;
+
+	gic_setup(handle_IRQ);
+	gic_enable_irq(TIMER_IRQ);
+
+	deadline = timer_get_ticks() + period_ticks;
+	timer_start_at(deadline);
+
+	while (!terminate) {
+		asm volatile("wfi" : : : "memory");
+
+		if (samples >= next_dump) {
+			dump_histogram();
+			next_dump = samples + dump_samples;
+		}
+
+		switch (comm_region->msg_to_cell) {
+		case JAILHOUSE_MSG_NONE:
+			break;
+		case JAILHOUSE_MSG_SHUTDOWN_REQUEST:
+			terminate = true;
+			break;
+		default:
+			jailhouse_send_reply_from_cell(comm_region,
+					JAILHOUSE_MSG_UNKNOWN);
+			break;
+		}
+	}
+
+	timer_stop();
+	dump_histogram();
+
+	comm_region->cell_state = JAILHOUSE_CELL_SHUT_DOWN;
+}
@@ -0,0 +1,110 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Measures the round-trip costs of operations that exit to the hypervisor.
+ * The output starts with "BENCH-START,<arch>,<counter frequency in Hz>", ends
+ * with "BENCH-END" and reports each result as one line of the form
+ *
+ *   BENCH,<name>,<iterations>,<min>,<total>,<max>,ticks
+ *
+ * Ticks are those of the generic timer's virtual counter. The "baseline" line
+ * reports the overhead of the measurement itself.
+ */
+
+#include <inmate.h>
+#include <gic.h>
+
+#ifdef __aarch64__
+#define BENCH_ARCH		"arm64"
+#else
+#define BENCH_ARCH		"arm"
+#endif
+
+#define DEFAULT_ITERATIONS	10000
+
+#define BENCH_SGI		1
+
+#define GICD_IIDR		0x0008
+
+static unsigned int iterations;
+static void *gicd_base;
+static volatile bool irq_received;
+
+static inline u64 read_counter(void)
+{
+	asm volatile("isb" : : : "memory");
+	return timer_get_ticks();
+}
+
+static void run_bench(const char *name, void (*op)(void))
+{
+	u64 start, delta, min = ~0ULL, max = 0, total = 0;
+	unsigned int n;
+
+	for (n = 0; n < iterations; n++) {
+		start = read_counter();
+		op();
+		delta = read_counter() - start;
+
+		if (delta < min)
+			min = delta;
+		if (delta > max)
+			max = delta;
+		total += delta;
+	}
+
+	printk("BENCH,%s,%u,%llu,%llu,%llu,ticks\n", name, iterations, min,
+	       total, max);
+}
+
+static void op_baseline(void)
+{
+}
+
+static void op_hypercall(void)
+{
+	jailhouse_call_arg1(JAILHOUSE_HC_HYPERVISOR_GET_INFO,
+			    JAILHOUSE_INFO_NUM_CELLS);
+}
+
+static void op_mmio(void)
+{
+	/* trapped and forwarded to the physical distributor */
+	mmio_read32(gicd_base + GICD_IIDR);
+}
+
+static void op_sgi(void)
+{
+	irq_received = false;
+	gic_send_sgi_self(BENCH_SGI);
+	while (!irq_received)
+		cpu_relax();
+}
+
+static void handle_IRQ(unsigned int irqn)
+{
+	if (irqn == BENCH_SGI)
+		irq_received = true;
+}
+
+void inmate_main(void)
+{
+	iterations = cmdline_parse_int("iterations", DEFAULT_ITERATIONS);
+
+	gic_setup(handle_IRQ);
+	gic_enable_irq(BENCH_SGI);
+	gicd_base = (void *)(unsigned long)comm_region->gicd_base;
+
+	printk("BENCH-START,%s,%lu\n", BENCH_ARCH, timer_get_frequency());
+
+	run_bench("baseline", op_baseline);
+	run_bench("hypercall", op_hypercall);
+	run_bench("mmio", op_mmio);
+	run_bench("sgi", op_sgi);
+
+	printk("BENCH-END\n");
+	stop();
+}
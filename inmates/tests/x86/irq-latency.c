@@ -0,0 +1,131 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Measures the latency from the expiry of a periodic APIC timer to the entry
+ * of its handler and collects it in a histogram with power-of-two buckets.
+ * The histogram is dumped every "dump-samples" samples and on shutdown:
+ *
+ *   HIST-START,x86,<samples>,<min ns>,<max ns>
+ *   HIST,<from ns>,<to ns>,<count>	(one line per non-empty bucket)
+ *   HIST-END
+ *
+ * Run load in the root cell meanwhile to measure its influence.
+ */
+
+#include <inmate.h>
+
+#define APIC_TIMER_VECTOR	32
+
+#define NUM_BUCKETS		32
+
+/* covers at least one tick of any APIC timer, a zero count would stop it */
+#define MIN_TIMEOUT_NS		1000
+
+static unsigned long period_ns;
+static unsigned long expected_time;
+static unsigned long histogram[NUM_BUCKETS];
+static volatile unsigned long samples;
+static unsigned long min = -1, max;
+
+static unsigned int latency_bucket(unsigned long latency)
+{
+	if (latency > 0xffffffff)
+		return NUM_BUCKETS - 1;
+	if (latency < 2)
+		return 0;
+	return 31 - __builtin_clz(latency);
+}
+
+static void irq_handler(void)
+{
+	unsigned long now = tsc_read();
+	unsigned long latency = 0;
+
+	/* the timer may fire a bit early */
+	if (now > expected_time)
+		latency = now - expected_time;
+
+	histogram[latency_bucket(latency)]++;
+	if (latency < min)
+		min = latency;
+	if (latency > max)
+		max = latency;
+	samples++;
+
+	do
+		expected_time += period_ns;
+	while (expected_time <= now);
+
+	/*
+	 * If the deadline passed meanwhile, fire as soon as possible. The
+	 * sample then counts as late.
+	 */
+	now = tsc_read();
+	apic_timer_set(expected_time > now + MIN_TIMEOUT_NS ?
+		       expected_time - now : MIN_TIMEOUT_NS);
+}
+
+static void dump_histogram(void)
+{
+	unsigned int n;
+
+	printk("HIST-START,x86,%lu,%lu,%lu\n", samples, samples ? min : 0,
+	       max);
+	for (n = 0; n < NUM_BUCKETS; n++)
+		if (histogram[n])
+			printk("HIST,%lu,%lu,%lu\n", n ? 1UL << n : 0,
+			       2UL << n, histogram[n]);
+	printk("HIST-END\n");
+}
+
+void inmate_main(void)
+{
+	unsigned long dump_samples, next_dump;
+	bool terminate = false;
+
+	comm_region->cell_state = JAILHOUSE_CELL_RUNNING_LOCKED;
+
+	period_ns = cmdline_parse_int("period-us", 1000) * NS_PER_USEC;
+	dump_samples = cmdline_parse_int("dump-samples", 10000);
+	next_dump = dump_samples;
+
+	tsc_init();
+
+	int_init();
+	int_set_handler(APIC_TIMER_VECTOR, irq_handler);
+	apic_timer_init(APIC_TIMER_VECTOR);
+
+	expected_time = tsc_read() + period_ns;
+	apic_timer_set(period_ns);
+
+	asm volatile("sti");
+
+	while (!terminate) {
+		asm volatile("hlt");
+
+		if (samples >= next_dump) {
+			dump_histogram();
+			next_dump = samples + dump_samples;
+		}
+
+		switch (comm_region->msg_to_cell) {
+		case JAILHOUSE_MSG_NONE:
+			break;
+		case JAILHOUSE_MSG_SHUTDOWN_REQUEST:
+			terminate = true;
+			break;
+		default:
+			jailhouse_send_reply_from_cell(comm_region,
+					JAILHOUSE_MSG_UNKNOWN);
+			break;
+		}
+	}
+
+	asm volatile("cli");
+	dump_histogram();
+
+	comm_region->cell_state = JAILHOUSE_CELL_SHUT_DOWN;
+}
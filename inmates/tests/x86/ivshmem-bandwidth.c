@@ -0,0 +1,106 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Measures the copy bandwidth between cell memory and the shared memory of an
+ * ivshmem device. This reflects the memory type and page size the hypervisor
+ * uses for the region, see JAILHOUSE_MEM_TYPE_* and JAILHOUSE_MEM_LEAF_* in
+ * jailhouse/cell-config.h. No peer is needed.
+ *
+ * The shared memory is written from and read into a local buffer, chunk by
+ * chunk, until "bytes" (default 256 MiB) have been copied in each direction.
+ * The device is selected via "protocol" (default
+ * JAILHOUSE_SHMEM_PROTO_UNDEFINED). The test reports
+ *
+ *   BENCH,<direction>,<shmem size>,<bytes>,<cycles>
+ *
+ * for the directions "write" and "read", framed by
+ * "BENCH-START,x86,<TSC frequency in Hz>" and "BENCH-END".
+ */
+
+#include <inmate.h>
+#include <ivshmem.h>
+#include <jailhouse/cell-config.h>
+
+#define DEFAULT_BYTES		(256UL << 20)
+#define CHUNK_SIZE		0x10000
+
+static u8 buffer[CHUNK_SIZE] __attribute__((aligned(64)));
+
+static inline u64 read_cycles(void)
+{
+	u32 lo, hi;
+
+	asm volatile("lfence; rdtsc" : "=a" (lo), "=d" (hi) : : "memory");
+	return (u64)lo | ((u64)hi << 32);
+}
+
+/* size has to be a multiple of 8 */
+static void copy(void *dst, const void *src, unsigned long size)
+{
+	unsigned long count = size / 8;
+
+	asm volatile("rep movsq"
+		: "+D" (dst), "+S" (src), "+c" (count) : : "memory");
+}
+
+static void run(struct ivshmem_device *dev, bool to_shmem, u64 bytes)
+{
+	u64 offset = 0, copied = 0, start, cycles;
+	unsigned long size;
+	u8 *shmem = dev->shmem;
+
+	start = read_cycles();
+	while (copied < bytes) {
+		size = dev->shmem_size - offset;
+		if (size > CHUNK_SIZE)
+			size = CHUNK_SIZE;
+
+		if (to_shmem)
+			copy(shmem + offset, buffer, size);
+		else
+			copy(buffer, shmem + offset, size);
+
+		copied += size;
+		offset += size;
+		if (offset == dev->shmem_size)
+			offset = 0;
+	}
+	cycles = read_cycles() - start;
+
+	printk("BENCH,%s,%llu,%llu,%llu\n", to_shmem ? "write" : "read",
+	       dev->shmem_size, copied, cycles);
+}
+
+void inmate_main(void)
+{
+	struct ivshmem_device dev;
+	u64 bytes;
+	int bdf;
+
+	bytes = cmdline_parse_int("bytes", DEFAULT_BYTES);
+	bdf = ivshmem_find_device(cmdline_parse_int("protocol",
+					JAILHOUSE_SHMEM_PROTO_UNDEFINED), 0);
+	if (bdf < 0 || !ivshmem_setup(&dev, bdf, 0)) {
+		printk("No ivshmem device found\n");
+		stop();
+	}
+	if (dev.shmem_size == 0 || dev.shmem_size % 8) {
+		printk("Unsupported shared memory size %llu\n",
+		       dev.shmem_size);
+		stop();
+	}
+
+	printk("Shared memory of device %02x:%02x.%x at %p\n", bdf >> 8,
+	       (bdf >> 3) & 0x1f, bdf & 0x7, dev.shmem);
+	memset(buffer, 0x5a, sizeof(buffer));
+
+	printk("BENCH-START,x86,%lu\n", tsc_init());
+	run(&dev, true, bytes);
+	run(&dev, false, bytes);
+	printk("BENCH-END\n");
+
+	stop();
+}
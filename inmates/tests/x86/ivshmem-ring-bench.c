@@ -0,0 +1,232 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Measures the throughput of the ivshmem message ring.
+ *
+ * With "local" on the command line, or without an ivshmem device, the ring
+ * lives in the cell's own memory. All secondary CPUs fill it and the primary
+ * CPU drains it. Otherwise, two cells running this test are connected via an
+ * ivshmem device of protocol JAILHOUSE_SHMEM_PROTO_UNDEFINED. Every CPU of the
+ * cell at position 0 produces and the primary CPU of the other cell consumes.
+ * Both cells need the same "messages" parameter then.
+ *
+ * Producers fill the slots in place, the consumer reads every word of each
+ * message. The consuming cell reports
+ *
+ *   BENCH,<mode>,<producers>,<message size>,<batch>,<messages>,<cycles>,
+ *         <doorbells>
+ *
+ * on a single line, framed by "BENCH-START,x86,<TSC frequency in Hz>" and
+ * "BENCH-END". Cycles are counted from the first received message.
+ */
+
+#include <inmate.h>
+#include <ivshmem.h>
+#include <jailhouse/cell-config.h>
+
+#define IRQ_VECTOR		32
+
+#define DEFAULT_MSG_SIZE	64
+#define DEFAULT_BATCH		32
+#define DEFAULT_MESSAGES	1000000
+
+#define LOCAL_RING_SIZE		0x10000
+#define MAX_PRODUCERS		64
+
+static u8 local_ring[LOCAL_RING_SIZE]
+	__attribute__((aligned(IVSHMEM_RING_CACHELINE)));
+static struct ivshmem_ring local_tx, local_rx;
+static struct ivshmem_channel chan;
+
+static bool local;
+static struct ivshmem_ring *tx_ring;
+static unsigned int num_producers, batch;
+static u32 messages;
+static volatile bool producers_go;
+static volatile unsigned int doorbells;
+
+static inline u64 read_cycles(void)
+{
+	u32 lo, hi;
+
+	asm volatile("lfence; rdtsc" : "=a" (lo), "=d" (hi) : : "memory");
+	return (u64)lo | ((u64)hi << 32);
+}
+
+static void irq_handler(void)
+{
+	doorbells++;
+}
+
+static void produce(unsigned int producer)
+{
+	u32 count = messages / num_producers +
+		(producer < messages % num_producers);
+	u32 seq = 0, idx, num, n, words, w;
+	u32 *msg;
+
+	words = tx_ring->slot_size / sizeof(u32);
+	while (seq < count) {
+		num = ivshmem_ring_reserve(tx_ring, count - seq < batch ?
+					   count - seq : batch, &idx);
+		if (num == 0) {
+			cpu_relax();
+			continue;
+		}
+
+		for (n = 0; n < num; n++, seq++) {
+			msg = ivshmem_ring_slot(tx_ring, idx + n);
+			msg[0] = producer;
+			for (w = 1; w < words; w++)
+				msg[w] = seq;
+		}
+
+		if (ivshmem_ring_commit(tx_ring, idx, num) && !local)
+			ivshmem_notify(&chan.dev);
+	}
+}
+
+static void secondary_main(void)
+{
+	unsigned int index = 0;
+
+	while (smp_cpu_ids[index] != cpu_id())
+		index++;
+	while (!producers_go)
+		cpu_relax();
+
+	/* in local mode, the primary CPU does not produce */
+	produce(local ? index - 1 : index);
+	stop();
+}
+
+static void consume(struct ivshmem_ring *rx)
+{
+	static u32 expected[MAX_PRODUCERS];
+	unsigned int producers = 0;
+	u32 received = 0, idx, num, n, words, w, sum = 0;
+	u64 start = 0, cycles;
+	u32 *msg;
+
+	words = rx->slot_size / sizeof(u32);
+	while (received < messages) {
+		num = ivshmem_ring_peek(rx, batch, &idx);
+		if (num == 0) {
+			/* sleep if the producer is going to notify us */
+			if (!local && !ivshmem_ring_consumer_arm(rx))
+				asm volatile("sti; hlt; cli" : : : "memory");
+			else
+				cpu_relax();
+			continue;
+		}
+		if (received == 0) {
+			start = read_cycles();
+			doorbells = 0;
+		}
+
+		for (n = 0; n < num; n++) {
+			msg = ivshmem_ring_slot(rx, idx + n);
+			if (msg[0] >= MAX_PRODUCERS ||
+			    msg[1] != expected[msg[0]]) {
+				printk("Unexpected message %u from producer "
+				       "%u\n", msg[1], msg[0]);
+				return;
+			}
+			expected[msg[0]]++;
+			if (msg[0] >= producers)
+				producers = msg[0] + 1;
+			for (w = 1; w < words; w++)
+				sum += msg[w];
+		}
+
+		if (ivshmem_ring_release(rx, num) && !local)
+			ivshmem_notify(&chan.dev);
+		received += num;
+	}
+	cycles = read_cycles() - start;
+
+	printk("BENCH,%s,%u,%u,%u,%u,%llu,%u\n", local ? "local" : "ivshmem",
+	       producers, rx->slot_size, batch, messages, cycles, doorbells);
+	/* keeps the payload reads */
+	if (sum == 0x5a5a5a5a)
+		printk("\n");
+}
+
+void inmate_main(void)
+{
+	u32 msg_size, flags, num_slots = 1;
+	unsigned int n;
+	int bdf;
+
+	msg_size = cmdline_parse_int("msg_size", DEFAULT_MSG_SIZE);
+	batch = cmdline_parse_int("batch", DEFAULT_BATCH);
+	messages = cmdline_parse_int("messages", DEFAULT_MESSAGES);
+	local = cmdline_parse_bool("local", false);
+
+	if (msg_size < 2 * sizeof(u32) || batch == 0) {
+		printk("Invalid parameters\n");
+		stop();
+	}
+
+	smp_wait_for_all_cpus();
+	int_init();
+	int_set_handler(IRQ_VECTOR, irq_handler);
+
+	bdf = local ? -1 :
+		ivshmem_find_device(JAILHOUSE_SHMEM_PROTO_UNDEFINED, 0);
+	if (bdf < 0)
+		local = true;
+
+	num_producers = local ? smp_num_cpus - 1 : smp_num_cpus;
+	if (num_producers == 0 || num_producers > MAX_PRODUCERS) {
+		printk("Unsupported number of CPUs: %u\n", smp_num_cpus);
+		stop();
+	}
+	flags = num_producers > 1 ? IVSHMEM_RING_MP : 0;
+
+	printk("BENCH-START,x86,%lu\n", tsc_init());
+
+	if (local) {
+		while (ivshmem_ring_mem_size(num_slots * 2, msg_size) <=
+		       sizeof(local_ring))
+			num_slots *= 2;
+		if (ivshmem_ring_init(&local_tx, local_ring, sizeof(local_ring),
+				      num_slots, msg_size, flags) ||
+		    ivshmem_ring_attach(&local_rx, local_ring,
+					sizeof(local_ring))) {
+			printk("Invalid ring parameters\n");
+			stop();
+		}
+		tx_ring = &local_tx;
+	} else {
+		printk("Waiting for peer on device %02x:%02x.%x\n", bdf >> 8,
+		       (bdf >> 3) & 0x1f, bdf & 0x7);
+		if (!ivshmem_channel_init(&chan, bdf, IRQ_VECTOR, msg_size,
+					  flags)) {
+			printk("Channel setup failed\n");
+			stop();
+		}
+		tx_ring = &chan.tx;
+	}
+
+	if (local || chan.dev.id == 0)
+		for (n = 1; n < smp_num_cpus; n++)
+			smp_start_cpu(smp_cpu_ids[n], secondary_main);
+	producers_go = true;
+
+	if (local) {
+		consume(&local_rx);
+	} else if (chan.dev.id == 0) {
+		produce(0);
+		printk("Produced %u messages on %u CPUs\n", messages,
+		       num_producers);
+	} else {
+		consume(&chan.rx);
+	}
+
+	printk("BENCH-END\n");
+	stop();
+}
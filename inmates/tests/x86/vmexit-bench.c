@@ -0,0 +1,209 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Measures the round-trip costs of operations that exit to the hypervisor.
+ * The output starts with "BENCH-START,x86,<TSC frequency in Hz>", ends with
+ * "BENCH-END" and reports each result as one line of the form
+ *
+ *   BENCH,<name>,<iterations>,<min>,<total>,<max>,cycles
+ *
+ * The "baseline" line reports the overhead of the measurement itself. If the
+ * cell has an ivshmem device, MMIO accesses to its registers are measured.
+ * When the peer runs this inmate as well, the one with ID 0 measures doorbell
+ * ping-pongs while the other one keeps replying to them.
+ */
+
+#include <inmate.h>
+
+#define DEFAULT_ITERATIONS	10000
+
+#define IPI_VECTOR		40
+#define DOORBELL_VECTOR		41
+
+#define IVSHMEM_VENDOR_ID	0x1af4
+#define IVSHMEM_DEVICE_ID	0x1110
+
+#define IVSHMEM_CFG_SHMEM_PTR	0x40
+#define IVSHMEM_CFG_SHMEM_SZ	0x48
+
+#define IVSHMEM_REG_IVPOS	8
+#define IVSHMEM_REG_DBELL	12
+#define IVSHMEM_REG_LSTATE	16
+#define IVSHMEM_REG_RSTATE	20
+
+#define PCI_CFG_IO_ADDR		0xcf8
+
+static unsigned int iterations;
+static void *ivshmem_regs;
+static volatile bool irq_received;
+
+static inline u64 read_cycles(void)
+{
+	u32 lo, hi;
+
+	asm volatile("lfence; rdtsc" : "=a" (lo), "=d" (hi) : : "memory");
+	return (u64)lo | ((u64)hi << 32);
+}
+
+static void run_bench(const char *name, void (*op)(void))
+{
+	u64 start, delta, min = ~0ULL, max = 0, total = 0;
+	unsigned int n;
+
+	for (n = 0; n < iterations; n++) {
+		start = read_cycles();
+		op();
+		delta = read_cycles() - start;
+
+		if (delta < min)
+			min = delta;
+		if (delta > max)
+			max = delta;
+		total += delta;
+	}
+
+	printk("BENCH,%s,%u,%llu,%llu,%llu,cycles\n", name, iterations, min,
+	       total, max);
+}
+
+static void op_baseline(void)
+{
+}
+
+static void op_cpuid(void)
+{
+	u32 eax = 0, ebx, ecx = 0, edx;
+
+	asm volatile("cpuid"
+		: "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx)
+		: : "memory");
+}
+
+static void op_hypercall(void)
+{
+	jailhouse_call_arg1(JAILHOUSE_HC_HYPERVISOR_GET_INFO,
+			    JAILHOUSE_INFO_NUM_CELLS);
+}
+
+static void op_pio(void)
+{
+	/* emulated by the hypervisor without touching the hardware */
+	inl(PCI_CFG_IO_ADDR);
+}
+
+static void op_mmio(void)
+{
+	mmio_read32(ivshmem_regs + IVSHMEM_REG_IVPOS);
+}
+
+static void irq_handler(void)
+{
+	irq_received = true;
+}
+
+static void op_ipi(void)
+{
+	irq_received = false;
+	int_send_ipi(cpu_id(), IPI_VECTOR);
+	while (!irq_received)
+		cpu_relax();
+}
+
+static void op_doorbell(void)
+{
+	irq_received = false;
+	mmio_write32(ivshmem_regs + IVSHMEM_REG_DBELL, 1);
+	while (!irq_received)
+		cpu_relax();
+}
+
+static void doorbell_reply_handler(void)
+{
+	mmio_write32(ivshmem_regs + IVSHMEM_REG_DBELL, 1);
+}
+
+static u64 pci_cfg_read64(u16 bdf, unsigned int addr)
+{
+	return ((u64)pci_read_config(bdf, addr + 4, 4) << 32) |
+		pci_read_config(bdf, addr, 4);
+}
+
+static void pci_cfg_write64(u16 bdf, unsigned int addr, u64 val)
+{
+	pci_write_config(bdf, addr + 4, (u32)(val >> 32), 4);
+	pci_write_config(bdf, addr, (u32)val, 4);
+}
+
+static bool ivshmem_setup(void)
+{
+	u64 shmem, shmem_size;
+	int bdf;
+
+	bdf = pci_find_device(IVSHMEM_VENDOR_ID, IVSHMEM_DEVICE_ID, 0);
+	if (bdf < 0 || pci_find_cap(bdf, PCI_CAP_MSIX) < 0)
+		return false;
+
+	shmem = pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_PTR);
+	shmem_size = pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_SZ);
+
+	/* place the register and MSI-X BARs right after the shared memory */
+	ivshmem_regs = (void *)((shmem + shmem_size + PAGE_SIZE - 1) &
+				PAGE_MASK);
+	pci_cfg_write64(bdf, PCI_CFG_BAR, (u64)ivshmem_regs);
+	pci_cfg_write64(bdf, PCI_CFG_BAR + 16, (u64)ivshmem_regs + PAGE_SIZE);
+	pci_write_config(bdf, PCI_CFG_COMMAND, PCI_CMD_MEM | PCI_CMD_MASTER,
+			 2);
+	map_range(ivshmem_regs, 2 * PAGE_SIZE, MAP_UNCACHED);
+
+	pci_msix_set_vector(bdf, DOORBELL_VECTOR, 0);
+
+	return true;
+}
+
+void inmate_main(void)
+{
+	bool has_ivshmem;
+
+	iterations = cmdline_parse_int("iterations", DEFAULT_ITERATIONS);
+
+	int_init();
+	int_set_handler(IPI_VECTOR, irq_handler);
+	int_set_handler(DOORBELL_VECTOR, irq_handler);
+
+	has_ivshmem = ivshmem_setup();
+
+	asm volatile("sti");
+
+	printk("BENCH-START,x86,%lu\n", tsc_init());
+
+	run_bench("baseline", op_baseline);
+	run_bench("cpuid", op_cpuid);
+	run_bench("hypercall", op_hypercall);
+	run_bench("pio", op_pio);
+	run_bench("ipi", op_ipi);
+
+	if (has_ivshmem) {
+		run_bench("mmio", op_mmio);
+
+		if (mmio_read32(ivshmem_regs + IVSHMEM_REG_IVPOS) != 0) {
+			int_set_handler(DOORBELL_VECTOR,
+					doorbell_reply_handler);
+			mmio_write32(ivshmem_regs + IVSHMEM_REG_LSTATE, 1);
+			printk("BENCH-END\n");
+			printk("Replying to doorbells of the peer\n");
+			halt();
+		}
+
+		/* wait for the peer to reply */
+		mmio_write32(ivshmem_regs + IVSHMEM_REG_LSTATE, 1);
+		while (mmio_read32(ivshmem_regs + IVSHMEM_REG_RSTATE) != 1)
+			cpu_relax();
+		run_bench("doorbell", op_doorbell);
+	}
+
+	printk("BENCH-END\n");
+	stop();
+}
@@ -22,6 +22,8 @@ class JailhouseCell:
 
     JAILHOUSE_CELL_ID_UNUSED = -1
 
+    JAILHOUSE_IMAGE_COMPRESSED = 0x0001
+
     def __init__(self, config):
         self.name = config.name.encode()
 
@@ -35,12 +37,13 @@ class JailhouseCell:
             if e.errno != errno.EEXIST:
                 raise e
 
-    def load(self, image, address):
+    def load(self, image, address, flags=0):
         cbuf = ctypes.create_string_buffer(bytes(image))
 
-        load = struct.pack('i4x32sI4xQQQ8x',
+        load = struct.pack('i4x32sI4xQQQI4x',
                            JailhouseCell.JAILHOUSE_CELL_ID_UNUSED, self.name,
-                           1, ctypes.addressof(cbuf), len(image), address)
+                           1, ctypes.addressof(cbuf), len(image), address,
+                           flags)
         fcntl.ioctl(self.dev, self.JAILHOUSE_CELL_LOAD, load)
 
     def start(self):
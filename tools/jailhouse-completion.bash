@@ -117,7 +117,8 @@ function _jailhouse_cell_linux() {
 	cur="${COMP_WORDS[COMP_CWORD]}"
 	prev="${COMP_WORDS[COMP_CWORD-1]}"
 
-	options="-h --help -i --initrd -c --cmdline -w --write-params"
+	options="-h --help -i --initrd -z --decompress-initrd -c --cmdline"
+	options="${options} -w --write-params"
 
 	# if we already have begun to write an option
 	if [[ "$cur" == -* ]]; then
@@ -196,7 +197,7 @@ function _jailhouse_cell() {
 		# the first image or string have to be given, after that it is:
 		#
 		# [{image | <-s|--string> string} [<-a|--address> <address>]
-		#  [{image | <-s|--string> string} [...] ... ]]
+		#  [<-z|--decompress>] [{image | <-s|--string> string} [...] ... ]]
 
 		# prev was an address or a string switch, no image here
 		if [[ "${prev}" = "-a" || "${prev}" = "--address" ||
@@ -208,7 +209,7 @@ function _jailhouse_cell() {
 			# did we already start to type another switch
 			if [[ "$cur" == -* ]]; then
 				COMPREPLY=( $( compgen \
-					-W "-a --address -s --string" -- \
+					-W "-a --address -z --decompress -s --string" -- \
 					"${cur}") )
 			fi
 
@@ -218,7 +219,7 @@ function _jailhouse_cell() {
 		fi
 
 		;;
-	start)
+	snapshot|restore|start)
 		# takes only one argument (id/name)
 		_jailhouse_get_id "${cur}" "${prev}" no_root || return 1
 		;;
@@ -300,10 +301,12 @@ function _jailhouse() {
 	local command command_cell command_config cur prev subcommand
 
 	# first level
-	command="enable disable console cell config hardware --help"
+	command="enable disable console cell config hardware trace profile"
+	command="${command} --help"
 
 	# second level
-	command_cell="create load start shutdown destroy linux list stats"
+	command_cell="create load snapshot restore start shutdown destroy linux list"
+	command_cell="${command_cell} stats"
 	command_config="create collect"
 
 	# ${COMP_WORDS} array containing the words on the current command line
@@ -350,6 +353,12 @@ function _jailhouse() {
 		hardware)
 			COMPREPLY="check"
 			;;
+		trace)
+			COMPREPLY="export"
+			;;
+		profile)
+			COMPREPLY="report"
+			;;
 		--help|disable)
 			# these first level commands have no further subcommand
 			# or option OR we don't even know it
@@ -397,6 +406,37 @@ function _jailhouse() {
 				return 1;;
 			esac
 			;;
+		trace)
+			case "${subcommand}" in
+			export)
+				if [[ "$cur" == -* ]]; then
+					COMPREPLY=( $( compgen -W "-f --follow \
+						-i --input -o --output" -- \
+						"${cur}") )
+				else
+					_filedir
+				fi
+				;;
+			*)
+				return 1;;
+			esac
+			;;
+		profile)
+			case "${subcommand}" in
+			report)
+				if [[ "$cur" == -* ]]; then
+					COMPREPLY=( $( compgen -W "-f --follow \
+						-i --input -l --lines \
+						-c --cell -n --top" -- \
+						"${cur}") )
+				else
+					_filedir
+				fi
+				;;
+			*)
+				return 1;;
+			esac
+			;;
 		*)
 			# no further subsubcommand/option known for this
 			return 1;;
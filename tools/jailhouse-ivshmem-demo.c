@@ -0,0 +1,239 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Root cell peer of the ivshmem-demo and the ivshmem-ring-bench inmates, see
+ * Documentation/ivshmem-ring.md. The ivshmem device has to be bound to the
+ * uio_ivshmem driver.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+
+/* the producers of this process are preemptible */
+#define ivshmem_ring_cpu_relax()	sched_yield()
+
+#include <jailhouse/ivshmem-ring.h>
+
+#define IVSHMEM_REG_IVPOS	(8 / 4)
+#define IVSHMEM_REG_DBELL	(12 / 4)
+#define IVSHMEM_REG_LSTATE	(16 / 4)
+#define IVSHMEM_REG_RSTATE	(20 / 4)
+
+#define MAX_PRODUCERS		64
+#define BATCH			32
+
+struct demo_msg {
+	__u32 sender;
+	__u32 count;
+	char text[24];
+};
+
+static int uio_fd;
+static volatile __u32 *regs;
+static struct ivshmem_ring tx, rx;
+
+static void __attribute__((noreturn)) help(char *prog, int exit_status)
+{
+	printf("Usage: %s UIO-DEVICE [sink MESSAGES]\n", basename(prog));
+	exit(exit_status);
+}
+
+static void __attribute__((noreturn)) fatal(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void *uio_map(const char *uio_dev, unsigned int map, size_t *size)
+{
+	char path[PATH_MAX], *dev_copy = strdup(uio_dev);
+	unsigned long long map_size;
+	FILE *file;
+	void *addr;
+
+	snprintf(path, sizeof(path), "/sys/class/uio/%s/maps/map%u/size",
+		 basename(dev_copy), map);
+	free(dev_copy);
+
+	file = fopen(path, "r");
+	if (!file)
+		fatal(path);
+	if (fscanf(file, "%llx", &map_size) != 1) {
+		fprintf(stderr, "%s: invalid size\n", path);
+		exit(1);
+	}
+	fclose(file);
+
+	addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    uio_fd, map * getpagesize());
+	if (addr == MAP_FAILED)
+		fatal("mmap");
+	*size = map_size;
+	return addr;
+}
+
+/* Same layout as ivshmem_channel_init() of the inmate library. */
+static void channel_init(__u8 *shmem, size_t shmem_size)
+{
+	size_t half = (shmem_size / 2) & ~(IVSHMEM_RING_CACHELINE - 1UL);
+	__u32 id = regs[IVSHMEM_REG_IVPOS], num_slots = 1;
+
+	if (id > 1 ||
+	    ivshmem_ring_mem_size(1, sizeof(struct demo_msg)) > half) {
+		fprintf(stderr, "unsupported shared memory layout\n");
+		exit(1);
+	}
+	while (ivshmem_ring_mem_size(num_slots * 2, sizeof(struct demo_msg)) <=
+	       half)
+		num_slots *= 2;
+
+	regs[IVSHMEM_REG_LSTATE] = 0;
+	ivshmem_ring_init(&tx, shmem + id * half, half, num_slots,
+			  sizeof(struct demo_msg), 0);
+	regs[IVSHMEM_REG_LSTATE] = 1;
+
+	printf("Waiting for peer\n");
+	while (regs[IVSHMEM_REG_RSTATE] != 1 ||
+	       ivshmem_ring_attach(&rx, shmem + (1 - id) * half, half))
+		usleep(1000);
+	printf("Connected, got position %u\n", id);
+}
+
+/* Wait for a doorbell interrupt, at most timeout_ms. */
+static void wait_doorbell(int timeout_ms)
+{
+	struct pollfd pfd = { .fd = uio_fd, .events = POLLIN };
+	__u32 count;
+
+	if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+		if (read(uio_fd, &count, sizeof(count)) < 0)
+			fatal("uio read");
+		/* re-enable the interrupt, if controllable at all */
+		count = 1;
+		if (write(uio_fd, &count, sizeof(count)) < 0 &&
+		    errno != ENOSYS && errno != EIO)
+			fatal("uio write");
+	}
+}
+
+static void run_demo(void)
+{
+	struct demo_msg msg = {
+		.sender = regs[IVSHMEM_REG_IVPOS],
+		.text = "Hello From Linux",
+	};
+	struct demo_msg received;
+	int notify = 0;
+
+	if (rx.slot_size != sizeof(received)) {
+		fprintf(stderr, "unexpected message size %u\n", rx.slot_size);
+		exit(1);
+	}
+
+	while (1) {
+		while (ivshmem_ring_dequeue_burst(&rx, &received, 1, &notify)) {
+			received.text[sizeof(received.text) - 1] = 0;
+			printf("peer %u says \"%s\" #%u\n", received.sender,
+			       received.text, received.count);
+		}
+
+		if (ivshmem_ring_enqueue_burst(&tx, &msg, 1, &notify))
+			msg.count++;
+		if (notify)
+			regs[IVSHMEM_REG_DBELL] = 1;
+		notify = 0;
+
+		/* wake up on the next message, or send after a second */
+		if (!ivshmem_ring_consumer_arm(&rx))
+			wait_doorbell(1000);
+	}
+}
+
+static void run_sink(unsigned long messages)
+{
+	static __u32 expected[MAX_PRODUCERS];
+	unsigned long received = 0;
+	unsigned int producers = 0;
+	struct timespec start, end;
+	__u32 idx, num, n, *msg;
+	double secs;
+
+	while (received < messages) {
+		num = ivshmem_ring_peek(&rx, BATCH, &idx);
+		if (num == 0) {
+			if (!ivshmem_ring_consumer_arm(&rx))
+				wait_doorbell(1000);
+			continue;
+		}
+		if (received == 0)
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (n = 0; n < num; n++) {
+			msg = ivshmem_ring_slot(&rx, idx + n);
+			if (msg[0] >= MAX_PRODUCERS ||
+			    msg[1] != expected[msg[0]]) {
+				fprintf(stderr, "unexpected message %u from "
+					"producer %u\n", msg[1], msg[0]);
+				exit(1);
+			}
+			expected[msg[0]]++;
+			if (msg[0] >= producers)
+				producers = msg[0] + 1;
+		}
+
+		if (ivshmem_ring_release(&rx, num))
+			regs[IVSHMEM_REG_DBELL] = 1;
+		received += num;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("Received %lu messages of %u bytes from %u producers in %.3f s: "
+	       "%.0f messages/s\n", received, rx.slot_size, producers, secs,
+	       received / secs);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t regs_size, shmem_size;
+	unsigned long messages = 0;
+	__u8 *shmem;
+
+	if (argc == 4 && strcmp(argv[2], "sink") == 0)
+		messages = strtoul(argv[3], NULL, 0);
+	else if (argc != 2)
+		help(argv[0], 1);
+	if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0)
+		help(argv[0], 0);
+
+	uio_fd = open(argv[1], O_RDWR);
+	if (uio_fd < 0)
+		fatal(argv[1]);
+	regs = uio_map(argv[1], 0, &regs_size);
+	shmem = uio_map(argv[1], 1, &shmem_size);
+
+	channel_init(shmem, shmem_size);
+
+	if (messages)
+		run_sink(messages);
+	else
+		run_demo();
+
+	regs[IVSHMEM_REG_LSTATE] = 0;
+	return 0;
+}
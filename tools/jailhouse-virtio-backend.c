@@ -0,0 +1,690 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * virtio back-end for ivshmem devices, see Documentation/ivshmem-virtio.md.
+ * It serves block requests from an image file or bridges network frames to
+ * a TAP interface. The ivshmem device has to be bound to the uio_ivshmem
+ * driver.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/types.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+#include <jailhouse/virtio-ivshmem.h>
+
+#define IVSHMEM_REG_DBELL	(12 / 4)
+#define IVSHMEM_REG_LSTATE	(16 / 4)
+#define IVSHMEM_REG_RSTATE	(20 / 4)
+
+#define QUEUE_SIZE_MAX		256
+#define MAX_CHAIN		16
+#define POLL_INTERVAL_MS	100
+
+#define NET_BUF_SIZE		(sizeof(struct virtio_net_hdr) + 65536)
+
+struct queue {
+	__u16 size;
+	__u16 last_avail_idx;
+	__u16 used_idx;
+	/* used index at the last notification of the front-end */
+	__u16 signaled_used_idx;
+	volatile struct vring_desc *desc;
+	volatile struct vring_avail *avail;
+	volatile struct vring_used *used;
+};
+
+struct chain {
+	unsigned int head;
+	unsigned int num;
+	struct {
+		__u8 *addr;
+		__u32 len;
+		bool writable;
+	} buf[MAX_CHAIN];
+};
+
+static struct {
+	__u32 device_id;
+	volatile __u32 *regs;
+	__u8 *shmem;
+	size_t shmem_size;
+	struct virtio_ivshmem_header *header;
+	int uio_fd;
+	bool active;
+	unsigned int num_queues;
+	struct queue queues[VIRTIO_IVSHMEM_MAX_QUEUES];
+	/* block device */
+	int image_fd;
+	bool read_only;
+	__u64 capacity;
+	/* network device */
+	int tap_fd;
+	__u8 *net_buf;
+} dev;
+
+static volatile sig_atomic_t terminate;
+
+static void __attribute__((noreturn)) help(char *prog, int exit_status)
+{
+	printf("Usage: %s UIO-DEVICE block IMAGE [ro]\n"
+	       "       %s UIO-DEVICE net TAP-INTERFACE [MAC]\n",
+	       basename(prog), basename(prog));
+	exit(exit_status);
+}
+
+static void __attribute__((noreturn)) fatal(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void signal_handler(int sig)
+{
+	(void)sig;
+	terminate = 1;
+}
+
+static size_t uio_map_size(const char *uio_dev, unsigned int map)
+{
+	char path[PATH_MAX], *dev_copy = strdup(uio_dev);
+	unsigned long long size;
+	FILE *file;
+
+	snprintf(path, sizeof(path), "/sys/class/uio/%s/maps/map%u/size",
+		 basename(dev_copy), map);
+	free(dev_copy);
+
+	file = fopen(path, "r");
+	if (!file)
+		fatal(path);
+	if (fscanf(file, "%llx", &size) != 1) {
+		fprintf(stderr, "%s: invalid size\n", path);
+		exit(1);
+	}
+	fclose(file);
+
+	return size;
+}
+
+static void *uio_map(const char *uio_dev, unsigned int map, size_t *size)
+{
+	void *addr;
+
+	*size = uio_map_size(uio_dev, map);
+	addr = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    dev.uio_fd, map * getpagesize());
+	if (addr == MAP_FAILED)
+		fatal("mmap");
+	return addr;
+}
+
+/*
+ * Translate a front-end offset into a pointer. Only the front-end area of the
+ * shared memory is accepted.
+ */
+static void *shmem_ptr(__u64 offset, __u64 len)
+{
+	if (offset < VIRTIO_IVSHMEM_HEADER_SIZE || offset > dev.shmem_size ||
+	    len > dev.shmem_size - offset)
+		return NULL;
+	return dev.shmem + offset;
+}
+
+static void notify_frontend(void)
+{
+	dev.regs[IVSHMEM_REG_DBELL] = 1;
+}
+
+static bool has_feature(unsigned int feature)
+{
+	return !!(dev.header->driver_features & (1ULL << feature));
+}
+
+static void device_error(const char *reason)
+{
+	fprintf(stderr, "front-end error: %s\n", reason);
+	dev.header->device_status |= VIRTIO_CONFIG_S_NEEDS_RESET;
+	dev.active = false;
+	notify_frontend();
+}
+
+static bool queue_activate(unsigned int index)
+{
+	struct virtio_ivshmem_queue *q = &dev.header->queues[index];
+	struct queue *queue = &dev.queues[index];
+	__u16 size = q->size;
+
+	if (!q->ready || size == 0 || size > QUEUE_SIZE_MAX ||
+	    (size & (size - 1)))
+		return false;
+
+	queue->desc = shmem_ptr(q->desc, VRING_DESC_SIZE(size));
+	queue->avail = shmem_ptr(q->avail, VRING_AVAIL_SIZE(size) + 2);
+	queue->used = shmem_ptr(q->used, VRING_USED_SIZE(size) + 2);
+	if (!queue->desc || !queue->avail || !queue->used ||
+	    q->desc % 16 || q->avail % 2 || q->used % 4)
+		return false;
+
+	queue->size = size;
+	queue->last_avail_idx = queue->avail->idx;
+	queue->used_idx = queue->signaled_used_idx = queue->used->idx;
+	*vring_avail_event(queue->used, size) = queue->last_avail_idx;
+
+	return true;
+}
+
+static bool device_activate(void)
+{
+	struct virtio_ivshmem_header *header = dev.header;
+	unsigned int n;
+
+	if ((header->driver_features & ~header->device_features) ||
+	    !has_feature(VIRTIO_F_VERSION_1))
+		return false;
+
+	for (n = 0; n < dev.num_queues; n++)
+		if (!queue_activate(n))
+			return false;
+
+	return true;
+}
+
+/* Fetch the next chain made available by the front-end. */
+static int queue_pop(struct queue *queue, struct chain *chain)
+{
+	struct vring_desc desc;
+	unsigned int idx;
+
+	if (queue->avail->idx == queue->last_avail_idx)
+		return 0;
+	/* read the entry only after the index */
+	__sync_synchronize();
+
+	chain->head = queue->avail->ring[queue->last_avail_idx % queue->size];
+	queue->last_avail_idx++;
+	if (chain->head >= queue->size)
+		return -1;
+
+	idx = chain->head;
+	for (chain->num = 0; chain->num < MAX_CHAIN; chain->num++) {
+		/* the front-end may modify the descriptor concurrently */
+		desc.addr = queue->desc[idx].addr;
+		desc.len = queue->desc[idx].len;
+		desc.flags = queue->desc[idx].flags;
+		desc.next = queue->desc[idx].next;
+
+		chain->buf[chain->num].addr = shmem_ptr(desc.addr, desc.len);
+		if (!chain->buf[chain->num].addr)
+			return -1;
+		chain->buf[chain->num].len = desc.len;
+		chain->buf[chain->num].writable =
+			!!(desc.flags & VRING_DESC_F_WRITE);
+
+		if (!(desc.flags & VRING_DESC_F_NEXT)) {
+			chain->num++;
+			return 1;
+		}
+		idx = desc.next;
+		if (idx >= queue->size)
+			return -1;
+	}
+	return -1;
+}
+
+static void queue_push(struct queue *queue, unsigned int head, __u32 len)
+{
+	volatile struct vring_used_elem *elem =
+		&queue->used->ring[queue->used_idx % queue->size];
+
+	elem->id = head;
+	elem->len = len;
+	/* publish the entry before the index */
+	__sync_synchronize();
+	queue->used->idx = ++queue->used_idx;
+}
+
+/*
+ * Notify the front-end once for all chains pushed since the last call, unless
+ * it suppressed that.
+ */
+static void queue_signal(struct queue *queue)
+{
+	bool notify;
+
+	if (queue->used_idx == queue->signaled_used_idx)
+		return;
+
+	__sync_synchronize();
+	if (has_feature(VIRTIO_RING_F_EVENT_IDX))
+		notify = vring_need_event(*vring_used_event(queue->avail,
+							    queue->size),
+					  queue->used_idx,
+					  queue->signaled_used_idx);
+	else
+		notify = !(queue->avail->flags & VRING_AVAIL_F_NO_INTERRUPT);
+	queue->signaled_used_idx = queue->used_idx;
+
+	if (notify)
+		notify_frontend();
+}
+
+/*
+ * Ask for a notification on the next available chain. Returns true if chains
+ * arrived meanwhile.
+ */
+static bool queue_enable_notification(struct queue *queue)
+{
+	*vring_avail_event(queue->used, queue->size) = queue->last_avail_idx;
+	__sync_synchronize();
+	return queue->avail->idx != queue->last_avail_idx;
+}
+
+static __u8 blk_transfer(__u32 type, __u64 sector, struct chain *chain,
+			 __u32 *written)
+{
+	off_t offset = sector * VIRTIO_BLK_SECTOR_SIZE;
+	unsigned int n;
+	ssize_t ret;
+	__u32 len;
+
+	for (n = 1; n < chain->num - 1; n++) {
+		len = chain->buf[n].len;
+		if (len % VIRTIO_BLK_SECTOR_SIZE ||
+		    sector + len / VIRTIO_BLK_SECTOR_SIZE > dev.capacity ||
+		    chain->buf[n].writable != (type == VIRTIO_BLK_T_IN))
+			return VIRTIO_BLK_S_IOERR;
+
+		if (type == VIRTIO_BLK_T_IN) {
+			ret = pread(dev.image_fd, chain->buf[n].addr, len,
+				    offset);
+			*written += len;
+		} else {
+			ret = pwrite(dev.image_fd, chain->buf[n].addr, len,
+				     offset);
+		}
+		if (ret != (ssize_t)len)
+			return VIRTIO_BLK_S_IOERR;
+
+		offset += len;
+		sector += len / VIRTIO_BLK_SECTOR_SIZE;
+	}
+	return VIRTIO_BLK_S_OK;
+}
+
+static bool blk_process(struct chain *chain, __u32 *written)
+{
+	struct virtio_blk_req_hdr hdr;
+	__u8 status;
+
+	*written = 0;
+	if (chain->num < 2 || chain->buf[0].writable ||
+	    chain->buf[0].len < sizeof(hdr) ||
+	    !chain->buf[chain->num - 1].writable ||
+	    chain->buf[chain->num - 1].len < 1)
+		return false;
+	memcpy(&hdr, chain->buf[0].addr, sizeof(hdr));
+
+	switch (hdr.type) {
+	case VIRTIO_BLK_T_IN:
+		status = blk_transfer(hdr.type, hdr.sector, chain, written);
+		break;
+	case VIRTIO_BLK_T_OUT:
+		if (dev.read_only)
+			status = VIRTIO_BLK_S_IOERR;
+		else
+			status = blk_transfer(hdr.type, hdr.sector, chain,
+					      written);
+		break;
+	case VIRTIO_BLK_T_FLUSH:
+		status = fdatasync(dev.image_fd) ? VIRTIO_BLK_S_IOERR :
+			VIRTIO_BLK_S_OK;
+		break;
+	default:
+		status = VIRTIO_BLK_S_UNSUPP;
+		break;
+	}
+
+	*chain->buf[chain->num - 1].addr = status;
+	(*written)++;
+	return true;
+}
+
+static bool net_transmit(struct chain *chain)
+{
+	size_t len = 0, skip = sizeof(struct virtio_net_hdr), part;
+	unsigned int n;
+
+	for (n = 0; n < chain->num; n++) {
+		if (chain->buf[n].writable)
+			return false;
+
+		part = chain->buf[n].len;
+		if (skip >= part) {
+			skip -= part;
+			continue;
+		}
+		part -= skip;
+		if (len + part > NET_BUF_SIZE)
+			return false;
+		memcpy(dev.net_buf + len, chain->buf[n].addr + skip, part);
+		len += part;
+		skip = 0;
+	}
+
+	if (len > 0 && write(dev.tap_fd, dev.net_buf, len) < 0 &&
+	    errno != EAGAIN)
+		perror("tap write");
+	return true;
+}
+
+/* Fetch one frame from the TAP interface, returns its size with header. */
+static size_t net_read_frame(void)
+{
+	struct virtio_net_hdr *hdr = (struct virtio_net_hdr *)dev.net_buf;
+	ssize_t ret;
+
+	ret = read(dev.tap_fd, dev.net_buf + sizeof(*hdr),
+		   NET_BUF_SIZE - sizeof(*hdr));
+	if (ret <= 0) {
+		if (ret < 0 && errno != EAGAIN)
+			perror("tap read");
+		return 0;
+	}
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->num_buffers = 1;
+	return sizeof(*hdr) + ret;
+}
+
+/* Copy the frame fetched last into a receive chain. */
+static bool net_receive(struct chain *chain, size_t len, __u32 *written)
+{
+	size_t pos = 0, part;
+	unsigned int n;
+
+	for (n = 0; n < chain->num && pos < len; n++) {
+		if (!chain->buf[n].writable)
+			return false;
+		part = chain->buf[n].len;
+		if (part > len - pos)
+			part = len - pos;
+		memcpy(chain->buf[n].addr, dev.net_buf + pos, part);
+		pos += part;
+	}
+
+	/* frames exceeding the chain are truncated */
+	*written = pos;
+	return true;
+}
+
+static bool queue_empty(struct queue *queue)
+{
+	return queue->avail->idx == queue->last_avail_idx;
+}
+
+static void process_queue(unsigned int index)
+{
+	struct queue *queue = &dev.queues[index];
+	bool rx = dev.device_id == VIRTIO_ID_NET &&
+		index == VIRTIO_NET_QUEUE_RX;
+	size_t frame_len = 0;
+	struct chain chain;
+	__u32 written;
+	bool valid;
+	int ret;
+
+	do {
+		while (dev.active) {
+			/* only consume receive buffers for pending frames */
+			if (rx && (queue_empty(queue) ||
+				   !(frame_len = net_read_frame())))
+				break;
+
+			ret = queue_pop(queue, &chain);
+			if (ret == 0)
+				break;
+			if (ret < 0) {
+				device_error("invalid descriptor chain");
+				return;
+			}
+
+			written = 0;
+			if (dev.device_id == VIRTIO_ID_BLOCK)
+				valid = blk_process(&chain, &written);
+			else if (rx)
+				valid = net_receive(&chain, frame_len,
+						    &written);
+			else
+				valid = net_transmit(&chain);
+			if (!valid) {
+				device_error("invalid request");
+				return;
+			}
+
+			queue_push(queue, chain.head, written);
+		}
+		if (!dev.active)
+			return;
+		/* a single notification for the whole batch */
+		queue_signal(queue);
+	} while (queue_enable_notification(queue) && !rx);
+}
+
+static bool rx_buffers_available(void)
+{
+	return dev.active && !queue_empty(&dev.queues[VIRTIO_NET_QUEUE_RX]);
+}
+
+static void update_state(void)
+{
+	struct virtio_ivshmem_header *header = dev.header;
+	__u32 frontend = dev.regs[IVSHMEM_REG_RSTATE];
+	__u32 status = header->device_status;
+	bool ready;
+
+	ready = frontend == VIRTIO_IVSHMEM_STATE_READY &&
+		(status & VIRTIO_CONFIG_S_DRIVER_OK) &&
+		!(status & (VIRTIO_CONFIG_S_NEEDS_RESET |
+			    VIRTIO_CONFIG_S_FAILED));
+
+	if (dev.active && !ready) {
+		printf("front-end reset\n");
+		dev.active = false;
+	}
+	if (frontend != VIRTIO_IVSHMEM_STATE_READY &&
+	    dev.regs[IVSHMEM_REG_LSTATE] != VIRTIO_IVSHMEM_STATE_READY)
+		/* acknowledge the reset, see Documentation/ivshmem-virtio.md */
+		dev.regs[IVSHMEM_REG_LSTATE] = VIRTIO_IVSHMEM_STATE_READY;
+
+	if (!dev.active && ready &&
+	    dev.regs[IVSHMEM_REG_LSTATE] == VIRTIO_IVSHMEM_STATE_READY) {
+		/* the rings are valid once DRIVER_OK is visible */
+		__sync_synchronize();
+		if (!device_activate()) {
+			device_error("invalid configuration");
+			return;
+		}
+		printf("front-end ready\n");
+		dev.active = true;
+		dev.regs[IVSHMEM_REG_LSTATE] = VIRTIO_IVSHMEM_STATE_ACTIVE;
+	}
+}
+
+static void init_header(__u64 features, const void *config,
+			size_t config_size, unsigned int num_queues)
+{
+	struct virtio_ivshmem_header *header = dev.header;
+
+	memset(header, 0, sizeof(*header));
+	header->magic = VIRTIO_IVSHMEM_MAGIC;
+	header->revision = VIRTIO_IVSHMEM_REVISION;
+	header->device_id = dev.device_id;
+	header->device_features = features |
+		(1ULL << VIRTIO_F_VERSION_1) |
+		(1ULL << VIRTIO_RING_F_EVENT_IDX);
+	header->num_queues = num_queues;
+	header->queue_size_max = QUEUE_SIZE_MAX;
+	memcpy(header->config, config, config_size);
+	dev.num_queues = num_queues;
+}
+
+static void setup_block(int argc, char *argv[])
+{
+	struct virtio_blk_config config;
+	__u64 features = 1ULL << VIRTIO_BLK_F_FLUSH;
+	struct stat stat;
+
+	if (argc < 4 || argc > 5 || (argc == 5 && strcmp(argv[4], "ro") != 0))
+		help(argv[0], 1);
+
+	dev.read_only = argc == 5;
+	dev.image_fd = open(argv[3], dev.read_only ? O_RDONLY : O_RDWR);
+	if (dev.image_fd < 0 || fstat(dev.image_fd, &stat) < 0)
+		fatal(argv[3]);
+
+	dev.device_id = VIRTIO_ID_BLOCK;
+	dev.capacity = stat.st_size / VIRTIO_BLK_SECTOR_SIZE;
+	if (dev.read_only)
+		features |= 1ULL << VIRTIO_BLK_F_RO;
+
+	memset(&config, 0, sizeof(config));
+	config.capacity = dev.capacity;
+	init_header(features, &config, sizeof(config), 1);
+
+	printf("Serving %s (%llu sectors%s)\n", argv[3],
+	       (unsigned long long)dev.capacity,
+	       dev.read_only ? ", read-only" : "");
+}
+
+static void setup_net(int argc, char *argv[])
+{
+	struct virtio_net_config config = {
+		.mac = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 },
+		.status = VIRTIO_NET_S_LINK_UP,
+	};
+	unsigned int mac[6], n;
+	struct ifreq ifr;
+
+	if (argc < 4 || argc > 5)
+		help(argv[0], 1);
+
+	if (argc == 5) {
+		if (sscanf(argv[4], "%x:%x:%x:%x:%x:%x", &mac[0], &mac[1],
+			   &mac[2], &mac[3], &mac[4], &mac[5]) != 6)
+			help(argv[0], 1);
+		for (n = 0; n < 6; n++)
+			config.mac[n] = mac[n];
+	}
+
+	dev.tap_fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (dev.tap_fd < 0)
+		fatal("/dev/net/tun");
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, argv[3], IFNAMSIZ - 1);
+	if (ioctl(dev.tap_fd, TUNSETIFF, &ifr) < 0)
+		fatal("TUNSETIFF");
+
+	dev.net_buf = malloc(NET_BUF_SIZE);
+	if (!dev.net_buf)
+		fatal("malloc");
+
+	dev.device_id = VIRTIO_ID_NET;
+	init_header((1ULL << VIRTIO_NET_F_MAC) | (1ULL << VIRTIO_NET_F_STATUS),
+		    &config, sizeof(config), 2);
+
+	printf("Bridging to %s\n", ifr.ifr_name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pollfd fds[2];
+	size_t regs_size;
+	unsigned int n;
+	__u32 count;
+	int nfds;
+
+	if (argc >= 2 && (strcmp(argv[1], "--help") == 0 ||
+			  strcmp(argv[1], "-h") == 0))
+		help(argv[0], 0);
+	if (argc < 4)
+		help(argv[0], 1);
+
+	dev.uio_fd = open(argv[1], O_RDWR);
+	if (dev.uio_fd < 0)
+		fatal(argv[1]);
+	dev.regs = uio_map(argv[1], 0, &regs_size);
+	dev.shmem = uio_map(argv[1], 1, &dev.shmem_size);
+	if (dev.shmem_size <= VIRTIO_IVSHMEM_HEADER_SIZE) {
+		fprintf(stderr, "shared memory too small\n");
+		return 1;
+	}
+	dev.header = (struct virtio_ivshmem_header *)dev.shmem;
+
+	dev.regs[IVSHMEM_REG_LSTATE] = VIRTIO_IVSHMEM_STATE_RESET;
+
+	if (strcmp(argv[2], "block") == 0)
+		setup_block(argc, argv);
+	else if (strcmp(argv[2], "net") == 0)
+		setup_net(argc, argv);
+	else
+		help(argv[0], 1);
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	/* the header is complete before the front-end may look at it */
+	__sync_synchronize();
+	dev.regs[IVSHMEM_REG_LSTATE] = VIRTIO_IVSHMEM_STATE_READY;
+
+	fds[0].fd = dev.uio_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = dev.tap_fd;
+	fds[1].events = POLLIN;
+
+	while (!terminate) {
+		nfds = dev.device_id == VIRTIO_ID_NET &&
+			rx_buffers_available() ? 2 : 1;
+		if (poll(fds, nfds, POLL_INTERVAL_MS) < 0) {
+			if (errno == EINTR)
+				continue;
+			fatal("poll");
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (read(dev.uio_fd, &count, sizeof(count)) < 0)
+				fatal("uio read");
+			/* re-enable the interrupt, if controllable at all */
+			count = 1;
+			if (write(dev.uio_fd, &count, sizeof(count)) < 0 &&
+			    errno != ENOSYS && errno != EIO)
+				fatal("uio write");
+		}
+
+		update_state();
+		for (n = 0; n < dev.num_queues; n++)
+			process_queue(n);
+	}
+
+	dev.regs[IVSHMEM_REG_LSTATE] = VIRTIO_IVSHMEM_STATE_RESET;
+	return 0;
+}
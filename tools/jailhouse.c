@@ -44,7 +44,8 @@ struct jailhouse_cell_info {
 };
 
 static const struct extension extensions[] = {
-	{ "cell", "linux", "CELLCONFIG KERNEL [-i | --initrd FILE]\n"
+	{ "cell", "linux", "CELLCONFIG KERNEL [-i | --initrd FILE] "
+	  "[-z | --decompress-initrd]\n"
 	  "              [-c | --cmdline \"STRING\"] "
 					"[-w | --write-params FILE]" },
 	{ "cell", "stats", "{ ID | [--name] NAME }" },
@@ -53,6 +54,11 @@ static const struct extension extensions[] = {
 	  "                 [--mem-hv MEM_HV] FILE" },
 	{ "config", "collect", "FILE.TAR" },
 	{ "hardware", "check", "" },
+	{ "trace", "export", "[-f | --follow] [-i | --input FILE] "
+	  "[-o | --output FILE]" },
+	{ "profile", "report", "[-f | --follow] [-i | --input FILE] "
+	  "[-l | --lines]\n"
+	  "                 [-c | --cell ID] [-n | --top N] OBJECT" },
 	{ NULL }
 };
 
@@ -73,7 +79,10 @@ static void __attribute__((noreturn)) help(char *prog, int exit_status)
 	       "   cell list\n"
 	       "   cell load { ID | [--name] NAME } "
 				"{ IMAGE | { -s | --string } \"STRING\" }\n"
-	       "             [-a | --address ADDRESS] ...\n"
+	       "             [-a | --address ADDRESS] "
+				"[-z | --decompress] ...\n"
+	       "   cell snapshot { ID | [--name] NAME }\n"
+	       "   cell restore { ID | [--name] NAME }\n"
 	       "   cell start { ID | [--name] NAME }\n"
 	       "   cell shutdown { ID | [--name] NAME }\n"
 	       "   cell destroy { ID | [--name] NAME }\n",
@@ -189,6 +198,22 @@ static void *read_file(const char *name, size_t *size)
 	return buffer;
 }
 
+/*
+ * Detect zstd and lz4 frames. axvm create has no per-image options, so
+ * compressed images are recognized by their magic.
+ */
+static bool is_compressed_image(const void *image, size_t size)
+{
+	const unsigned char *magic = image;
+
+	if (size < 4)
+		return false;
+	return (magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f &&
+		magic[3] == 0xfd) ||
+	       (magic[0] == 0x04 && magic[1] == 0x22 && magic[2] == 0x4d &&
+		magic[3] == 0x18);
+}
+
 static char *read_sysfs_cell_string(const unsigned int id, const char *entry)
 {
 	char *ret, buffer[128];
@@ -425,6 +450,10 @@ static int cell_shutdown_load(int argc, char *argv[],
 				help(argv[0], 1);
 			arg_num += 2;
 		}
+
+		if (arg_num < argc &&
+		    match_opt(argv[arg_num], "-z", "--decompress"))
+			arg_num++;
 	}
 
 	cell_load = malloc(sizeof(*cell_load) + sizeof(*image) * images);
@@ -450,6 +479,8 @@ static int cell_shutdown_load(int argc, char *argv[],
 		}
 		image->size = size;
 		image->target_address = 0;
+		image->flags = 0;
+		image->padding = 0;
 
 		if (arg_num < argc &&
 		    match_opt(argv[arg_num], "-a", "--address")) {
@@ -460,6 +491,12 @@ static int cell_shutdown_load(int argc, char *argv[],
 				help(argv[0], 1);
 			arg_num += 2;
 		}
+
+		if (arg_num < argc &&
+		    match_opt(argv[arg_num], "-z", "--decompress")) {
+			image->flags |= JAILHOUSE_IMAGE_COMPRESSED;
+			arg_num++;
+		}
 	}
 
 	fd = open_dev();
@@ -493,6 +530,10 @@ static int cell_simple_cmd(int argc, char *argv[], unsigned int command)
 		       "JAILHOUSE_CELL_START" :
 		       command == JAILHOUSE_CELL_DESTROY ?
 		       "JAILHOUSE_CELL_DESTROY" :
+		       command == JAILHOUSE_CELL_SNAPSHOT ?
+		       "JAILHOUSE_CELL_SNAPSHOT" :
+		       command == JAILHOUSE_CELL_RESTORE ?
+		       "JAILHOUSE_CELL_RESTORE" :
 		       "<unknown command>");
 
 	close(fd);
@@ -513,6 +554,10 @@ static int cell_management(int argc, char *argv[])
 		err = cell_list(argc, argv);
 	} else if (strcmp(argv[2], "load") == 0) {
 		err = cell_shutdown_load(argc, argv, LOAD);
+	} else if (strcmp(argv[2], "snapshot") == 0) {
+		err = cell_simple_cmd(argc, argv, JAILHOUSE_CELL_SNAPSHOT);
+	} else if (strcmp(argv[2], "restore") == 0) {
+		err = cell_simple_cmd(argc, argv, JAILHOUSE_CELL_RESTORE);
 	} else if (strcmp(argv[2], "start") == 0) {
 		err = cell_simple_cmd(argc, argv, JAILHOUSE_CELL_START);
 	} else if (strcmp(argv[2], "shutdown") == 0) {
@@ -556,6 +601,8 @@ static int axvm_create(int argc, char *argv[])
 		
 		axvm_cfg.img_addr[i-5] = (unsigned long)read_file(argv[i], &size);
 		axvm_cfg.img_size[i-5] = size;
+		if (is_compressed_image((void *)(unsigned long)axvm_cfg.img_addr[i-5], size))
+			axvm_cfg.img_flags[i-5] = JAILHOUSE_IMAGE_COMPRESSED;
 		// printf(" addr%d:%llx, size%d: %lld ", i-4, axvm_cfg.addr[i-4], i-4, axvm_cfg.size[i-4]);
 	}
 	
@@ -649,7 +696,9 @@ int main(int argc, char *argv[])
 	} else if (strcmp(argv[1], "console") == 0) {
 		err = console(argc, argv);
 	} else if (strcmp(argv[1], "config") == 0 ||
-		   strcmp(argv[1], "hardware") == 0) {
+		   strcmp(argv[1], "hardware") == 0 ||
+		   strcmp(argv[1], "trace") == 0 ||
+		   strcmp(argv[1], "profile") == 0) {
 		call_extension_script(argv[1], argc, argv);
 		help(argv[0], 1);
 	} else if (strcmp(argv[1], "--version") == 0) {